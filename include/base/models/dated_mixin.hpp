@@ -2,6 +2,7 @@
 #define DATED_MIXIN_HPP
 
 #include "entity.h"
+#include "entity_serializer.h"
 
 #include <QDateTime>
 
@@ -16,25 +17,26 @@ public:
                const QDateTime& updatedAt = QDateTime::currentDateTime(), const Args&... args) :
         Base(args...),
         createdAt(createdAt),
-        updatedAt(updatedAt, std::bind(&Base::changed, this))
+        updatedAt(updatedAt, this->notifier(props::updatedAt))
     {
     }
 
     utils::ConstProperty<QDateTime> createdAt;
     utils::Property<QDateTime> updatedAt;
 
-    QVariantMap toVariantMap() const override
+    void serialize(IEntitySink& sink) const override
     {
-        QVariantMap map = Base::toVariantMap();
-        map.insert(props::createdAt, this->createdAt());
-        map.insert(props::updatedAt, this->updatedAt());
-        return map;
+        Base::serialize(sink);
+        sink.writeDateTime(props::createdAt, this->createdAt());
+        sink.writeDateTime(props::updatedAt, this->updatedAt());
     }
 
-    void fromVariantMap(const QVariantMap& map) override
+    void deserialize(const IEntitySource& source) override
     {
-        updatedAt = map.value(props::updatedAt, this->updatedAt()).toDateTime();
-        Base::fromVariantMap(map);
+        QDateTime value = this->updatedAt();
+        source.readDateTime(props::updatedAt, value);
+        updatedAt = value;
+        Base::deserialize(source);
     }
 };
 } // namespace md::domain
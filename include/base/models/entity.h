@@ -2,6 +2,7 @@
 #define ENTITY_H
 
 #include <QObject>
+#include <QSet>
 #include <QVariantMap>
 
 #include "kjarni_traits.h"
@@ -10,6 +11,9 @@
 
 namespace md::domain
 {
+class IEntitySink;
+class IEntitySource;
+
 class Entity : public QObject
 {
     Q_OBJECT
@@ -21,11 +25,33 @@ public:
 
     utils::ConstProperty<QVariant> id;
 
+    // Fields written into the sink and read back from the source, every layer adds its own
+    virtual void serialize(IEntitySink& sink) const;
+    virtual void deserialize(const IEntitySource& source);
+
+    // Adapters over serialize & deserialize
     virtual QVariantMap toVariantMap() const;
     virtual void fromVariantMap(const QVariantMap& map);
 
+    // Fields changed since the last persist, entity is dirty entirely until the first one
+    bool isPersisted() const;
+    bool isDirty() const;
+    QStringList dirtyFields() const;
+    void markDirty(const QString& field);
+    void markClean();
+    // Some of the fields in the map have other values than the entity
+    bool differs(const QVariantMap& map) const;
+
 signals:
     void changed();
+
+protected:
+    // Property notifier marking the field dirty
+    std::function<void()> notifier(const QString& field);
+
+private:
+    QSet<QString> m_dirtyFields;
+    bool m_persisted = false;
 };
 } // namespace md::domain
 
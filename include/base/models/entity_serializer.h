@@ -0,0 +1,141 @@
+#ifndef ENTITY_SERIALIZER_H
+#define ENTITY_SERIALIZER_H
+
+#include <QByteArray>
+#include <QCborMap>
+#include <QCborStreamWriter>
+#include <QDateTime>
+#include <QJsonObject>
+#include <QVariantMap>
+
+#include <functional>
+
+namespace md::domain
+{
+// Gets the fields of an entity one by one, typed writes default to writeValue
+class IEntitySink
+{
+public:
+    using FieldsWriter = std::function<void(IEntitySink&)>;
+
+    virtual ~IEntitySink() = default;
+
+    // Entities skip building the values of the fields the sink doesn't store
+    virtual bool accepts(const QString& field) const;
+
+    virtual void writeValue(const QString& field, const QVariant& value) = 0;
+    virtual void writeString(const QString& field, const QString& value);
+    virtual void writeBool(const QString& field, bool value);
+    virtual void writeDateTime(const QString& field, const QDateTime& value);
+    virtual void writeMap(const QString& field, const QVariantMap& value);
+    // Nested object written field by field, goes through writeMap unless the sink streams it
+    virtual void writeObject(const QString& field, const FieldsWriter& fields);
+};
+
+// Gives the fields back, reads return false and keep the value for a missing field
+class IEntitySource
+{
+public:
+    virtual ~IEntitySource() = default;
+
+    virtual bool readValue(const QString& field, QVariant& value) const = 0;
+    virtual bool readString(const QString& field, QString& value) const;
+    virtual bool readBool(const QString& field, bool& value) const;
+    virtual bool readDateTime(const QString& field, QDateTime& value) const;
+    virtual bool readMap(const QString& field, QVariantMap& value) const;
+};
+
+// Compatibility adapters behind Entity::toVariantMap & Entity::fromVariantMap
+class VariantMapSink : public IEntitySink
+{
+public:
+    void writeValue(const QString& field, const QVariant& value) override;
+
+    const QVariantMap& map() const;
+
+private:
+    QVariantMap m_map;
+};
+
+class VariantMapSource : public IEntitySource
+{
+public:
+    explicit VariantMapSource(const QVariantMap& map);
+
+    bool readValue(const QString& field, QVariant& value) const override;
+
+private:
+    const QVariantMap m_map;
+};
+
+// Date and time fields are ISO 8601 strings
+class JsonEntitySink : public IEntitySink
+{
+public:
+    void writeValue(const QString& field, const QVariant& value) override;
+    void writeString(const QString& field, const QString& value) override;
+    void writeBool(const QString& field, bool value) override;
+    void writeDateTime(const QString& field, const QDateTime& value) override;
+    void writeMap(const QString& field, const QVariantMap& value) override;
+    void writeObject(const QString& field, const FieldsWriter& fields) override;
+
+    const QJsonObject& object() const;
+
+private:
+    QJsonObject m_object;
+};
+
+class JsonEntitySource : public IEntitySource
+{
+public:
+    explicit JsonEntitySource(const QJsonObject& object);
+
+    bool readValue(const QString& field, QVariant& value) const override;
+    bool readString(const QString& field, QString& value) const override;
+    bool readBool(const QString& field, bool& value) const override;
+    bool readDateTime(const QString& field, QDateTime& value) const override;
+    bool readMap(const QString& field, QVariantMap& value) const override;
+
+private:
+    const QJsonObject m_object;
+};
+
+// Fields are streamed into a CBOR map as they are written
+class CborEntitySink : public IEntitySink
+{
+public:
+    CborEntitySink();
+
+    void writeValue(const QString& field, const QVariant& value) override;
+    void writeString(const QString& field, const QString& value) override;
+    void writeBool(const QString& field, bool value) override;
+    void writeDateTime(const QString& field, const QDateTime& value) override;
+    void writeMap(const QString& field, const QVariantMap& value) override;
+    void writeObject(const QString& field, const FieldsWriter& fields) override;
+
+    // Closes the map, nothing can be written after
+    QByteArray finish();
+
+private:
+    QByteArray m_data;
+    QCborStreamWriter m_writer;
+    bool m_finished = false;
+};
+
+class CborEntitySource : public IEntitySource
+{
+public:
+    explicit CborEntitySource(const QByteArray& data);
+
+    bool readValue(const QString& field, QVariant& value) const override;
+    bool readString(const QString& field, QString& value) const override;
+    bool readBool(const QString& field, bool& value) const override;
+    bool readDateTime(const QString& field, QDateTime& value) const override;
+    bool readMap(const QString& field, QVariantMap& value) const override;
+
+private:
+    const QCborMap m_map;
+};
+} // namespace md::domain
+
+#endif // ENTITY_SERIALIZER_H
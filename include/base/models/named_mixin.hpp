@@ -2,6 +2,7 @@
 #define NAMED_MIXIN_HPP
 
 #include "entity.h"
+#include "entity_serializer.h"
 
 namespace md::domain
 {
@@ -12,23 +13,24 @@ public:
     template<typename... Args>
     NamedMixin(const QString& name, const Args&... args) :
         Base(args...),
-        name(name, std::bind(&Base::changed, this))
+        name(name, this->notifier(props::name))
     {
     }
 
     utils::Property<QString> name;
 
-    QVariantMap toVariantMap() const override
+    void serialize(IEntitySink& sink) const override
     {
-        QVariantMap map = Base::toVariantMap();
-        map.insert(props::name, this->name());
-        return map;
+        Base::serialize(sink);
+        sink.writeString(props::name, this->name());
     }
 
-    void fromVariantMap(const QVariantMap& map) override
+    void deserialize(const IEntitySource& source) override
     {
-        name = map.value(props::name, this->name()).toString();
-        Base::fromVariantMap(map);
+        QString value = this->name();
+        source.readString(props::name, value);
+        name = value;
+        Base::deserialize(source);
     }
 };
 } // namespace md::domain
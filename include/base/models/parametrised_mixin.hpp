@@ -2,6 +2,7 @@
 #define PARAMETRISED_MIXIN_HPP
 
 #include "entity.h"
+#include "entity_serializer.h"
 
 namespace md::domain
 {
@@ -40,7 +41,7 @@ public:
             return;
 
         m_parameters[key] = value;
-        m_notifier();
+        this->notifyParameters();
     }
 
     void setParameters(const QVariantMap& parameters)
@@ -49,14 +50,14 @@ public:
             return;
 
         m_parameters = parameters;
-        m_notifier();
+        this->notifyParameters();
     }
 
     void removeParameter(const QString& key)
     {
         if (m_parameters.remove(key))
         {
-            m_notifier();
+            this->notifyParameters();
         }
     }
 
@@ -73,24 +74,29 @@ public:
         }
 
         if (changedFlag)
-            m_notifier();
+            this->notifyParameters();
     }
 
-    QVariantMap toVariantMap() const override
+    void serialize(IEntitySink& sink) const override
     {
-        QVariantMap map = Base::toVariantMap();
-        map.insert(props::params, m_parameters);
-        return map;
+        Base::serialize(sink);
+        sink.writeMap(props::params, m_parameters);
     }
 
-    void fromVariantMap(const QVariantMap& map) override
+    void deserialize(const IEntitySource& source) override
     {
-        m_parameters = map.value(props::params, m_parameters).toMap();
-        Base::fromVariantMap(map);
-        m_notifier();
+        source.readMap(props::params, m_parameters);
+        Base::deserialize(source);
+        this->notifyParameters();
     }
 
 private:
+    void notifyParameters()
+    {
+        this->markDirty(props::params);
+        m_notifier();
+    }
+
     QVariantMap m_parameters;
     std::function<void()> m_notifier;
 };
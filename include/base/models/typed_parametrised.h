@@ -122,17 +122,27 @@ public:
         }
     }
 
-    QVariantMap toVariantMap() const override
+    void serialize(IEntitySink& sink) const override
     {
-        QVariantMap map = Base::toVariantMap();
-        map.insert(props::params, this->parametersMap());
-        return map;
+        Base::serialize(sink);
+        if (!sink.accepts(props::params))
+            return;
+
+        sink.writeObject(props::params, [this](IEntitySink& nested) {
+            for (TypedParameter* parameter : m_parameters.values())
+            {
+                nested.writeValue(parameter->id(), parameter->value());
+            }
+        });
     }
 
-    void fromVariantMap(const QVariantMap& map) override
+    // Missing parameters are reset to the defaults
+    void deserialize(const IEntitySource& source) override
     {
-        this->setParameters(map.value(props::params).toMap());
-        Base::fromVariantMap(map);
+        QVariantMap values;
+        source.readMap(props::params, values);
+        this->setParameters(values);
+        Base::deserialize(source);
     }
 
     void resetTypeParameters(const QVector<const ParameterType*>& types)
@@ -152,7 +162,10 @@ public:
             parameter->moveToThread(this->thread());
             parameter->setParent(this);
             m_parameters.insert(type->id, parameter);
-            QObject::connect(parameter, &TypedParameter::changed, this, &Base::changed);
+            QObject::connect(parameter, &TypedParameter::changed, this, [this]() {
+                this->markDirty(props::params);
+                emit Base::changed();
+            });
         }
 
         // Remove unneeded parameters
@@ -160,6 +173,7 @@ public:
         {
             m_parameters.take(id)->deleteLater();
         }
+        this->markDirty(props::params);
         emit Base::changed();
     }
 
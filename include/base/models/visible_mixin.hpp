@@ -2,6 +2,7 @@
 #define VISIBLE_MIXIN_HPP
 
 #include "entity.h"
+#include "entity_serializer.h"
 
 namespace md::domain
 {
@@ -12,23 +13,24 @@ public:
     template<typename... Args>
     VisibleMixin(bool visible, const Args&... args) :
         Base(args...),
-        visible(visible, std::bind(&Base::changed, this))
+        visible(visible, this->notifier(props::visible))
     {
     }
 
     utils::Property<bool> visible;
 
-    QVariantMap toVariantMap() const override
+    void serialize(IEntitySink& sink) const override
     {
-        QVariantMap map = Base::toVariantMap();
-        map.insert(props::visible, this->visible());
-        return map;
+        Base::serialize(sink);
+        sink.writeBool(props::visible, this->visible());
     }
 
-    void fromVariantMap(const QVariantMap& map) override
+    void deserialize(const IEntitySource& source) override
     {
-        visible = map.value(props::visible, this->visible()).toBool();
-        Base::fromVariantMap(map);
+        bool value = this->visible();
+        source.readBool(props::visible, value);
+        visible = value;
+        Base::deserialize(source);
     }
 };
 } // namespace md::domain
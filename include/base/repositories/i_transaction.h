@@ -0,0 +1,24 @@
+#ifndef I_TRANSACTION_H
+#define I_TRANSACTION_H
+
+#include <QSharedPointer>
+
+namespace md::domain
+{
+// Scoped unit of work, rolled back on destruction unless committed
+class ITransaction
+{
+public:
+    ITransaction() = default;
+    virtual ~ITransaction() = default;
+
+    virtual bool isActive() const = 0;
+
+    virtual bool commit() = 0;
+    virtual void rollback() = 0;
+};
+
+using TransactionPtr = QSharedPointer<ITransaction>;
+} // namespace md::domain
+
+#endif // I_TRANSACTION_H
@@ -0,0 +1,35 @@
+#ifndef PAGE_H
+#define PAGE_H
+
+#include <QList>
+#include <QVariantMap>
+
+namespace md::domain
+{
+// Keyset pagination: rows after the last row of the previous page, no OFFSET scans
+struct PageRequest
+{
+    int limit = 50;
+    // Sort column of the table, NULLs sort lowest. Rows with equal values go in id order, insertion
+    // order is used when empty
+    QString orderBy;
+    Qt::SortOrder sortOrder = Qt::AscendingOrder;
+    // Sort value & id of the last row of the previous page, null for the first page
+    QVariant afterValue;
+    QVariant afterId;
+    // Count all matching rows with an extra query
+    bool withTotal = false;
+};
+
+struct Page
+{
+    QList<QVariantMap> rows;
+    bool hasMore = false;
+    // Rows on all pages, -1 when not requested
+    int total = -1;
+    // Request for the following page
+    PageRequest next;
+};
+} // namespace md::domain
+
+#endif // PAGE_H
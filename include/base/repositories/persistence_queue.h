@@ -0,0 +1,99 @@
+#ifndef PERSISTENCE_QUEUE_H
+#define PERSISTENCE_QUEUE_H
+
+#include <functional>
+
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QFutureInterface>
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QSet>
+#include <QVector>
+#include <QWaitCondition>
+
+#include "i_transaction.h"
+
+class QThread;
+
+namespace md::domain
+{
+struct PersistenceStats
+{
+    int enqueued = 0;
+    int coalesced = 0;
+    int written = 0;
+    int failed = 0;
+    int batches = 0;
+};
+
+// Runs repository writes in order on its own thread. Write for a key still waiting in the queue
+// replaces the pending one in its place, so only the latest state gets to the storage
+class PersistenceQueue
+{
+public:
+    // Returns false if the write failed
+    using Write = std::function<bool()>;
+    // Gets the result of the write in the queue thread, after the commit
+    using Finished = std::function<void(bool ok)>;
+    // Writes taken at once run in one transaction
+    using TransactionFactory = std::function<TransactionPtr()>;
+
+    explicit PersistenceQueue(int windowMs = 100, const TransactionFactory& transaction = nullptr);
+    // Pending writes are done before the thread stops
+    ~PersistenceQueue();
+
+    PersistenceQueue(const PersistenceQueue&) = delete;
+    PersistenceQueue& operator=(const PersistenceQueue&) = delete;
+
+    // Write waits for the window, empty key is never collapsed with others.
+    // Replaced write is dropped along with its finished callback
+    void enqueue(const QString& key, const Write& write, const Finished& finished = nullptr);
+    // Finished when writes enqueued so far are done, they go without waiting for the window
+    QFuture<void> flush();
+
+    // Write for the key is waiting or running
+    bool isPending(const QString& key) const;
+    int pendingCount() const;
+    int windowMs() const;
+    PersistenceStats stats() const;
+
+private:
+    struct Pending
+    {
+        QString key;
+        Write write;
+        Finished finished;
+        qint64 dueMs = 0;
+    };
+
+    void run();
+    // Results of the writes, failed batch is rolled back and its writes are retried one by one
+    QVector<bool> write(const QList<Pending>& batch) const;
+    bool writeInTransaction(const QList<Pending>& writes) const;
+    bool isDue(quint64 sequence, const Pending& pending) const;
+    void finishFlushes();
+
+    const int m_windowMs;
+    const TransactionFactory m_transaction;
+    QElapsedTimer m_clock;
+
+    QMap<quint64, Pending> m_queue;
+    QHash<QString, quint64> m_sequences;
+    QSet<QString> m_running;
+    quint64 m_lastSequence = 0;
+    bool m_writing = false;
+    bool m_stopping = false;
+
+    QList<QPair<quint64, QFutureInterface<void>>> m_flushes;
+    quint64 m_flushSequence = 0;
+
+    PersistenceStats m_stats;
+    mutable QMutex m_mutex;
+    QWaitCondition m_wakeUp;
+    QThread* m_thread;
+};
+} // namespace md::domain
+
+#endif // PERSISTENCE_QUEUE_H
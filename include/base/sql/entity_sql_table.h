@@ -1,6 +1,8 @@
 #ifndef ENTITY_SQL_TABLE_H
 #define ENTITY_SQL_TABLE_H
 
+#include <QCache>
+
 #include "entity.h"
 #include "sql_table.h"
 
@@ -13,28 +15,99 @@ namespace sql
 const QString id = "id";
 }
 
+// Storage format for JSON properties, reading accepts both
+enum class JsonEncoding
+{
+    Text,
+    Cbor
+};
+
+namespace sql
+{
+// Format of the stored content is detected
+QVariantMap decodeJson(const QVariant& content);
+QByteArray encodeJson(const QVariant& content, JsonEncoding encoding);
+} // namespace sql
+
+struct EntityCacheStats
+{
+    int hits = 0;
+    int misses = 0;
+};
+
 class EntitySqlTable : public SqlTable
 {
 public:
     EntitySqlTable(QSqlDatabase* database, const QString& tableName,
-                   const QStringList& jsonProperties = {});
+                   const QStringList& jsonProperties = {},
+                   JsonEncoding jsonEncoding = JsonEncoding::Text);
+    ~EntitySqlTable() override;
 
     QVariantList selectIds(const ConditionMap& conditions = ConditionMap(),
                            const QString& column = sql::id);
     QVariantMap selectById(const QVariant& id, const QString& column = sql::id);
+    // Rows in the order of ids, missing ones are skipped
+    QList<QVariantMap> selectByIds(const QVariantList& ids);
+    // Rows in the stored order
+    QList<QVariantMap> selectByConditions(const ConditionMap& conditions);
+    using SqlTable::selectPage;
+    // Page of all columns with id as the key
+    domain::Page selectPage(const ConditionMap& conditions, const domain::PageRequest& request);
 
     bool removeById(const QVariant& id);
+    // One statement per chunk of ids, all of them in one transaction
+    bool removeByIds(const QVariantList& ids);
     bool updateById(const QVariantMap& valueMap, const QVariant& id);
 
-    void insertEntity(domain::Entity* entity);
+    // Written entities are marked clean
+    bool insertEntity(domain::Entity* entity);
+    bool insertEntities(const QList<domain::Entity*>& entities);
+    bool upsertEntity(domain::Entity* entity);
+    bool upsertEntities(const QList<domain::Entity*>& entities);
     void readEntity(domain::Entity* entity);
-    void updateEntity(domain::Entity* entity);
-    void removeEntity(domain::Entity* entity);
+    bool updateEntity(domain::Entity* entity);
+    bool removeEntity(domain::Entity* entity);
 
     QVariantMap entityToMap(domain::Entity* entity);
+    // Only the given columns, JSON properties out of them are not encoded
+    QVariantMap entityToMap(domain::Entity* entity, const QStringList& columns);
+    // Columns changed since the last persist, all but id for a never persisted entity
+    QStringList dirtyColumns(domain::Entity* entity) const;
+
+    // Re-encode stored JSON properties with the table encoding, returns count of converted rows
+    // or -1 on failure
+    int migrateJsonEncoding();
+
+    JsonEncoding jsonEncoding() const;
+
+    // Decoded rows by id, invalidated by writes through this table. Zero capacity disables it
+    void setCacheCapacity(int capacity);
+    int cacheCapacity() const;
+    EntityCacheStats cacheStats() const;
+    void clearCache();
+    // Rows changed bypassing this table, like cascade deletes
+    void invalidateCache(const ConditionMap& conditions);
+
+protected:
+    void rowsChanged(const ConditionMap& conditions) override;
 
 private:
+    void decodeJsonProperties(QVariantMap& map) const;
+
+    bool cachedRow(const QString& id, QVariantMap* row) const;
+    // Rows read before a write of the later cache generation are dropped
+    void cacheRow(const QVariantMap& row, quint64 generation);
+    quint64 cacheGeneration() const;
+
     const QStringList m_jsonProperties;
+    const JsonEncoding m_jsonEncoding;
+
+    mutable QCache<QString, QVariantMap> m_cache;
+    mutable EntityCacheStats m_cacheStats;
+    quint64 m_cacheGeneration = 0;
+    mutable QMutex m_cacheMutex;
+    // Writes through the other tables of the database invalidate the cache as well
+    QMetaObject::Connection m_changeFeedConnection;
 };
 
 } // namespace data_source
@@ -0,0 +1,65 @@
+#ifndef SQL_CHANGE_FEED_H
+#define SQL_CHANGE_FEED_H
+
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QSharedPointer>
+#include <QSqlDatabase>
+#include <QVariant>
+
+namespace md::data_source
+{
+struct SqlConnectionHooks;
+
+enum class SqlOperation
+{
+    Insert,
+    Update,
+    Delete
+};
+
+struct SqlChange
+{
+    QString table;
+    SqlOperation operation = SqlOperation::Update;
+    qint64 rowid = 0;
+    // Value of the id column, null if it couldn't be resolved
+    QVariant id;
+};
+
+// Publishes rows written through the attached connections, one batch per commit
+class SqlChangeFeed : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SqlChangeFeed(const QSqlDatabase& origin, QObject* parent = nullptr);
+    ~SqlChangeFeed() override;
+
+    // Install SQLite hooks on the opened connection, false for other drivers
+    bool attach(const QSqlDatabase& connection);
+    void detach(const QSqlDatabase& connection);
+
+    // Feed registered for the origin connection, if any
+    static SqlChangeFeed* feed(const QSqlDatabase& origin);
+
+signals:
+    // Emitted in the thread of the feed after the commit
+    void changed(const QList<md::data_source::SqlChange>& changes);
+
+private:
+    void publish(QList<SqlChange> changes);
+    void resolveIds(QList<SqlChange>& changes);
+    // Deleted rows can't be read back, triggers hand their ids over at the delete
+    void createDeleteTriggers(const QSqlDatabase& connection);
+
+    const QSqlDatabase m_origin;
+    QHash<QString, QSharedPointer<SqlConnectionHooks>> m_hooks;
+    mutable QMutex m_mutex;
+};
+} // namespace md::data_source
+
+Q_DECLARE_METATYPE(md::data_source::SqlChange)
+
+#endif // SQL_CHANGE_FEED_H
@@ -0,0 +1,54 @@
+#ifndef SQL_CONNECTION_POOL_H
+#define SQL_CONNECTION_POOL_H
+
+#include <functional>
+
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QSqlDatabase>
+
+class QThread;
+
+namespace md::data_source
+{
+// Lazily clones the origin connection for each thread, cause QSqlDatabase is bound to its thread
+class SqlConnectionPool
+{
+public:
+    using Setup = std::function<void(QSqlDatabase& database)>;
+
+    explicit SqlConnectionPool(const QSqlDatabase& origin, const Setup& setup = nullptr);
+    ~SqlConnectionPool();
+
+    SqlConnectionPool(const SqlConnectionPool&) = delete;
+    SqlConnectionPool& operator=(const SqlConnectionPool&) = delete;
+
+    // Connection for the current thread
+    QSqlDatabase connection();
+    int count() const;
+
+    // Connection for the current thread from the pool registered for the origin, or origin itself
+    static QSqlDatabase connection(const QSqlDatabase& origin);
+
+private:
+    struct Clone
+    {
+        QString connectionName;
+        QMetaObject::Connection threadFinished;
+    };
+
+    void release(QThread* thread);
+    static void close(const QString& connectionName);
+
+    const QString m_originName;
+    QThread* const m_originThread;
+    const Setup m_setup;
+
+    QHash<QThread*, Clone> m_clones;
+    int m_clonesCreated = 0;
+    mutable QMutex m_mutex;
+};
+} // namespace md::data_source
+
+#endif // SQL_CONNECTION_POOL_H
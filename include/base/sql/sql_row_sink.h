@@ -0,0 +1,30 @@
+#ifndef SQL_ROW_SINK_H
+#define SQL_ROW_SINK_H
+
+#include "entity_serializer.h"
+#include "entity_sql_table.h"
+
+namespace md::data_source
+{
+// Row to bind written by the entity straight away, fields out of the columns are skipped and
+// JSON properties are encoded as they come
+class SqlRowSink : public domain::IEntitySink
+{
+public:
+    SqlRowSink(const QStringList& columns, const QStringList& jsonProperties,
+               JsonEncoding jsonEncoding);
+
+    bool accepts(const QString& field) const override;
+    void writeValue(const QString& field, const QVariant& value) override;
+
+    const QVariantMap& row() const;
+
+private:
+    const QStringList m_columns;
+    const QStringList m_jsonProperties;
+    const JsonEncoding m_jsonEncoding;
+    QVariantMap m_row;
+};
+} // namespace md::data_source
+
+#endif // SQL_ROW_SINK_H
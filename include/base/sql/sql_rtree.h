@@ -0,0 +1,33 @@
+#ifndef SQL_RTREE_H
+#define SQL_RTREE_H
+
+#include "sql_table.h"
+
+namespace md::data_source
+{
+struct SqlRange
+{
+    double min;
+    double max;
+};
+
+// R*Tree virtual table indexing rows of the source table by its INTEGER PRIMARY KEY, implicit
+// rowid may change on VACUUM
+class SqlRTree : public SqlTable
+{
+public:
+    SqlRTree(QSqlDatabase* database, const QString& tableName, const QString& sourceTable,
+             const QString& sourceKey, const QString& sourceColumn);
+
+    // Source column of the rows intersecting the box, one range per dimension
+    QVariantList selectIntersecting(const QVector<SqlRange>& box) const;
+
+private:
+    QSqlDatabase* const m_origin;
+    const QString m_sourceTable;
+    const QString m_sourceKey;
+    const QString m_sourceColumn;
+};
+} // namespace md::data_source
+
+#endif // SQL_RTREE_H
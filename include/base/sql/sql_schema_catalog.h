@@ -0,0 +1,83 @@
+#ifndef SQL_SCHEMA_CATALOG_H
+#define SQL_SCHEMA_CATALOG_H
+
+#include <atomic>
+
+#include <QHash>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QSqlDatabase>
+#include <QStringList>
+#include <QVector>
+
+namespace md::data_source
+{
+struct SqlColumn
+{
+    QString name;
+    QString type;
+    bool notNull = false;
+    bool primaryKey = false;
+};
+
+// Column metadata of one table, immutable until the catalog marks it stale
+class SqlTableInfo
+{
+public:
+    SqlTableInfo(const QString& tableName, const QVector<SqlColumn>& columns);
+
+    QString tableName() const;
+    const QVector<SqlColumn>& columns() const;
+    const QStringList& columnNames() const;
+
+    bool contains(const QString& column) const;
+    int indexOf(const QString& column) const;
+    QString type(const QString& column) const;
+    // Column declared as UUID, its values are stored as 16 byte blobs
+    bool isUuid(const QString& column) const;
+
+    // Schema has changed since, table info should be taken from the catalog again
+    bool isStale() const;
+    void markStale() const;
+
+    static QSharedPointer<SqlTableInfo> introspect(const QSqlDatabase& database,
+                                                   const QString& tableName);
+
+private:
+    const QString m_tableName;
+    const QVector<SqlColumn> m_columns;
+    QStringList m_columnNames;
+    QHash<QString, int> m_indexes;
+    mutable std::atomic<bool> m_stale = { false };
+};
+
+using SqlTableInfoPtr = QSharedPointer<const SqlTableInfo>;
+
+// Introspects every table once and shares the metadata by all tables of the database
+class SqlSchemaCatalog
+{
+public:
+    explicit SqlSchemaCatalog(const QSqlDatabase& origin);
+    ~SqlSchemaCatalog();
+
+    SqlSchemaCatalog(const SqlSchemaCatalog&) = delete;
+    SqlSchemaCatalog& operator=(const SqlSchemaCatalog&) = delete;
+
+    SqlTableInfoPtr table(const QString& tableName);
+    // Drop cached metadata after schema changes
+    void invalidate();
+    int generation() const;
+
+    // Table info from the catalog registered for the origin, or introspected directly
+    static SqlTableInfoPtr table(const QSqlDatabase& origin, const QString& tableName);
+    static void invalidate(const QSqlDatabase& origin);
+
+private:
+    const QSqlDatabase m_origin;
+    QHash<QString, SqlTableInfoPtr> m_tables;
+    int m_generation = 0;
+    mutable QMutex m_mutex;
+};
+} // namespace md::data_source
+
+#endif // SQL_SCHEMA_CATALOG_H
@@ -0,0 +1,103 @@
+#ifndef SQL_STATISTICS_H
+#define SQL_STATISTICS_H
+
+#include <array>
+#include <atomic>
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+
+namespace md::data_source
+{
+struct SqlStatementStats
+{
+    QString statement;
+    int count = 0;
+    // Rows returned by selects & rows changed by writes
+    qint64 rows = 0;
+    qint64 rowsAffected = 0;
+    qint64 totalUs = 0;
+    qint64 maxUs = 0;
+    // Percentiles are upper bounds of the power of two histogram buckets
+    qint64 p50Us = 0;
+    qint64 p95Us = 0;
+    qint64 p99Us = 0;
+};
+
+// Process wide execution statistics by normalized statement text
+class SqlStatistics
+{
+public:
+    static SqlStatistics* instance();
+
+    bool isEnabled() const;
+    void setEnabled(bool enabled);
+
+    // Statements running longer are logged, zero disables the log
+    int slowQueryThresholdMs() const;
+    void setSlowQueryThresholdMs(int threshold);
+
+    void record(const QString& statement, qint64 elapsedNs, qint64 rows,
+                qint64 rowsAffected = 0);
+
+    // Sorted by total time, most expensive first
+    QList<SqlStatementStats> statements() const;
+    SqlStatementStats statement(const QString& statement) const;
+    void reset();
+
+    // Bound value lists of variable length are folded, so IN (?, ?) and IN (?) are the same
+    static QString normalize(const QString& statement);
+
+private:
+    SqlStatistics() = default;
+
+    static constexpr int histogramBuckets = 32;
+
+    struct Entry
+    {
+        int count = 0;
+        qint64 rows = 0;
+        qint64 rowsAffected = 0;
+        qint64 totalUs = 0;
+        qint64 maxUs = 0;
+        std::array<int, histogramBuckets> histogram = {};
+    };
+
+    static SqlStatementStats stats(const QString& statement, const Entry& entry);
+
+    std::atomic<bool> m_enabled = { true };
+    std::atomic<int> m_slowQueryThresholdMs = { 200 };
+
+    QHash<QString, Entry> m_entries;
+    mutable QMutex m_mutex;
+};
+
+// Measures statement from creation to destruction, so row fetching counts too. Time of the
+// caller's work between the rows is left out with pause & resume
+class SqlStatementTimer
+{
+public:
+    explicit SqlStatementTimer(const QString& statement);
+    ~SqlStatementTimer();
+
+    SqlStatementTimer(const SqlStatementTimer&) = delete;
+    SqlStatementTimer& operator=(const SqlStatementTimer&) = delete;
+
+    void addRows(qint64 rows);
+    void addRowsAffected(qint64 rows);
+
+    void pause();
+    void resume();
+
+private:
+    const QString m_statement;
+    QElapsedTimer m_timer;
+    qint64 m_elapsedNs = 0;
+    bool m_paused = false;
+    qint64 m_rows = 0;
+    qint64 m_rowsAffected = 0;
+};
+} // namespace md::data_source
+
+#endif // SQL_STATISTICS_H
@@ -1,8 +1,19 @@
 #ifndef SQL_TABLE_H
 #define SQL_TABLE_H
 
+#include <functional>
+
+#include <QCache>
+#include <QHash>
+#include <QMutex>
+#include <QSharedPointer>
 #include <QSqlQuery>
 #include <QVariant>
+#include <QVector>
+
+#include "i_transaction.h"
+#include "page.h"
+#include "sql_schema_catalog.h"
 
 namespace md
 {
@@ -11,18 +22,35 @@ namespace data_source
 namespace sql
 {
 const QString hold = ":";
+const QString whereHold = ":where_";
 const QString comma = ", ";
+const QString rowid = "rowid";
+
+// Lowest SQLITE_MAX_VARIABLE_NUMBER default among supported versions
+constexpr int maxBoundValues = 999;
+
+// UUID strings are stored as 16 byte blobs, other values are kept as is
+QVariant toUuidBlob(const QVariant& value);
+QVariant fromUuidBlob(const QVariant& value);
 } // namespace sql
 
 using Condition = QPair<QString, QVariant>;
 using ConditionMap = QVariantMap;
+// Gets query positioned on the row, return false to stop iteration
+using RowVisitor = std::function<bool(const QSqlQuery& row)>;
+
+struct SqlStatementCacheStats
+{
+    int hits = 0;
+    int misses = 0;
+};
 
 class SqlTable
 {
 public:
     SqlTable(QSqlDatabase* database, const QString& tableName);
     SqlTable(QSqlDatabase* database, const QString& tableName, const QStringList& columnNames);
-    virtual ~SqlTable() = default;
+    virtual ~SqlTable();
 
     QList<QVariantMap> select(const ConditionMap& conditions = ConditionMap(),
                               const QStringList& resultColumns = QStringList()) const;
@@ -30,30 +58,86 @@ public:
                               const QStringList& orderByColumns,
                               Qt::SortOrder sortOrder = Qt::AscendingOrder) const;
     QVariantList selectOne(const ConditionMap& conditions, const QString& resultColumn) const;
+    bool selectEach(const ConditionMap& conditions, const QStringList& resultColumns,
+                    const RowVisitor& visitor, const QStringList& orderByColumns = {},
+                    Qt::SortOrder sortOrder = Qt::AscendingOrder) const;
+    // Page of rows continuing after the keyset of the request, keyColumn must be unique
+    domain::Page selectPage(const ConditionMap& conditions, const QStringList& resultColumns,
+                            const QString& keyColumn, const domain::PageRequest& request) const;
+    int count(const ConditionMap& conditions = ConditionMap()) const;
 
     bool insert(const QVariantMap& valueMap, QVariant* id = nullptr);
+    bool insertMany(const QList<QVariantMap>& valueMaps);
+
+    // Insert or update rows with the same unique key column
+    bool upsert(const QVariantMap& valueMap, const QString& keyColumn);
+    bool upsertMany(const QList<QVariantMap>& valueMaps, const QString& keyColumn);
+    // Existing rows get only updateColumns, nothing is updated for empty list
+    bool upsert(const QVariantMap& valueMap, const QString& keyColumn,
+                const QStringList& updateColumns);
+    bool upsertMany(const QList<QVariantMap>& valueMaps, const QString& keyColumn,
+                    const QStringList& updateColumns);
 
     bool removeByConditions(const ConditionMap& conditions);
     bool removeByCondition(const Condition& condition);
+    // Remove rows matching conditions with column value not in keptValues
+    bool removeExcept(const ConditionMap& conditions, const QString& column,
+                      const QVariantList& keptValues);
 
     bool updateByConditions(const QVariantMap& valueMap, const ConditionMap& conditions);
     bool updateByCondition(const QVariantMap& valueMap, const Condition& condition);
 
     QString tableName() const;
     QStringList columnNames() const;
+    // Shared column metadata, refreshed after schema changes
+    SqlTableInfoPtr tableInfo() const;
+
+    // Value in the storage form of the column and back, row visitors decode with fromStored
+    QVariant toStored(const QString& column, const QVariant& value) const;
+    QVariant fromStored(const QString& column, const QVariant& value) const;
+
+    domain::TransactionPtr transaction() const;
+
+    SqlStatementCacheStats statementCacheStats() const;
+    void clearStatementCache();
+    // Drops statements of the connection in every table, before the connection is removed
+    static void releaseConnection(const QString& connectionName);
 
 protected:
     QString prepareSelect(const QVariantMap& conditions, const QStringList& resultColumns = {},
                           const QStringList& sortColumns = {}, Qt::SortOrder sortOrder = {}) const;
     QString where(const QVariantMap& conditions) const;
     QVariantMap filterByColumns(const QVariantMap& valueMap);
+    bool writeMany(const QList<QVariantMap>& valueMaps, const QString& keyColumn,
+                   const QStringList* updateColumns);
+    bool insertBatch(const QStringList& names, const QVector<QVariantList>& values,
+                     const QString& keyColumn = QString(),
+                     const QStringList* updateColumns = nullptr);
+
+    void bind(QSqlQuery& query, const QVariantMap& valueMap) const;
+    void bindConditions(QSqlQuery& query, const QVariantMap& conditions) const;
 
-    void bind(QSqlQuery& query, const QVariantMap& valueMap);
+    // Called on every write with the conditions identifying the rows, empty for any row
+    virtual void rowsChanged(const ConditionMap& conditions);
+
+    // Connection of the current thread
+    QSqlDatabase database() const;
+    // Prepared statement for the query text, reused across calls
+    QSqlQuery cachedQuery(const QString& queryString) const;
 
 private:
+    // Replaces the values of the connection's temporary kept values table
+    bool fillKeptValues(const QVariantList& values) const;
+
     QSqlDatabase* const m_database;
     const QString m_tableName;
-    QStringList m_columnNames;
+    mutable SqlTableInfoPtr m_tableInfo;
+    mutable QMutex m_tableInfoMutex;
+
+    using StatementCachePtr = QSharedPointer<QCache<QString, QSqlQuery>>;
+    mutable QHash<QString, StatementCachePtr> m_statements;
+    mutable SqlStatementCacheStats m_statementCacheStats;
+    mutable QMutex m_statementsMutex;
 };
 
 } // namespace data_source
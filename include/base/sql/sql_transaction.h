@@ -0,0 +1,33 @@
+#ifndef SQL_TRANSACTION_H
+#define SQL_TRANSACTION_H
+
+#include <QSqlDatabase>
+
+#include "i_transaction.h"
+
+namespace md::data_source
+{
+// Savepoint based transaction, so guards can be nested freely
+class SqlTransaction : public domain::ITransaction
+{
+public:
+    explicit SqlTransaction(const QSqlDatabase& database);
+    ~SqlTransaction() override;
+
+    SqlTransaction(const SqlTransaction&) = delete;
+    SqlTransaction& operator=(const SqlTransaction&) = delete;
+
+    bool isActive() const override;
+
+    bool commit() override;
+    void rollback() override;
+
+private:
+    bool exec(const QString& queryString);
+
+    QSqlDatabase m_database;
+    bool m_active;
+};
+} // namespace md::data_source
+
+#endif // SQL_TRANSACTION_H
@@ -0,0 +1,47 @@
+#ifndef SQLITE_BACKUP_H
+#define SQLITE_BACKUP_H
+
+#include <QElapsedTimer>
+#include <QString>
+
+struct sqlite3;
+struct sqlite3_backup;
+
+namespace md::data_source
+{
+// Online copy of the main database of one connection into another, some pages per step.
+// Source stays usable between steps, its changes made through other connections restart the copy
+class SqliteBackup
+{
+public:
+    SqliteBackup(sqlite3* source, sqlite3* destination);
+    ~SqliteBackup();
+
+    SqliteBackup(const SqliteBackup&) = delete;
+    SqliteBackup& operator=(const SqliteBackup&) = delete;
+
+    // Copies up to the pages, negative for all of them. False on error, busy source isn't one
+    bool step(int pages);
+    // Release the copy, false if it failed or wasn't complete
+    bool finish();
+
+    bool isDone() const;
+    int pageCount() const;
+    int remaining() const;
+    // Since the creation of the backup
+    qint64 elapsedMs() const;
+    QString errorString() const;
+
+private:
+    sqlite3* const m_destination;
+    sqlite3_backup* m_backup;
+    bool m_done = false;
+    bool m_failed = false;
+    int m_pageCount = 0;
+    int m_remaining = 0;
+    QString m_errorString;
+    QElapsedTimer m_timer;
+};
+} // namespace md::data_source
+
+#endif // SQLITE_BACKUP_H
@@ -0,0 +1,15 @@
+#ifndef SQLITE_HANDLE_H
+#define SQLITE_HANDLE_H
+
+#include <QSqlDatabase>
+
+struct sqlite3;
+
+namespace md::data_source::sql
+{
+// Native handle of the opened connection, null for other drivers or when the SQLite version of
+// the connection differs from the linked library, as for a plugin with the bundled SQLite
+sqlite3* sqliteHandle(const QSqlDatabase& database);
+} // namespace md::data_source::sql
+
+#endif // SQLITE_HANDLE_H
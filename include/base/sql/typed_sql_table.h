@@ -0,0 +1,778 @@
+#ifndef TYPED_SQL_TABLE_H
+#define TYPED_SQL_TABLE_H
+
+#include <array>
+#include <optional>
+#include <tuple>
+#include <utility>
+
+#include <QCache>
+#include <QDebug>
+#include <QSqlError>
+
+#include "entity_serializer.h"
+#include "entity_sql_table.h"
+#include "sql_change_feed.h"
+#include "sql_statistics.h"
+
+namespace md::data_source
+{
+// Column of the row struct, name must be a string literal
+template<typename Row, typename T>
+struct TypedSqlColumn
+{
+    const char* name;
+    T Row::*field;
+};
+
+template<typename Row, typename T>
+constexpr TypedSqlColumn<Row, T> sqlColumn(const char* name, T Row::*field)
+{
+    return { name, field };
+}
+
+// Specialised for every row struct with the table name and the columns, key column goes first:
+// static constexpr char table[] = "vehicles";
+// static constexpr auto columns = std::make_tuple(sqlColumn("id", &VehicleRow::id), ...);
+template<typename Row>
+struct SqlRowSchema;
+
+// Conversion of the field type to the bound value and back
+template<typename T>
+struct SqlValue
+{
+    static QVariant toSql(const T& value, JsonEncoding encoding)
+    {
+        Q_UNUSED(encoding)
+        return QVariant::fromValue(value);
+    }
+    static T fromSql(const QVariant& value)
+    {
+        return value.value<T>();
+    }
+};
+
+// NULL is an empty optional
+template<typename T>
+struct SqlValue<std::optional<T>>
+{
+    static QVariant toSql(const std::optional<T>& value, JsonEncoding encoding)
+    {
+        return value ? SqlValue<T>::toSql(*value, encoding) : QVariant();
+    }
+    static std::optional<T> fromSql(const QVariant& value)
+    {
+        return value.isNull() ? std::nullopt : std::make_optional(SqlValue<T>::fromSql(value));
+    }
+};
+
+// JSON properties are written with the table encoding, reading accepts both
+template<>
+struct SqlValue<QVariantMap>
+{
+    static QVariant toSql(const QVariantMap& value, JsonEncoding encoding)
+    {
+        return sql::encodeJson(value, encoding);
+    }
+    static QVariantMap fromSql(const QVariant& value)
+    {
+        return sql::decodeJson(value);
+    }
+};
+
+namespace sql
+{
+// Field value as the untyped tables select it, JSON properties decoded
+template<typename T>
+QVariant fieldValue(const T& value)
+{
+    return QVariant::fromValue(value);
+}
+
+template<typename T>
+QVariant fieldValue(const std::optional<T>& value)
+{
+    return value ? fieldValue(*value) : QVariant();
+}
+
+// Field set from the value an entity or the untyped tables hand over
+template<typename T>
+void assignField(T& field, const QVariant& value)
+{
+    field = value.value<T>();
+}
+
+template<typename T>
+void assignField(std::optional<T>& field, const QVariant& value)
+{
+    field = value.isNull() ? std::nullopt : std::make_optional(value.value<T>());
+}
+
+// Calls the visitor with the field of the named column, false for a name out of the schema
+template<typename Row, typename Visitor>
+bool visitColumn(Row& row, const QString& name, Visitor&& visitor)
+{
+    bool found = false;
+    std::apply(
+        [&](const auto&... column) {
+            ((!found && name == QLatin1String(column.name)
+                  ? (visitor(row.*(column.field)), found = true)
+                  : false),
+             ...);
+        },
+        SqlRowSchema<std::remove_const_t<Row>>::columns);
+    return found;
+}
+
+template<typename Row>
+bool hasColumn(const QString& name)
+{
+    bool found = false;
+    std::apply(
+        [&](const auto&... column) {
+            ((found = found || name == QLatin1String(column.name)), ...);
+        },
+        SqlRowSchema<Row>::columns);
+    return found;
+}
+
+enum class Statement
+{
+    Select,
+    Insert,
+    Upsert,
+    Update,
+    Remove
+};
+
+// Statement text composed in a constant expression, first pass only measures it
+class SqlTextLength
+{
+public:
+    constexpr void append(const char* text)
+    {
+        for (std::size_t i = 0; text[i]; ++i)
+        {
+            m_size++;
+        }
+    }
+    constexpr std::size_t size() const
+    {
+        return m_size;
+    }
+
+private:
+    std::size_t m_size = 0;
+};
+
+template<std::size_t N>
+class SqlText
+{
+public:
+    constexpr void append(const char* text)
+    {
+        for (std::size_t i = 0; text[i]; ++i)
+        {
+            m_text[m_size++] = text[i];
+        }
+    }
+    constexpr const char* text() const
+    {
+        return m_text.data();
+    }
+
+private:
+    std::array<char, N + 1> m_text = {};
+    std::size_t m_size = 0;
+};
+
+enum class ColumnFormat
+{
+    Name,        // name
+    Placeholder, // ?
+    Assignment,  // name = ?
+    Excluded     // name = excluded.name
+};
+
+template<ColumnFormat format, typename Text>
+constexpr void appendColumn(Text& text, const char* name)
+{
+    if (format == ColumnFormat::Placeholder)
+    {
+        text.append("?");
+        return;
+    }
+
+    text.append(name);
+    if (format == ColumnFormat::Assignment)
+    {
+        text.append(" = ?");
+    }
+    else if (format == ColumnFormat::Excluded)
+    {
+        text.append(" = excluded.");
+        text.append(name);
+    }
+}
+
+// Comma separated columns starting from the first one
+template<typename Schema, ColumnFormat format, typename Text, std::size_t... I>
+constexpr void appendColumns(Text& text, std::size_t first, std::index_sequence<I...>)
+{
+    (((I >= first) ? ((I > first ? text.append(", ") : void()),
+                      appendColumn<format>(text, std::get<I>(Schema::columns).name))
+                   : void()),
+     ...);
+}
+
+template<typename Schema, ColumnFormat format, typename Text>
+constexpr void appendColumns(Text& text, std::size_t first = 0)
+{
+    appendColumns<Schema, format>(
+        text, first,
+        std::make_index_sequence<std::tuple_size_v<std::decay_t<decltype(Schema::columns)>>>());
+}
+
+template<typename Schema, Statement statement, typename Text>
+constexpr void composeStatement(Text& text)
+{
+    const char* key = std::get<0>(Schema::columns).name;
+
+    switch (statement)
+    {
+    case Statement::Select:
+        text.append("SELECT ");
+        appendColumns<Schema, ColumnFormat::Name>(text);
+        text.append(" FROM ");
+        text.append(Schema::table);
+        break;
+    case Statement::Insert:
+    case Statement::Upsert:
+        text.append("INSERT INTO ");
+        text.append(Schema::table);
+        text.append(" (");
+        appendColumns<Schema, ColumnFormat::Name>(text);
+        text.append(") VALUES (");
+        appendColumns<Schema, ColumnFormat::Placeholder>(text);
+        text.append(")");
+        if (statement == Statement::Upsert)
+        {
+            text.append(" ON CONFLICT(");
+            text.append(key);
+            text.append(") DO UPDATE SET ");
+            appendColumns<Schema, ColumnFormat::Excluded>(text, 1);
+        }
+        break;
+    case Statement::Update:
+        text.append("UPDATE ");
+        text.append(Schema::table);
+        text.append(" SET ");
+        appendColumns<Schema, ColumnFormat::Assignment>(text, 1);
+        text.append(" WHERE ");
+        text.append(key);
+        text.append(" = ?");
+        break;
+    case Statement::Remove:
+        text.append("DELETE FROM ");
+        text.append(Schema::table);
+        text.append(" WHERE ");
+        text.append(key);
+        text.append(" = ?");
+        break;
+    }
+}
+
+template<typename Schema, Statement statement>
+constexpr std::size_t statementLength()
+{
+    SqlTextLength length;
+    composeStatement<Schema, statement>(length);
+    return length.size();
+}
+
+template<typename Schema, Statement statement>
+constexpr SqlText<statementLength<Schema, statement>()> buildStatement()
+{
+    SqlText<statementLength<Schema, statement>()> text;
+    composeStatement<Schema, statement>(text);
+    return text;
+}
+
+// Text of the statement for the row schema, built by the compiler
+template<typename Schema, Statement statement>
+inline constexpr auto statementText = buildStatement<Schema, statement>();
+} // namespace sql
+
+// Entity reads its fields from the typed row, typed reads skip the QVariant
+template<typename Row>
+class TypedRowSource : public domain::IEntitySource
+{
+public:
+    explicit TypedRowSource(const Row& row) : m_row(row)
+    {
+    }
+
+    bool readValue(const QString& field, QVariant& value) const override
+    {
+        return sql::visitColumn(m_row, field, [&value](const auto& column) {
+            value = sql::fieldValue(column);
+        });
+    }
+
+    bool readString(const QString& field, QString& value) const override
+    {
+        return sql::visitColumn(m_row, field, [&value](const auto& column) {
+            if constexpr (std::is_same_v<std::decay_t<decltype(column)>, QString>)
+                value = column;
+            else
+                value = sql::fieldValue(column).toString();
+        });
+    }
+
+    bool readMap(const QString& field, QVariantMap& value) const override
+    {
+        return sql::visitColumn(m_row, field, [&value](const auto& column) {
+            if constexpr (std::is_same_v<std::decay_t<decltype(column)>, QVariantMap>)
+                value = column;
+            else
+                value = sql::fieldValue(column).toMap();
+        });
+    }
+
+private:
+    const Row m_row;
+};
+
+// Entity writes its fields into the typed row, fields out of the columns are skipped
+template<typename Row>
+class TypedRowSink : public domain::IEntitySink
+{
+public:
+    bool accepts(const QString& field) const override
+    {
+        return sql::hasColumn<Row>(field);
+    }
+
+    void writeValue(const QString& field, const QVariant& value) override
+    {
+        sql::visitColumn(m_row, field, [&value](auto& column) {
+            sql::assignField(column, value);
+        });
+    }
+
+    void writeString(const QString& field, const QString& value) override
+    {
+        sql::visitColumn(m_row, field, [&value](auto& column) {
+            if constexpr (std::is_same_v<std::decay_t<decltype(column)>, QString>)
+                column = value;
+            else
+                sql::assignField(column, value);
+        });
+    }
+
+    void writeMap(const QString& field, const QVariantMap& value) override
+    {
+        sql::visitColumn(m_row, field, [&value](auto& column) {
+            if constexpr (std::is_same_v<std::decay_t<decltype(column)>, QVariantMap>)
+                column = value;
+            else
+                sql::assignField(column, value);
+        });
+    }
+
+    const Row& row() const
+    {
+        return m_row;
+    }
+
+private:
+    Row m_row;
+};
+
+// Rows bound from and decoded into the fields of the row struct, without maps in between.
+// Entities are hydrated from the rows, which are cached by key like in EntitySqlTable
+template<typename Row>
+class TypedSqlTable : public SqlTable
+{
+public:
+    using Schema = SqlRowSchema<Row>;
+    static constexpr std::size_t columnCount =
+        std::tuple_size_v<std::decay_t<decltype(Schema::columns)>>;
+
+    explicit TypedSqlTable(QSqlDatabase* database,
+                           JsonEncoding jsonEncoding = JsonEncoding::Text) :
+        SqlTable(database, Schema::table),
+        m_jsonEncoding(jsonEncoding),
+        m_cache(0)
+    {
+        SqlChangeFeed* feed = SqlChangeFeed::feed(*database);
+        if (!feed)
+            return;
+
+        m_changeFeedConnection = QObject::connect(
+            feed, &SqlChangeFeed::changed, [this](const QList<SqlChange>& changes) {
+                for (const SqlChange& change : changes)
+                {
+                    if (change.table != this->tableName())
+                        continue;
+
+                    this->rowsChanged(change.id.isNull()
+                                          ? ConditionMap()
+                                          : ConditionMap({ { TypedSqlTable::keyColumn(),
+                                                             change.id } }));
+                }
+            });
+    }
+
+    ~TypedSqlTable() override
+    {
+        QObject::disconnect(m_changeFeedConnection);
+    }
+
+    static QString keyColumn()
+    {
+        return std::get<0>(Schema::columns).name;
+    }
+
+    static QStringList schemaColumns()
+    {
+        QStringList names;
+        std::apply(
+            [&names](const auto&... column) {
+                (names.append(column.name), ...);
+            },
+            Schema::columns);
+        return names;
+    }
+
+    // Column values of the row for the map based interfaces, JSON properties decoded
+    static QVariantMap toVariantMap(const Row& row)
+    {
+        QVariantMap map;
+        std::apply(
+            [&map, &row](const auto&... column) {
+                (map.insert(column.name, sql::fieldValue(row.*(column.field))), ...);
+            },
+            Schema::columns);
+        return map;
+    }
+
+    std::optional<Row> selectRow(const QVariant& id) const
+    {
+        {
+            QMutexLocker locker(&m_cacheMutex);
+            if (m_cache.maxCost() > 0)
+            {
+                if (const Row* cached = m_cache.object(id.toString()))
+                {
+                    m_cacheStats.hits++;
+                    return *cached;
+                }
+                m_cacheStats.misses++;
+            }
+        }
+
+        const quint64 generation = this->cacheGeneration();
+        const QList<Row> rows = this->selectRows({ { TypedSqlTable::keyColumn(), id } });
+        if (rows.isEmpty())
+            return std::nullopt;
+
+        // Rows read before a write of the later cache generation are dropped
+        QMutexLocker locker(&m_cacheMutex);
+        if (m_cache.maxCost() > 0 && generation == m_cacheGeneration)
+            m_cache.insert(id.toString(), new Row(rows.first()));
+        return rows.first();
+    }
+
+    // Rows in the stored order
+    QList<Row> selectRows(const ConditionMap& conditions = ConditionMap()) const
+    {
+        QSqlQuery query = this->cachedQuery(
+            QString(sql::statementText<Schema, sql::Statement::Select>.text()) +
+            this->where(conditions) + " ORDER BY " + sql::rowid);
+        this->bindConditions(query, conditions);
+
+        const std::array<bool, columnCount> uuids = this->uuidColumns();
+
+        QList<Row> rows;
+        SqlStatementTimer timer(query.lastQuery());
+        if (!query.exec())
+        {
+            qWarning() << query.lastQuery() << query.lastError();
+            return rows;
+        }
+        while (query.next())
+        {
+            timer.addRows(1);
+            rows.append(this->decodeRow(query, uuids, std::make_index_sequence<columnCount>()));
+        }
+        query.finish();
+        return rows;
+    }
+
+    using SqlTable::selectPage;
+    // Page of all columns with the key column as the key, JSON properties decoded
+    domain::Page selectPage(const ConditionMap& conditions,
+                            const domain::PageRequest& request) const
+    {
+        domain::Page page = SqlTable::selectPage(conditions, TypedSqlTable::schemaColumns(),
+                                                 TypedSqlTable::keyColumn(), request);
+        for (QVariantMap& map : page.rows)
+        {
+            std::apply(
+                [&map](const auto&... column) {
+                    (TypedSqlTable::decodeJsonColumn(map, column), ...);
+                },
+                Schema::columns);
+        }
+        return page;
+    }
+
+    bool insertRow(const Row& row)
+    {
+        return this->write<sql::Statement::Insert>(row);
+    }
+
+    // All rows or none of them
+    bool insertRows(const QList<Row>& rows)
+    {
+        domain::TransactionPtr transaction = this->transaction();
+        for (const Row& row : rows)
+        {
+            if (!this->write<sql::Statement::Insert>(row))
+                return false;
+        }
+        return transaction->commit();
+    }
+
+    bool upsertRow(const Row& row)
+    {
+        return this->write<sql::Statement::Upsert>(row);
+    }
+
+    bool updateRow(const Row& row)
+    {
+        return this->write<sql::Statement::Update>(row);
+    }
+
+    bool removeRow(const QVariant& id)
+    {
+        QSqlQuery query =
+            this->cachedQuery(sql::statementText<Schema, sql::Statement::Remove>.text());
+        query.bindValue(0, this->uuidColumns()[0] ? sql::toUuidBlob(id) : id);
+        return this->exec(query, id);
+    }
+
+    // Row of the entity fields, columns the entity doesn't write keep the Row defaults
+    static Row entityRow(const domain::Entity* entity)
+    {
+        TypedRowSink<Row> sink;
+        entity->serialize(sink);
+        return sink.row();
+    }
+
+    // Written entities are marked clean
+    bool insertEntity(domain::Entity* entity)
+    {
+        if (!this->insertRow(TypedSqlTable::entityRow(entity)))
+            return false;
+
+        entity->markClean();
+        return true;
+    }
+
+    void readEntity(domain::Entity* entity) const
+    {
+        const std::optional<Row> row = this->selectRow(entity->id);
+        if (row)
+            entity->deserialize(TypedRowSource<Row>(*row));
+        entity->markClean();
+    }
+
+    // Whole row is written, unless no column is dirty
+    bool updateEntity(domain::Entity* entity)
+    {
+        bool dirty = !entity->isPersisted();
+        for (const QString& field : entity->dirtyFields())
+        {
+            dirty = dirty || sql::hasColumn<Row>(field);
+        }
+        if (dirty && !this->updateRow(TypedSqlTable::entityRow(entity)))
+            return false;
+
+        entity->markClean();
+        return true;
+    }
+
+    bool removeEntity(domain::Entity* entity)
+    {
+        return this->removeRow(entity->id);
+    }
+
+    JsonEncoding jsonEncoding() const
+    {
+        return m_jsonEncoding;
+    }
+
+    // Decoded rows by key, invalidated by writes through this table & the change feed. Zero
+    // capacity disables it
+    void setCacheCapacity(int capacity)
+    {
+        QMutexLocker locker(&m_cacheMutex);
+        m_cache.setMaxCost(capacity);
+    }
+
+    int cacheCapacity() const
+    {
+        QMutexLocker locker(&m_cacheMutex);
+        return m_cache.maxCost();
+    }
+
+    EntityCacheStats cacheStats() const
+    {
+        QMutexLocker locker(&m_cacheMutex);
+        return m_cacheStats;
+    }
+
+    // Rows changed bypassing this table, like writes through an EntitySqlTable
+    void invalidateCache(const ConditionMap& conditions)
+    {
+        this->rowsChanged(conditions);
+    }
+
+protected:
+    void rowsChanged(const ConditionMap& conditions) override
+    {
+        QMutexLocker locker(&m_cacheMutex);
+        m_cacheGeneration++;
+        if (m_cache.isEmpty())
+            return;
+
+        if (conditions.isEmpty())
+        {
+            m_cache.clear();
+            return;
+        }
+
+        if (conditions.contains(TypedSqlTable::keyColumn()))
+        {
+            m_cache.remove(conditions.value(TypedSqlTable::keyColumn()).toString());
+            return;
+        }
+
+        // No key, drop every cached row matching the conditions, unknown columns match any
+        for (const QString& key : m_cache.keys())
+        {
+            const Row* row = m_cache.object(key);
+            bool matches = true;
+            for (auto it = conditions.constBegin(); it != conditions.constEnd() && matches; ++it)
+            {
+                QVariant value;
+                if (!sql::visitColumn(*row, it.key(), [&value](const auto& column) {
+                        value = sql::fieldValue(column);
+                    }))
+                    continue;
+
+                matches = it.value().isNull() ? value.isNull() : value == it.value();
+            }
+            if (matches)
+                m_cache.remove(key);
+        }
+    }
+
+private:
+    quint64 cacheGeneration() const
+    {
+        QMutexLocker locker(&m_cacheMutex);
+        return m_cacheGeneration;
+    }
+
+    template<typename T>
+    static void decodeJsonColumn(QVariantMap& map, const TypedSqlColumn<Row, T>& column)
+    {
+        if constexpr (std::is_same_v<T, QVariantMap>)
+            map.insert(column.name, sql::decodeJson(map.value(column.name)));
+    }
+
+    std::array<bool, columnCount> uuidColumns() const
+    {
+        const SqlTableInfoPtr info = this->tableInfo();
+
+        std::array<bool, columnCount> uuids = {};
+        std::apply(
+            [&uuids, &info](const auto&... column) {
+                std::size_t index = 0;
+                ((uuids[index++] = info->isUuid(column.name)), ...);
+            },
+            Schema::columns);
+        return uuids;
+    }
+
+    template<std::size_t... I>
+    static Row decodeRow(const QSqlQuery& query, const std::array<bool, columnCount>& uuids,
+                         std::index_sequence<I...>)
+    {
+        Row row;
+        (decodeField(row, std::get<I>(Schema::columns).field, query.value(int(I)), uuids[I]),
+         ...);
+        return row;
+    }
+
+    template<typename T>
+    static void decodeField(Row& row, T Row::*field, const QVariant& value, bool uuid)
+    {
+        row.*field = SqlValue<T>::fromSql(uuid ? sql::fromUuidBlob(value) : value);
+    }
+
+    template<typename T>
+    static void bindField(QSqlQuery& query, int position, const Row& row, T Row::*field,
+                          bool uuid, JsonEncoding encoding)
+    {
+        const QVariant value = SqlValue<T>::toSql(row.*field, encoding);
+        query.bindValue(position, uuid ? sql::toUuidBlob(value) : value);
+    }
+
+    // Update binds the key after the other columns
+    template<std::size_t... I>
+    static void bindRow(QSqlQuery& query, const Row& row,
+                        const std::array<bool, columnCount>& uuids, bool keyLast,
+                        JsonEncoding encoding, std::index_sequence<I...>)
+    {
+        (bindField(query, keyLast ? int((I + columnCount - 1) % columnCount) : int(I), row,
+                   std::get<I>(Schema::columns).field, uuids[I], encoding),
+         ...);
+    }
+
+    template<sql::Statement statement>
+    bool write(const Row& row)
+    {
+        QSqlQuery query = this->cachedQuery(sql::statementText<Schema, statement>.text());
+        this->bindRow(query, row, this->uuidColumns(), statement == sql::Statement::Update,
+                      m_jsonEncoding, std::make_index_sequence<columnCount>());
+
+        const auto key = std::get<0>(Schema::columns).field;
+        return this->exec(query, sql::fieldValue(row.*key));
+    }
+
+    bool exec(QSqlQuery& query, const QVariant& id)
+    {
+        SqlStatementTimer timer(query.lastQuery());
+        bool result = query.exec();
+        timer.addRowsAffected(query.numRowsAffected());
+        if (query.lastError().type() != QSqlError::NoError)
+            qWarning() << query.lastQuery() << query.lastError();
+        this->rowsChanged({ { TypedSqlTable::keyColumn(), id } });
+        return result;
+    }
+
+    const JsonEncoding m_jsonEncoding;
+
+    mutable QCache<QString, Row> m_cache;
+    mutable EntityCacheStats m_cacheStats;
+    quint64 m_cacheGeneration = 0;
+    mutable QMutex m_cacheMutex;
+    QMetaObject::Connection m_changeFeedConnection;
+};
+} // namespace md::data_source
+
+#endif // TYPED_SQL_TABLE_H
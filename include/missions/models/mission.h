@@ -20,7 +20,7 @@ public:
     utils::Property<QVariant> vehicleId;
     utils::ConstProperty<MissionRoute*> route;
 
-    QVariantMap toVariantMap() const override;
+    void serialize(IEntitySink& sink) const override;
 
 public slots:
     void clear();
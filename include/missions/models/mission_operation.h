@@ -34,7 +34,7 @@ public:
     utils::Property<int> total;
 
     bool isComplete() const;
-    QVariantMap toVariantMap() const override;
+    void serialize(IEntitySink& sink) const override;
 
     Q_ENUM(Type);
 };
@@ -28,6 +28,7 @@ public:
 public slots:
     void setItems(const QList<MissionRouteItem*>& items);
     void addItem(MissionRouteItem* item);
+    void insertItem(int index, MissionRouteItem* item);
     void removeItem(MissionRouteItem* item);
     void clear();
 
@@ -20,8 +20,8 @@ public:
     utils::Property<bool> current;
     utils::Property<bool> reached;
 
-    QVariantMap toVariantMap() const override;
-    void fromVariantMap(const QVariantMap& map) override;
+    void serialize(IEntitySink& sink) const override;
+    void deserialize(const IEntitySource& source) override;
 
     const MissionItemType* type() const;
 
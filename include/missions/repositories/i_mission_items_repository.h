@@ -1,7 +1,10 @@
 #ifndef I_MISSION_ITEMS_REPOSITORY_H
 #define I_MISSION_ITEMS_REPOSITORY_H
 
+#include "geodetic_rect.h"
+#include "i_transaction.h"
 #include "mission_route_item.h"
+#include "page.h"
 
 namespace md::domain
 {
@@ -11,14 +14,27 @@ public:
     IMissionItemsRepository() = default;
     virtual ~IMissionItemsRepository() = default;
 
+    virtual TransactionPtr transaction() = 0;
+
     virtual QVariantMap select(const QVariant& itemId) = 0;
     virtual QVariantList selectMissionRouteItemIds(const QVariant& missionId) = 0;
+    virtual QList<QVariantMap> selectMissionItems(const QVariant& missionId) = 0;
+    virtual Page selectMissionItemsPage(const QVariant& missionId, const PageRequest& request) = 0;
+    virtual QVariantList selectItemIdsInRect(const GeodeticRect& rect) = 0;
 
-    virtual void insert(MissionRouteItem* item, const QVariant& missionId) = 0;
+    virtual bool insert(MissionRouteItem* item, const QVariant& missionId) = 0;
+    virtual bool insertItems(const QList<MissionRouteItem*>& items, const QVariant& missionId) = 0;
+    virtual bool upsert(MissionRouteItem* item, const QVariant& missionId) = 0;
+    virtual bool upsertItems(const QList<MissionRouteItem*>& items, const QVariant& missionId) = 0;
     virtual void read(MissionRouteItem* item) = 0;
-    virtual void update(MissionRouteItem* item) = 0;
-    virtual void remove(MissionRouteItem* item) = 0;
-    virtual void removeById(const QVariant& id) = 0;
+    virtual bool update(MissionRouteItem* item) = 0;
+    virtual bool remove(MissionRouteItem* item) = 0;
+    virtual bool removeById(const QVariant& id) = 0;
+    virtual bool removeByIds(const QVariantList& ids) = 0;
+    virtual bool removeMissionItemsExcept(const QVariant& missionId,
+                                          const QVariantList& keptIds) = 0;
+    // Items deleted by the storage along with their mission, like cascade deletes
+    virtual void forgetMissionItems(const QVariant& missionId) = 0;
 };
 } // namespace md::domain
 
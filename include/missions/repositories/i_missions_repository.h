@@ -1,24 +1,38 @@
 #ifndef I_MISSIONS_REPOSITORY_H
 #define I_MISSIONS_REPOSITORY_H
 
+#include "i_transaction.h"
 #include "mission.h"
+#include "page.h"
 
 namespace md::domain
 {
+// Stored mission with its items in the route order, empty mission if there is none
+struct MissionRecord
+{
+    QVariantMap mission;
+    QList<QVariantMap> items;
+};
+
 class IMissionsRepository
 {
 public:
     IMissionsRepository() = default;
     virtual ~IMissionsRepository() = default;
 
+    virtual TransactionPtr transaction() = 0;
+
     virtual QVariantMap select(const QVariant& missionId) = 0;
+    virtual MissionRecord selectWithItems(const QVariant& missionId) = 0;
     virtual QVariantList selectMissionIds() = 0;
+    virtual Page selectPage(const PageRequest& request) = 0;
     virtual QVariant selectMissionIdForVehicle(const QVariant& vehicleId) = 0;
 
-    virtual void insert(Mission* mission) = 0;
+    virtual bool insert(Mission* mission) = 0;
+    virtual bool upsert(Mission* mission) = 0;
     virtual void read(Mission* mission) = 0;
-    virtual void update(Mission* mission) = 0;
-    virtual void remove(Mission* mission) = 0;
+    virtual bool update(Mission* mission) = 0;
+    virtual bool remove(Mission* mission) = 0;
 };
 } // namespace md::domain
 
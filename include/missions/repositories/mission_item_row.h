@@ -0,0 +1,39 @@
+#ifndef MISSION_ITEM_ROW_H
+#define MISSION_ITEM_ROW_H
+
+#include "typed_sql_table.h"
+
+namespace md::data_source
+{
+struct MissionItemRow
+{
+    QString id;
+    QString name;
+    QVariantMap params;
+    QVariantMap position;
+    QString type;
+    QString mission;
+    // Native coordinates, NULL for items without a valid position
+    std::optional<double> latitude;
+    std::optional<double> longitude;
+    std::optional<double> altitude;
+};
+
+template<>
+struct SqlRowSchema<MissionItemRow>
+{
+    static constexpr char table[] = "mission_items";
+    static constexpr auto columns = std::make_tuple(
+        sqlColumn("id", &MissionItemRow::id), sqlColumn("name", &MissionItemRow::name),
+        sqlColumn("params", &MissionItemRow::params),
+        sqlColumn("position", &MissionItemRow::position), sqlColumn("type", &MissionItemRow::type),
+        sqlColumn("mission", &MissionItemRow::mission),
+        sqlColumn("latitude", &MissionItemRow::latitude),
+        sqlColumn("longitude", &MissionItemRow::longitude),
+        sqlColumn("altitude", &MissionItemRow::altitude));
+};
+
+using MissionItemsSqlTable = TypedSqlTable<MissionItemRow>;
+} // namespace md::data_source
+
+#endif // MISSION_ITEM_ROW_H
@@ -3,6 +3,8 @@
 
 #include "entity_sql_table.h"
 #include "i_mission_items_repository.h"
+#include "mission_item_row.h"
+#include "sql_rtree.h"
 
 namespace md::data_source
 {
@@ -11,17 +13,41 @@ class MissionItemsRepositorySql : public domain::IMissionItemsRepository
 public:
     explicit MissionItemsRepositorySql(QSqlDatabase* database);
 
+    domain::TransactionPtr transaction() override;
+
     QVariantMap select(const QVariant& itemId) override;
     QVariantList selectMissionRouteItemIds(const QVariant& missionId) override;
+    QList<QVariantMap> selectMissionItems(const QVariant& missionId) override;
+    domain::Page selectMissionItemsPage(const QVariant& missionId,
+                                        const domain::PageRequest& request) override;
+    QVariantList selectItemIdsInRect(const domain::GeodeticRect& rect) override;
 
-    void insert(domain::MissionRouteItem* item, const QVariant& missionId) override;
+    bool insert(domain::MissionRouteItem* item, const QVariant& missionId) override;
+    bool insertItems(const QList<domain::MissionRouteItem*>& items,
+                     const QVariant& missionId) override;
+    bool upsert(domain::MissionRouteItem* item, const QVariant& missionId) override;
+    bool upsertItems(const QList<domain::MissionRouteItem*>& items,
+                     const QVariant& missionId) override;
     void read(domain::MissionRouteItem* item) override;
-    void update(domain::MissionRouteItem* item) override;
-    void remove(domain::MissionRouteItem* item) override;
-    void removeById(const QVariant& id) override;
+    bool update(domain::MissionRouteItem* item) override;
+    bool remove(domain::MissionRouteItem* item) override;
+    bool removeById(const QVariant& id) override;
+    bool removeByIds(const QVariantList& ids) override;
+    bool removeMissionItemsExcept(const QVariant& missionId, const QVariantList& keptIds) override;
+    void forgetMissionItems(const QVariant& missionId) override;
 
 private:
+    void rowsWritten(const QList<domain::MissionRouteItem*>& items);
+    QStringList dirtyColumns(domain::MissionRouteItem* item) const;
+    QVariantMap itemToMap(domain::MissionRouteItem* item, const QStringList& columns);
+    QList<QVariantMap> itemsToMaps(const QList<domain::MissionRouteItem*>& items,
+                                   const QVariant& missionId);
+
+    // Writes, map reads of whole missions & pages
     EntitySqlTable m_routeItemsTable;
+    // Entities are hydrated from the cached typed rows
+    MissionItemsSqlTable m_itemRows;
+    SqlRTree m_positionsTree;
 };
 } // namespace md::data_source
 
@@ -11,17 +11,25 @@ class MissionsRepositorySql : public domain::IMissionsRepository
 public:
     MissionsRepositorySql(QSqlDatabase* database);
 
+    domain::TransactionPtr transaction() override;
+
     QVariantMap select(const QVariant& missionId) override;
+    // Mission and item rows read in one transaction, two statements whatever the items count
+    domain::MissionRecord selectWithItems(const QVariant& missionId) override;
     QVariantList selectMissionIds() override;
+    domain::Page selectPage(const domain::PageRequest& request) override;
     QVariant selectMissionIdForVehicle(const QVariant& vehicleId) override;
 
-    void insert(domain::Mission* mission) override;
+    bool insert(domain::Mission* mission) override;
+    bool upsert(domain::Mission* mission) override;
     void read(domain::Mission* mission) override;
-    void update(domain::Mission* mission) override;
-    void remove(domain::Mission* mission) override;
+    bool update(domain::Mission* mission) override;
+    bool remove(domain::Mission* mission) override;
 
 private:
     EntitySqlTable m_missionsTable;
+    // Items of the whole mission, read past the cache
+    EntitySqlTable m_itemsTable;
 };
 } // namespace md::data_source
 
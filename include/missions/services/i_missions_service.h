@@ -47,6 +47,9 @@ public slots:
     virtual void saveMission(Mission* mission) = 0;
     virtual void saveItem(MissionRoute* route, MissionRouteItem* item) = 0;
     virtual void restoreItem(MissionRoute* route, MissionRouteItem* item) = 0;
+    // Missions & items written to the storage aside, ones missing there are removed
+    virtual void refreshMissions(const QVariantList& missionIds) = 0;
+    virtual void refreshItems(const QVariantList& itemIds) = 0;
 
 signals:
     void missionTypesChanged();
@@ -4,8 +4,10 @@
 #include "i_mission_items_repository.h"
 #include "i_missions_repository.h"
 #include "i_missions_service.h"
+#include "persistence_queue.h"
 
 #include <QMutex>
+#include <QPointer>
 
 namespace md::domain
 {
@@ -14,8 +16,9 @@ class MissionsService : public IMissionsService
     Q_OBJECT
 
 public:
+    // Writes go through the persistence queue if any, otherwise they are done in place
     MissionsService(IMissionsRepository* missionsRepo, IMissionItemsRepository* itemsRepo,
-                    QObject* parent = nullptr);
+                    PersistenceQueue* persistence = nullptr, QObject* parent = nullptr);
 
     Mission* mission(const QVariant& id) const override;
     Mission* missionForVehicle(const QVariant& vehicleId) const override;
@@ -47,16 +50,36 @@ public slots:
     void saveMission(Mission* mission) override;
     void saveItem(MissionRoute* route, MissionRouteItem* item) override;
     void restoreItem(MissionRoute* route, MissionRouteItem* item) override;
+    void refreshMissions(const QVariantList& missionIds) override;
+    void refreshItems(const QVariantList& itemIds) override;
 
 private:
     Mission* readMission(const QVariant& id);
-    MissionRouteItem* readItem(const QVariant& id);
-    void saveItemImpl(MissionRouteItem* item, const QVariant& parentId, const QVariantList& itemIds);
+    MissionRouteItem* readItem(const QVariantMap& map);
+    void restoreMissionImpl(Mission* mission);
     void restoreItemImpl(MissionRouteItem* item);
-    void removeItems(const QVariantList& itemsIds);
+
+    // Mission with items, write is insert, update or upsert
+    bool storeMission(Mission* mission, bool (IMissionsRepository::*write)(Mission*));
+    bool deleteMission(Mission* mission);
+
+    // Detached copies written in the persistence thread, with the dirty fields of the originals
+    QSharedPointer<Mission> snapshotMission(Mission* mission) const;
+    QSharedPointer<MissionRouteItem> snapshotItem(MissionRouteItem* item) const;
+    // Written is called in the service thread with the result of the committed write
+    void enqueueWrite(const QString& key, const PersistenceQueue::Write& write,
+                      const PersistenceQueue::Finished& written);
+    // Originals are marked clean unless they were changed after the snapshot
+    void missionWritten(const QPointer<Mission>& mission, const Mission* written, bool ok);
+    void itemWritten(const QPointer<MissionRouteItem>& item, const MissionRouteItem* written,
+                     bool ok);
+    // Read runs once the writes still in the queue are done, right away if there are none
+    void afterWrites(const std::function<void()>& read);
+    bool isWritePending(const QVariant& id) const;
 
     IMissionsRepository* const m_missionsRepo;
     IMissionItemsRepository* const m_itemsRepo;
+    PersistenceQueue* const m_persistence;
 
     QMap<QString, const MissionType*> m_missionTypes;
     QMap<QVariant, Mission*> m_missions;
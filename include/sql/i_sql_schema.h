@@ -3,6 +3,8 @@
 
 #include <QSqlDatabase>
 
+#include "i_transaction.h"
+
 namespace md::data_source
 {
 class ISqlSchema
@@ -12,6 +14,7 @@ public:
     virtual ~ISqlSchema() = default;
 
     virtual QSqlDatabase* db() = 0;
+    virtual domain::TransactionPtr transaction() = 0;
 
     virtual void setup() = 0;
 };
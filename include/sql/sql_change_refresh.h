@@ -0,0 +1,15 @@
+#ifndef SQL_CHANGE_REFRESH_H
+#define SQL_CHANGE_REFRESH_H
+
+#include "i_missions_service.h"
+#include "i_vehicles_service.h"
+#include "sql_change_feed.h"
+
+namespace md::data_source
+{
+// Services refresh only the entities changed in the storage instead of reading all of them
+QMetaObject::Connection refreshOnChanges(SqlChangeFeed* feed, domain::IVehiclesService* service);
+QMetaObject::Connection refreshOnChanges(SqlChangeFeed* feed, domain::IMissionsService* service);
+} // namespace md::data_source
+
+#endif // SQL_CHANGE_REFRESH_H
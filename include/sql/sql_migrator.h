@@ -0,0 +1,37 @@
+#ifndef SQL_MIGRATOR_H
+#define SQL_MIGRATOR_H
+
+#include <functional>
+
+#include <QSqlDatabase>
+#include <QStringList>
+#include <QVector>
+
+namespace md::data_source
+{
+struct SqlMigration
+{
+    QString version;
+    QStringList statements;
+    // Optional data conversion, runs after the statements in the same transaction
+    std::function<bool(QSqlDatabase& database)> step = nullptr;
+};
+
+// Applies migrations missing in schema_version table, in the given order
+class SqlMigrator
+{
+public:
+    explicit SqlMigrator(const QSqlDatabase& database);
+
+    QStringList appliedVersions() const;
+
+    bool migrate(const QVector<SqlMigration>& migrations);
+
+private:
+    bool apply(const SqlMigration& migration);
+
+    QSqlDatabase m_database;
+};
+} // namespace md::data_source
+
+#endif // SQL_MIGRATOR_H
@@ -0,0 +1,25 @@
+#ifndef SQLITE_PROFILE_H
+#define SQLITE_PROFILE_H
+
+#include <QString>
+
+namespace md::data_source
+{
+// Connection level SQLite settings, applied on database open
+struct SqliteProfile
+{
+    QString journalMode;
+    QString synchronous;
+    qint64 mmapSize;
+    int cacheSize; // Pages if positive, KiB if negative
+    QString tempStore;
+    int busyTimeout; // ms
+
+    // WAL with full sync, safe for power loss
+    static SqliteProfile durable();
+    // WAL with relaxed sync, memory mapping and big page cache
+    static SqliteProfile fast();
+};
+} // namespace md::data_source
+
+#endif // SQLITE_PROFILE_H
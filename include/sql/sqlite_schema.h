@@ -1,21 +1,103 @@
 #ifndef SQLITE_SCHEMA_H
 #define SQLITE_SCHEMA_H
 
+#include <memory>
+#include <optional>
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QTimer>
+
 #include "i_sql_schema.h"
+#include "sql_change_feed.h"
+#include "sql_connection_pool.h"
+#include "sql_schema_catalog.h"
+#include "sqlite_backup.h"
+#include "sqlite_profile.h"
 
 namespace md::data_source
 {
+// Working set in memory, restored from the database file on setup and copied back to it with the
+// online backup API periodically and on destruction, closing the database drops the unsaved data
+struct SqliteMemoryMode
+{
+    int backupIntervalMs = 60000; // Zero leaves only the backups on demand and on destruction
+    int pagesPerStep = 256;       // Negative copies the whole database at once
+};
+
+struct SqliteBackupStats
+{
+    int backups = 0;
+    int failures = 0;
+    qint64 lastDurationMs = 0;
+    qint64 lastBytes = 0;
+    QDateTime lastBackupTime;
+    // Not on disk yet: rows changed since the start of the last good backup and time since then
+    qint64 rowsAtRisk = 0;
+    qint64 msAtRisk = 0;
+};
+
 class SqliteSchema : public ISqlSchema
 {
 public:
-    SqliteSchema(const QString& databaseName);
+    SqliteSchema(const QString& databaseName,
+                 const SqliteProfile& profile = SqliteProfile::durable());
+    SqliteSchema(const QString& databaseName, const SqliteProfile& profile,
+                 const SqliteMemoryMode& memoryMode);
+    ~SqliteSchema() override;
 
     QSqlDatabase* db() override;
+    domain::TransactionPtr transaction() override;
 
     void setup() override;
 
+    const SqliteProfile& profile() const;
+    QVariantMap activeSettings();
+
+    // Connection for the current thread, repositories pick it up through the pool as well
+    QSqlDatabase connection();
+    SqlConnectionPool* pool();
+    // Column metadata shared by all tables of the database
+    SqlSchemaCatalog* catalog();
+    // Rows written through the connections of the database, published per commit
+    SqlChangeFeed* changeFeed();
+
+    bool isInMemory() const;
+    // Copy the whole database to the file now, false on failure and for the file mode
+    bool backup();
+    SqliteBackupStats backupStats() const;
+
 private:
+    void applyProfile(QSqlDatabase& database);
+
+    bool restore();
+    void startBackup();
+    void stepBackup();
+    bool finishBackup();
+
     QSqlDatabase m_db;
+    const SqliteProfile m_profile;
+    // Outlives the pool, so the released connections don't call it
+    SqlChangeFeed m_changeFeed;
+    SqlConnectionPool m_pool;
+    SqlSchemaCatalog m_catalog;
+
+    QString m_filePath;
+    std::optional<SqliteMemoryMode> m_memoryMode;
+    std::unique_ptr<SqliteBackup> m_backup;
+    sqlite3* m_backupFile = nullptr;
+    int m_backupRemaining = 0;
+    int m_backupRestarts = 0;
+    QTimer m_backupTimer;
+    QTimer m_stepTimer;
+
+    SqliteBackupStats m_backupStats;
+    QElapsedTimer m_clock;
+    qint64 m_rowsChanged = 0;
+    qint64 m_rowsBackedUp = 0;
+    qint64 m_rowsAtBackupStart = 0;
+    qint64 m_backupStartMs = 0;
+    qint64 m_lastGoodBackupMs = 0;
 };
 } // namespace md::data_source
 
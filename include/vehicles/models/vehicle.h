@@ -19,7 +19,7 @@ public:
     utils::ConstProperty<const VehicleType*> type;
     utils::Property<bool> online;
 
-    QVariantMap toVariantMap() const override;
+    void serialize(IEntitySink& sink) const override;
 };
 } // namespace md::domain
 
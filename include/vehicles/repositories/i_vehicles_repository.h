@@ -1,6 +1,7 @@
 #ifndef I_VEHICLES_REPOSITORY_H
 #define I_VEHICLES_REPOSITORY_H
 
+#include "page.h"
 #include "vehicle.h"
 
 namespace md::domain
@@ -13,6 +14,7 @@ public:
 
     virtual QVariantList selectVehicleIds() = 0;
     virtual QVariantMap select(const QVariant& vehicleId) = 0;
+    virtual Page selectPage(const PageRequest& request) = 0;
 
     virtual void insert(Vehicle* vehicle) = 0;
     virtual void read(Vehicle* vehicle) = 0;
@@ -0,0 +1,29 @@
+#ifndef VEHICLE_ROW_H
+#define VEHICLE_ROW_H
+
+#include "typed_sql_table.h"
+
+namespace md::data_source
+{
+struct VehicleRow
+{
+    QString id;
+    QString name;
+    QVariantMap params;
+    QString type;
+};
+
+template<>
+struct SqlRowSchema<VehicleRow>
+{
+    static constexpr char table[] = "vehicles";
+    static constexpr auto columns = std::make_tuple(sqlColumn("id", &VehicleRow::id),
+                                                    sqlColumn("name", &VehicleRow::name),
+                                                    sqlColumn("params", &VehicleRow::params),
+                                                    sqlColumn("type", &VehicleRow::type));
+};
+
+using VehiclesSqlTable = TypedSqlTable<VehicleRow>;
+} // namespace md::data_source
+
+#endif // VEHICLE_ROW_H
@@ -1,8 +1,8 @@
 #ifndef VEHICLES_REPOSITORY_SQL_H
 #define VEHICLES_REPOSITORY_SQL_H
 
-#include "entity_sql_table.h"
 #include "i_vehicles_repository.h"
+#include "vehicle_row.h"
 
 namespace md::data_source
 {
@@ -13,6 +13,7 @@ public:
 
     QVariantList selectVehicleIds() override;
     QVariantMap select(const QVariant& vehicleId) override;
+    domain::Page selectPage(const domain::PageRequest& request) override;
 
     void insert(domain::Vehicle* vehicle) override;
     void read(domain::Vehicle* vehicle) override;
@@ -20,7 +21,7 @@ public:
     void remove(domain::Vehicle* vehicle) override;
 
 private:
-    EntitySqlTable m_vehiclesTable;
+    VehiclesSqlTable m_vehiclesTable;
 };
 } // namespace md::data_source
 
@@ -30,6 +30,8 @@ public slots:
     virtual void saveVehicle(Vehicle* vehicle) = 0;
     virtual void addVehicleType(const VehicleType* type) = 0;
     virtual void removeVehicleType(const VehicleType* type) = 0;
+    // Vehicles written to the storage aside, ones missing there are removed
+    virtual void refreshVehicles(const QVariantList& vehicleIds) = 0;
 
 signals:
     void vehicleAdded(Vehicle* vehicle);
@@ -28,6 +28,7 @@ public slots:
     void saveVehicle(Vehicle* vehicle) override;
     void addVehicleType(const VehicleType* type) override;
     void removeVehicleType(const VehicleType* type) override;
+    void refreshVehicles(const QVariantList& vehicleIds) override;
 
 private:
     Vehicle* readVehicle(const QVariant& id);
@@ -1,5 +1,7 @@
 #include "entity.h"
 
+#include "entity_serializer.h"
+
 using namespace md::domain;
 
 Entity::Entity(const QVariant& id, QObject* parent) : QObject(parent), id(id)
@@ -10,15 +12,71 @@ Entity::~Entity()
 {
 }
 
+void Entity::serialize(IEntitySink& sink) const
+{
+    sink.writeValue(props::id, id);
+}
+
+void Entity::deserialize(const IEntitySource& source)
+{
+    Q_UNUSED(source)
+    emit changed();
+}
+
 QVariantMap Entity::toVariantMap() const
 {
-    QVariantMap map;
-    map.insert(props::id, id);
-    return map;
+    VariantMapSink sink;
+    this->serialize(sink);
+    return sink.map();
 }
 
 void Entity::fromVariantMap(const QVariantMap& map)
 {
-    Q_UNUSED(map)
-    emit changed();
+    this->deserialize(VariantMapSource(map));
+}
+
+bool Entity::isPersisted() const
+{
+    return m_persisted;
+}
+
+bool Entity::isDirty() const
+{
+    return !m_persisted || !m_dirtyFields.isEmpty();
+}
+
+QStringList Entity::dirtyFields() const
+{
+    return m_dirtyFields.values();
+}
+
+void Entity::markDirty(const QString& field)
+{
+    m_dirtyFields.insert(field);
+}
+
+void Entity::markClean()
+{
+    m_dirtyFields.clear();
+    m_persisted = true;
+}
+
+bool Entity::differs(const QVariantMap& map) const
+{
+    const QVariantMap values = this->toVariantMap();
+    for (auto it = map.constBegin(); it != map.constEnd(); ++it)
+    {
+        auto value = values.constFind(it.key());
+        if (value != values.constEnd() && value.value() != it.value())
+            return true;
+    }
+    return false;
+}
+
+std::function<void()> Entity::notifier(const QString& field)
+{
+    return [this, field]() {
+        this->markDirty(field);
+        emit changed();
+    };
 }
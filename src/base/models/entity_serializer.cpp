@@ -0,0 +1,304 @@
+#include "entity_serializer.h"
+
+#include <QCborValue>
+#include <QJsonValue>
+
+using namespace md::domain;
+
+bool IEntitySink::accepts(const QString& field) const
+{
+    Q_UNUSED(field)
+    return true;
+}
+
+void IEntitySink::writeString(const QString& field, const QString& value)
+{
+    this->writeValue(field, value);
+}
+
+void IEntitySink::writeBool(const QString& field, bool value)
+{
+    this->writeValue(field, value);
+}
+
+void IEntitySink::writeDateTime(const QString& field, const QDateTime& value)
+{
+    this->writeValue(field, value);
+}
+
+void IEntitySink::writeMap(const QString& field, const QVariantMap& value)
+{
+    this->writeValue(field, value);
+}
+
+void IEntitySink::writeObject(const QString& field, const FieldsWriter& fields)
+{
+    VariantMapSink nested;
+    fields(nested);
+    this->writeMap(field, nested.map());
+}
+
+bool IEntitySource::readString(const QString& field, QString& value) const
+{
+    QVariant variant;
+    if (!this->readValue(field, variant))
+        return false;
+
+    value = variant.toString();
+    return true;
+}
+
+bool IEntitySource::readBool(const QString& field, bool& value) const
+{
+    QVariant variant;
+    if (!this->readValue(field, variant))
+        return false;
+
+    value = variant.toBool();
+    return true;
+}
+
+bool IEntitySource::readDateTime(const QString& field, QDateTime& value) const
+{
+    QVariant variant;
+    if (!this->readValue(field, variant))
+        return false;
+
+    value = variant.toDateTime();
+    return true;
+}
+
+bool IEntitySource::readMap(const QString& field, QVariantMap& value) const
+{
+    QVariant variant;
+    if (!this->readValue(field, variant))
+        return false;
+
+    value = variant.toMap();
+    return true;
+}
+
+void VariantMapSink::writeValue(const QString& field, const QVariant& value)
+{
+    m_map.insert(field, value);
+}
+
+const QVariantMap& VariantMapSink::map() const
+{
+    return m_map;
+}
+
+VariantMapSource::VariantMapSource(const QVariantMap& map) : m_map(map)
+{
+}
+
+bool VariantMapSource::readValue(const QString& field, QVariant& value) const
+{
+    auto it = m_map.constFind(field);
+    if (it == m_map.constEnd())
+        return false;
+
+    value = it.value();
+    return true;
+}
+
+void JsonEntitySink::writeValue(const QString& field, const QVariant& value)
+{
+    m_object.insert(field, QJsonValue::fromVariant(value));
+}
+
+void JsonEntitySink::writeString(const QString& field, const QString& value)
+{
+    m_object.insert(field, value);
+}
+
+void JsonEntitySink::writeBool(const QString& field, bool value)
+{
+    m_object.insert(field, value);
+}
+
+void JsonEntitySink::writeDateTime(const QString& field, const QDateTime& value)
+{
+    m_object.insert(field, value.toString(Qt::ISODateWithMs));
+}
+
+void JsonEntitySink::writeMap(const QString& field, const QVariantMap& value)
+{
+    m_object.insert(field, QJsonObject::fromVariantMap(value));
+}
+
+void JsonEntitySink::writeObject(const QString& field, const FieldsWriter& fields)
+{
+    JsonEntitySink nested;
+    fields(nested);
+    m_object.insert(field, nested.object());
+}
+
+const QJsonObject& JsonEntitySink::object() const
+{
+    return m_object;
+}
+
+JsonEntitySource::JsonEntitySource(const QJsonObject& object) : m_object(object)
+{
+}
+
+bool JsonEntitySource::readValue(const QString& field, QVariant& value) const
+{
+    auto it = m_object.constFind(field);
+    if (it == m_object.constEnd())
+        return false;
+
+    value = it.value().toVariant();
+    return true;
+}
+
+bool JsonEntitySource::readString(const QString& field, QString& value) const
+{
+    auto it = m_object.constFind(field);
+    if (it == m_object.constEnd())
+        return false;
+
+    value = it.value().toString();
+    return true;
+}
+
+bool JsonEntitySource::readBool(const QString& field, bool& value) const
+{
+    auto it = m_object.constFind(field);
+    if (it == m_object.constEnd())
+        return false;
+
+    value = it.value().toBool();
+    return true;
+}
+
+bool JsonEntitySource::readDateTime(const QString& field, QDateTime& value) const
+{
+    auto it = m_object.constFind(field);
+    if (it == m_object.constEnd())
+        return false;
+
+    value = QDateTime::fromString(it.value().toString(), Qt::ISODateWithMs);
+    return true;
+}
+
+bool JsonEntitySource::readMap(const QString& field, QVariantMap& value) const
+{
+    auto it = m_object.constFind(field);
+    if (it == m_object.constEnd())
+        return false;
+
+    value = it.value().toObject().toVariantMap();
+    return true;
+}
+
+CborEntitySink::CborEntitySink() : m_writer(&m_data)
+{
+    // Field count is unknown until the entity is done
+    m_writer.startMap();
+}
+
+void CborEntitySink::writeValue(const QString& field, const QVariant& value)
+{
+    m_writer.append(field);
+    QCborValue::fromVariant(value).toCbor(m_writer);
+}
+
+void CborEntitySink::writeString(const QString& field, const QString& value)
+{
+    m_writer.append(field);
+    m_writer.append(value);
+}
+
+void CborEntitySink::writeBool(const QString& field, bool value)
+{
+    m_writer.append(field);
+    m_writer.append(value);
+}
+
+void CborEntitySink::writeDateTime(const QString& field, const QDateTime& value)
+{
+    m_writer.append(field);
+    QCborValue(value).toCbor(m_writer);
+}
+
+void CborEntitySink::writeMap(const QString& field, const QVariantMap& value)
+{
+    m_writer.append(field);
+    QCborMap::fromVariantMap(value).toCborValue().toCbor(m_writer);
+}
+
+void CborEntitySink::writeObject(const QString& field, const FieldsWriter& fields)
+{
+    // Nested fields are key-value pairs of the inner map in the same stream
+    m_writer.append(field);
+    m_writer.startMap();
+    fields(*this);
+    m_writer.endMap();
+}
+
+QByteArray CborEntitySink::finish()
+{
+    if (!m_finished)
+    {
+        m_writer.endMap();
+        m_finished = true;
+    }
+    return m_data;
+}
+
+CborEntitySource::CborEntitySource(const QByteArray& data) :
+    m_map(QCborValue::fromCbor(data).toMap())
+{
+}
+
+bool CborEntitySource::readValue(const QString& field, QVariant& value) const
+{
+    const QCborValue cbor = m_map.value(field);
+    if (cbor.isUndefined())
+        return false;
+
+    value = cbor.toVariant();
+    return true;
+}
+
+bool CborEntitySource::readString(const QString& field, QString& value) const
+{
+    const QCborValue cbor = m_map.value(field);
+    if (cbor.isUndefined())
+        return false;
+
+    value = cbor.toString();
+    return true;
+}
+
+bool CborEntitySource::readBool(const QString& field, bool& value) const
+{
+    const QCborValue cbor = m_map.value(field);
+    if (cbor.isUndefined())
+        return false;
+
+    value = cbor.toBool();
+    return true;
+}
+
+bool CborEntitySource::readDateTime(const QString& field, QDateTime& value) const
+{
+    const QCborValue cbor = m_map.value(field);
+    if (cbor.isUndefined())
+        return false;
+
+    value = cbor.toDateTime();
+    return true;
+}
+
+bool CborEntitySource::readMap(const QString& field, QVariantMap& value) const
+{
+    const QCborValue cbor = m_map.value(field);
+    if (cbor.isUndefined())
+        return false;
+
+    value = cbor.toMap().toVariantMap();
+    return true;
+}
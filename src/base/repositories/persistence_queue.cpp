@@ -0,0 +1,213 @@
+#include "persistence_queue.h"
+
+#include <QDebug>
+#include <QThread>
+
+using namespace md::domain;
+
+PersistenceQueue::PersistenceQueue(int windowMs, const TransactionFactory& transaction) :
+    m_windowMs(windowMs),
+    m_transaction(transaction),
+    m_thread(QThread::create([this]() {
+        this->run();
+    }))
+{
+    m_clock.start();
+    m_thread->setObjectName("PersistenceQueue");
+    m_thread->start();
+}
+
+PersistenceQueue::~PersistenceQueue()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stopping = true;
+        m_wakeUp.wakeOne();
+    }
+    m_thread->wait();
+    delete m_thread;
+}
+
+void PersistenceQueue::enqueue(const QString& key, const Write& write, const Finished& finished)
+{
+    QMutexLocker locker(&m_mutex);
+    m_stats.enqueued++;
+
+    auto sequence = m_sequences.find(key);
+    if (sequence != m_sequences.end())
+    {
+        // Replacing write takes the slot & the due time of the replaced one, so writes of other
+        // keys depending on it, like items of a mission, still go after it
+        Pending& replaced = m_queue[sequence.value()];
+        replaced.write = write;
+        replaced.finished = finished;
+
+        m_stats.coalesced++;
+        return;
+    }
+
+    m_lastSequence++;
+    m_queue.insert(m_lastSequence, { key, write, finished, m_clock.elapsed() + m_windowMs });
+    if (!key.isEmpty())
+        m_sequences.insert(key, m_lastSequence);
+
+    // Worker sleeps until the first write is due, later ones are never due earlier
+    if (m_queue.count() == 1)
+        m_wakeUp.wakeOne();
+}
+
+QFuture<void> PersistenceQueue::flush()
+{
+    QFutureInterface<void> flush;
+    flush.reportStarted();
+
+    QMutexLocker locker(&m_mutex);
+    if (m_queue.isEmpty() && !m_writing)
+    {
+        flush.reportFinished();
+        return flush.future();
+    }
+
+    m_flushes.append({ m_lastSequence, flush });
+    m_flushSequence = m_lastSequence;
+    m_wakeUp.wakeOne();
+    return flush.future();
+}
+
+bool PersistenceQueue::isPending(const QString& key) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_sequences.contains(key) || m_running.contains(key);
+}
+
+int PersistenceQueue::pendingCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_queue.count();
+}
+
+int PersistenceQueue::windowMs() const
+{
+    return m_windowMs;
+}
+
+PersistenceStats PersistenceQueue::stats() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_stats;
+}
+
+void PersistenceQueue::run()
+{
+    QMutexLocker locker(&m_mutex);
+    while (true)
+    {
+        this->finishFlushes();
+
+        if (m_queue.isEmpty())
+        {
+            if (m_stopping)
+                break;
+
+            m_wakeUp.wait(&m_mutex);
+            continue;
+        }
+
+        if (!this->isDue(m_queue.firstKey(), m_queue.first()))
+        {
+            const qint64 waitMs = m_queue.first().dueMs - m_clock.elapsed();
+            m_wakeUp.wait(&m_mutex, static_cast<unsigned long>(qMax<qint64>(waitMs, 1)));
+            continue;
+        }
+
+        QList<Pending> batch;
+        for (auto it = m_queue.begin(); it != m_queue.end() && this->isDue(it.key(), it.value());)
+        {
+            batch.append(it.value());
+            m_sequences.remove(it->key);
+            m_running.insert(it->key);
+            it = m_queue.erase(it);
+        }
+        m_writing = true;
+        locker.unlock();
+
+        const QVector<bool> results = this->write(batch);
+        int failed = 0;
+        for (int i = 0; i < batch.count(); ++i)
+        {
+            if (!results.at(i))
+                failed++;
+            if (batch.at(i).finished)
+                batch.at(i).finished(results.at(i));
+        }
+
+        locker.relock();
+        m_writing = false;
+        m_running.clear();
+        m_stats.written += batch.count() - failed;
+        m_stats.failed += failed;
+        m_stats.batches++;
+    }
+}
+
+QVector<bool> PersistenceQueue::write(const QList<Pending>& batch) const
+{
+    QVector<bool> results;
+    if (!m_transaction)
+    {
+        for (const Pending& pending : batch)
+        {
+            results.append(pending.write());
+        }
+        return results;
+    }
+
+    const bool committed = this->writeInTransaction(batch);
+    if (committed || batch.count() == 1)
+        return QVector<bool>(batch.count(), committed);
+
+    // One failed write doesn't take the others down
+    qWarning() << "Persistence batch failed, retrying" << batch.count() << "writes one by one";
+    for (const Pending& pending : batch)
+    {
+        results.append(this->writeInTransaction({ pending }));
+    }
+    return results;
+}
+
+bool PersistenceQueue::writeInTransaction(const QList<Pending>& writes) const
+{
+    TransactionPtr transaction = m_transaction();
+    for (const Pending& pending : writes)
+    {
+        if (!pending.write())
+        {
+            transaction->rollback();
+            return false;
+        }
+    }
+    return transaction->commit();
+}
+
+bool PersistenceQueue::isDue(quint64 sequence, const Pending& pending) const
+{
+    return m_stopping || sequence <= m_flushSequence || pending.dueMs <= m_clock.elapsed();
+}
+
+void PersistenceQueue::finishFlushes()
+{
+    // Writes go in the order of sequences, so everything before the first pending one is done
+    const quint64 done = m_queue.isEmpty() ? m_lastSequence : m_queue.firstKey() - 1;
+    for (auto it = m_flushes.begin(); it != m_flushes.end();)
+    {
+        if (it->first <= done)
+        {
+            it->second.reportFinished();
+            it = m_flushes.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
@@ -1,33 +1,76 @@
 #include "entity_sql_table.h"
 
+#include <QCborMap>
+#include <QCborValue>
 #include <QDebug>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QSqlError>
+
+#include "sql_change_feed.h"
+#include "sql_row_sink.h"
+#include "sql_statistics.h"
+#include "sql_transaction.h"
 
 namespace
 {
-QVariantMap fromJson(const QVariant& content)
+bool isJsonText(const QByteArray& content)
 {
-    QJsonDocument doc = QJsonDocument::fromJson(content.toByteArray());
-    return doc.object().toVariantMap();
+    // JSON object starts with '{', CBOR map never does
+    const QByteArray trimmed = content.trimmed();
+    return trimmed.isEmpty() || trimmed.startsWith('{');
 }
+} // namespace
+
+using namespace md::data_source;
 
-QByteArray toJson(const QVariant& content)
+QVariantMap sql::decodeJson(const QVariant& content)
 {
-    QJsonObject json = QJsonObject::fromVariantMap(content.toMap());
-    QJsonDocument doc(json);
-    return doc.toJson();
+    const QByteArray bytes = content.toByteArray();
+    if (::isJsonText(bytes))
+        return QJsonDocument::fromJson(bytes).object().toVariantMap();
+
+    return QCborValue::fromCbor(bytes).toMap().toVariantMap();
 }
 
-} // namespace
+QByteArray sql::encodeJson(const QVariant& content, JsonEncoding encoding)
+{
+    if (encoding == JsonEncoding::Cbor)
+        return QCborMap::fromVariantMap(content.toMap()).toCborValue().toCbor();
 
-using namespace md::data_source;
+    QJsonObject json = QJsonObject::fromVariantMap(content.toMap());
+    QJsonDocument doc(json);
+    return doc.toJson(QJsonDocument::Compact);
+}
 
 EntitySqlTable::EntitySqlTable(QSqlDatabase* database, const QString& tableName,
-                               const QStringList& jsonProperties) :
+                               const QStringList& jsonProperties, JsonEncoding jsonEncoding) :
     SqlTable(database, tableName),
-    m_jsonProperties(jsonProperties)
+    m_jsonProperties(jsonProperties),
+    m_jsonEncoding(jsonEncoding),
+    m_cache(0)
 {
+    SqlChangeFeed* feed = SqlChangeFeed::feed(*database);
+    if (!feed)
+        return;
+
+    m_changeFeedConnection = QObject::connect(
+        feed, &SqlChangeFeed::changed, [this](const QList<SqlChange>& changes) {
+            for (const SqlChange& change : changes)
+            {
+                if (change.table != this->tableName())
+                    continue;
+
+                // Row of an unresolved id may be any row
+                this->rowsChanged(change.id.isNull() ? ConditionMap()
+                                                     : ConditionMap({ { sql::id, change.id } }));
+            }
+        });
+}
+
+EntitySqlTable::~EntitySqlTable()
+{
+    QObject::disconnect(m_changeFeedConnection);
 }
 
 QVariantList EntitySqlTable::selectIds(const ConditionMap& conditions, const QString& column)
@@ -37,21 +80,142 @@ QVariantList EntitySqlTable::selectIds(const ConditionMap& conditions, const QSt
 
 QVariantMap EntitySqlTable::selectById(const QVariant& id, const QString& column)
 {
+    QVariantMap map;
+    if (this->cachedRow(id.toString(), &map))
+        return map;
+
+    const quint64 generation = this->cacheGeneration();
     auto select = this->select({ { data_source::sql::id, id } }, this->columnNames());
 
     if (select.isEmpty())
         return QVariantMap();
 
-    QVariantMap map = select.first();
-    for (const QString& property : m_jsonProperties)
+    map = select.first();
+    this->decodeJsonProperties(map);
+    this->cacheRow(map, generation);
+    return map;
+}
+
+QList<QVariantMap> EntitySqlTable::selectByIds(const QVariantList& ids)
+{
+    const SqlTableInfoPtr info = this->tableInfo();
+    const QStringList columns = info->columnNames();
+    const int idIndex = columns.indexOf(sql::id);
+
+    // Cached rows first, the rest with one statement per chunk of ids instead of one per id
+    QHash<QString, QVariantMap> rows;
+    QVariantList missing;
+    for (const QVariant& id : ids)
     {
-        if (map.contains(property))
+        QVariantMap map;
+        if (this->cachedRow(id.toString(), &map))
+            rows.insert(id.toString(), map);
+        else
+            missing.append(id);
+    }
+
+    const quint64 generation = this->cacheGeneration();
+    for (int offset = 0; offset < missing.count(); offset += sql::maxBoundValues)
+    {
+        const QVariantList chunk = missing.mid(offset, sql::maxBoundValues);
+
+        QStringList placeholders;
+        for (int i = 0; i < chunk.count(); ++i)
+        {
+            placeholders.append("?");
+        }
+
+        QSqlQuery query = this->cachedQuery(this->prepareSelect({}, columns) + " WHERE " +
+                                            sql::id + " IN (" + placeholders.join(sql::comma) +
+                                            ")");
+        for (const QVariant& id : chunk)
         {
-            map[property] = ::fromJson(map.value(property));
+            query.addBindValue(info->isUuid(sql::id) ? sql::toUuidBlob(id) : id);
         }
+
+        SqlStatementTimer timer(query.lastQuery());
+        if (!query.exec())
+        {
+            qWarning() << query.lastQuery() << query.lastError();
+            return {};
+        }
+
+        while (query.next())
+        {
+            timer.addRows(1);
+            QVariantMap map;
+            for (int i = 0; i < columns.count(); ++i)
+            {
+                const QString& column = columns.at(i);
+                map.insert(column, info->isUuid(column) ? sql::fromUuidBlob(query.value(i))
+                                                        : query.value(i));
+            }
+            this->decodeJsonProperties(map);
+            this->cacheRow(map, generation);
+            rows.insert(map.value(columns.at(idIndex)).toString(), map);
+        }
+        query.finish();
     }
 
-    return map;
+    QList<QVariantMap> result;
+    result.reserve(rows.count());
+    for (const QVariant& id : ids)
+    {
+        auto it = rows.find(id.toString());
+        if (it == rows.end())
+            continue;
+
+        result.append(it.value());
+        rows.erase(it);
+    }
+    return result;
+}
+
+QList<QVariantMap> EntitySqlTable::selectByConditions(const ConditionMap& conditions)
+{
+    // Only ids from the database, rows come from the cache
+    if (this->cacheCapacity() > 0)
+    {
+        QVariantList ids;
+        for (const QVariantMap& row : this->select(conditions, { sql::id }, { sql::rowid }))
+        {
+            ids.append(row.value(sql::id));
+        }
+        return this->selectByIds(ids);
+    }
+
+    const SqlTableInfoPtr info = this->tableInfo();
+    const QStringList columns = info->columnNames();
+
+    // JSON properties are decoded as the rows are read
+    QList<QVariantMap> result;
+    this->selectEach(
+        conditions, columns,
+        [this, &result, &columns, &info](const QSqlQuery& row) {
+            QVariantMap map;
+            for (int i = 0; i < columns.count(); ++i)
+            {
+                const QString& column = columns.at(i);
+                map.insert(column, info->isUuid(column) ? sql::fromUuidBlob(row.value(i))
+                                                        : row.value(i));
+            }
+            this->decodeJsonProperties(map);
+            result.append(map);
+            return true;
+        },
+        { sql::rowid });
+    return result;
+}
+
+md::domain::Page EntitySqlTable::selectPage(const ConditionMap& conditions,
+                                            const domain::PageRequest& request)
+{
+    domain::Page page = this->selectPage(conditions, this->columnNames(), sql::id, request);
+    for (QVariantMap& map : page.rows)
+    {
+        this->decodeJsonProperties(map);
+    }
+    return page;
 }
 
 bool EntitySqlTable::removeById(const QVariant& id)
@@ -59,41 +223,318 @@ bool EntitySqlTable::removeById(const QVariant& id)
     return this->removeByCondition({ sql::id, id });
 }
 
+bool EntitySqlTable::removeByIds(const QVariantList& ids)
+{
+    if (ids.isEmpty())
+        return true;
+
+    const bool uuid = this->tableInfo()->isUuid(sql::id);
+
+    SqlTransaction transaction(this->database());
+    for (int offset = 0; offset < ids.count(); offset += sql::maxBoundValues)
+    {
+        const QVariantList chunk = ids.mid(offset, sql::maxBoundValues);
+
+        // Full chunks share the statement
+        QStringList placeholders;
+        for (int i = 0; i < chunk.count(); ++i)
+        {
+            placeholders.append("?");
+        }
+
+        QSqlQuery query = this->cachedQuery("DELETE FROM " + this->tableName() + " WHERE " +
+                                            sql::id + " IN (" + placeholders.join(sql::comma) +
+                                            ")");
+        for (const QVariant& id : chunk)
+        {
+            query.addBindValue(uuid ? sql::toUuidBlob(id) : id);
+        }
+
+        SqlStatementTimer timer(query.lastQuery());
+        bool result = query.exec();
+        timer.addRowsAffected(query.numRowsAffected());
+        for (const QVariant& id : chunk)
+        {
+            this->rowsChanged({ { sql::id, id } });
+        }
+
+        if (!result)
+        {
+            qWarning() << query.lastQuery() << query.lastError();
+            return false;
+        }
+    }
+    return transaction.commit();
+}
+
 bool EntitySqlTable::updateById(const QVariantMap& valueMap, const QVariant& id)
 {
     return this->updateByCondition(valueMap, { sql::id, id });
 }
 
-void EntitySqlTable::insertEntity(domain::Entity* entity)
+bool EntitySqlTable::insertEntity(domain::Entity* entity)
+{
+    if (!this->insert(this->entityToMap(entity)))
+        return false;
+
+    entity->markClean();
+    return true;
+}
+
+bool EntitySqlTable::insertEntities(const QList<domain::Entity*>& entities)
+{
+    QList<QVariantMap> maps;
+    maps.reserve(entities.count());
+    for (domain::Entity* entity : entities)
+    {
+        maps.append(this->entityToMap(entity));
+    }
+    if (!this->insertMany(maps))
+        return false;
+
+    for (domain::Entity* entity : entities)
+    {
+        entity->markClean();
+    }
+    return true;
+}
+
+bool EntitySqlTable::upsertEntity(domain::Entity* entity)
+{
+    if (!this->upsert(this->entityToMap(entity), sql::id, this->dirtyColumns(entity)))
+        return false;
+
+    entity->markClean();
+    return true;
+}
+
+bool EntitySqlTable::upsertEntities(const QList<domain::Entity*>& entities)
 {
-    this->insert(this->entityToMap(entity));
+    // Entities with the same dirty columns share one statement
+    QMap<QStringList, QList<domain::Entity*>> groups;
+    for (domain::Entity* entity : entities)
+    {
+        QStringList columns = this->dirtyColumns(entity);
+        columns.sort();
+        groups[columns].append(entity);
+    }
+
+    SqlTransaction transaction(this->database());
+    for (auto it = groups.constBegin(); it != groups.constEnd(); ++it)
+    {
+        QList<QVariantMap> maps;
+        maps.reserve(it.value().count());
+        for (domain::Entity* entity : it.value())
+        {
+            maps.append(this->entityToMap(entity));
+        }
+        if (!this->upsertMany(maps, sql::id, it.key()))
+            return false;
+    }
+    if (!transaction.commit())
+        return false;
+
+    for (domain::Entity* entity : entities)
+    {
+        entity->markClean();
+    }
+    return true;
 }
 
 void EntitySqlTable::readEntity(domain::Entity* entity)
 {
     entity->fromVariantMap(this->selectById(entity->id));
+    entity->markClean();
 }
 
-void EntitySqlTable::updateEntity(domain::Entity* entity)
+bool EntitySqlTable::updateEntity(domain::Entity* entity)
 {
-    this->updateById(this->entityToMap(entity), entity->id);
+    // Nothing to write when only runtime state like current or reached has changed
+    const QStringList columns = this->dirtyColumns(entity);
+    if (!columns.isEmpty() && !this->updateById(this->entityToMap(entity, columns), entity->id))
+        return false;
+
+    entity->markClean();
+    return true;
 }
 
-void EntitySqlTable::removeEntity(domain::Entity* entity)
+bool EntitySqlTable::removeEntity(domain::Entity* entity)
 {
-    this->removeById(entity->id);
+    return this->removeById(entity->id);
 }
 
 QVariantMap EntitySqlTable::entityToMap(domain::Entity* entity)
 {
-    QVariantMap map = entity->toVariantMap();
+    return this->entityToMap(entity, this->columnNames());
+}
+
+QVariantMap EntitySqlTable::entityToMap(domain::Entity* entity, const QStringList& columns)
+{
+    // Entity writes the columns directly, without the map of all its fields
+    SqlRowSink sink(columns, m_jsonProperties, m_jsonEncoding);
+    entity->serialize(sink);
+    return sink.row();
+}
+
+QStringList EntitySqlTable::dirtyColumns(domain::Entity* entity) const
+{
+    const QStringList dirtyFields = entity->dirtyFields();
+    QStringList columns;
+    for (const QString& column : this->columnNames())
+    {
+        if (column == sql::id)
+            continue;
+
+        if (!entity->isPersisted() || dirtyFields.contains(column))
+            columns.append(column);
+    }
+    return columns;
+}
+
+int EntitySqlTable::migrateJsonEncoding()
+{
+    if (m_jsonProperties.isEmpty())
+        return 0;
+
+    const bool cbor = m_jsonEncoding == JsonEncoding::Cbor;
+    QStringList columns = m_jsonProperties;
+    columns.prepend(sql::id);
+
+    // Collect first, statement can't be updated while iterating it
+    QList<QPair<QVariant, QVariantMap>> converted;
+    this->selectEach({}, columns, [&](const QSqlQuery& row) {
+        QVariantMap values;
+        for (int i = 1; i < columns.count(); ++i)
+        {
+            const QByteArray content = row.value(i).toByteArray();
+            if (content.isEmpty() || ::isJsonText(content) != cbor)
+                continue;
+
+            values.insert(columns.at(i), sql::encodeJson(sql::decodeJson(content), m_jsonEncoding));
+        }
+        if (!values.isEmpty())
+            converted.append({ this->fromStored(sql::id, row.value(0)), values });
+        return true;
+    });
+
+    SqlTransaction transaction(this->database());
+    for (const auto& row : qAsConst(converted))
+    {
+        if (!this->updateById(row.second, row.first))
+            return -1;
+    }
+    return transaction.commit() ? converted.count() : -1;
+}
+
+JsonEncoding EntitySqlTable::jsonEncoding() const
+{
+    return m_jsonEncoding;
+}
+
+void EntitySqlTable::setCacheCapacity(int capacity)
+{
+    QMutexLocker locker(&m_cacheMutex);
+    m_cache.setMaxCost(capacity);
+}
+
+int EntitySqlTable::cacheCapacity() const
+{
+    QMutexLocker locker(&m_cacheMutex);
+    return m_cache.maxCost();
+}
+
+EntityCacheStats EntitySqlTable::cacheStats() const
+{
+    QMutexLocker locker(&m_cacheMutex);
+    return m_cacheStats;
+}
+
+void EntitySqlTable::clearCache()
+{
+    QMutexLocker locker(&m_cacheMutex);
+    m_cacheGeneration++;
+    m_cache.clear();
+}
+
+void EntitySqlTable::invalidateCache(const ConditionMap& conditions)
+{
+    this->rowsChanged(conditions);
+}
+
+void EntitySqlTable::rowsChanged(const ConditionMap& conditions)
+{
+    QMutexLocker locker(&m_cacheMutex);
+    m_cacheGeneration++;
+    if (m_cache.isEmpty())
+        return;
 
+    if (conditions.isEmpty())
+    {
+        m_cache.clear();
+        return;
+    }
+
+    if (conditions.contains(sql::id))
+    {
+        m_cache.remove(conditions.value(sql::id).toString());
+        return;
+    }
+
+    // No id, drop every cached row matching the conditions
+    for (const QString& id : m_cache.keys())
+    {
+        const QVariantMap* row = m_cache.object(id);
+        bool matches = true;
+        for (auto it = conditions.constBegin(); it != conditions.constEnd() && matches; ++it)
+        {
+            matches = it.value().isNull() ? row->value(it.key()).isNull()
+                                          : row->value(it.key()) == it.value();
+        }
+        if (matches)
+            m_cache.remove(id);
+    }
+}
+
+bool EntitySqlTable::cachedRow(const QString& id, QVariantMap* row) const
+{
+    QMutexLocker locker(&m_cacheMutex);
+    if (m_cache.maxCost() == 0)
+        return false;
+
+    const QVariantMap* cached = m_cache.object(id);
+    if (!cached)
+    {
+        m_cacheStats.misses++;
+        return false;
+    }
+
+    m_cacheStats.hits++;
+    *row = *cached;
+    return true;
+}
+
+void EntitySqlTable::cacheRow(const QVariantMap& row, quint64 generation)
+{
+    QMutexLocker locker(&m_cacheMutex);
+    if (m_cache.maxCost() == 0 || generation != m_cacheGeneration)
+        return;
+
+    m_cache.insert(row.value(sql::id).toString(), new QVariantMap(row));
+}
+
+quint64 EntitySqlTable::cacheGeneration() const
+{
+    QMutexLocker locker(&m_cacheMutex);
+    return m_cacheGeneration;
+}
+
+void EntitySqlTable::decodeJsonProperties(QVariantMap& map) const
+{
     for (const QString& property : m_jsonProperties)
     {
         if (map.contains(property))
         {
-            map[property] = ::toJson(map.value(property));
+            map[property] = sql::decodeJson(map.value(property));
         }
     }
-    return map;
 }
@@ -0,0 +1,314 @@
+#include "sql_change_feed.h"
+
+#include <functional>
+
+#include <QDebug>
+#include <QReadWriteLock>
+#include <QSet>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QSqlRecord>
+
+#include <sqlite3.h>
+
+#include "entity_sql_table.h"
+#include "sql_connection_pool.h"
+#include "sql_statistics.h"
+#include "sqlite_handle.h"
+
+namespace md::data_source
+{
+// Changes of one connection, hooks run in the thread using it
+struct SqlConnectionHooks
+{
+    sqlite3* handle = nullptr;
+    QList<SqlChange> pending;
+    std::function<void(QList<SqlChange>)> publish;
+};
+} // namespace md::data_source
+
+namespace
+{
+using md::data_source::SqlChange;
+using md::data_source::SqlConnectionHooks;
+using md::data_source::SqlOperation;
+
+// Feeds by origin connection name, like connection pools
+QHash<QString, md::data_source::SqlChangeFeed*>& feeds()
+{
+    static QHash<QString, md::data_source::SqlChangeFeed*> feeds;
+    return feeds;
+}
+
+QReadWriteLock& feedsLock()
+{
+    static QReadWriteLock lock;
+    return lock;
+}
+
+constexpr char deletedFunction[] = "kjarni_deleted";
+
+QVariant fromSqlite(sqlite3_value* value)
+{
+    switch (sqlite3_value_type(value))
+    {
+    case SQLITE_INTEGER:
+        return QVariant(qint64(sqlite3_value_int64(value)));
+    case SQLITE_FLOAT:
+        return QVariant(sqlite3_value_double(value));
+    case SQLITE_TEXT:
+        return QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_value_text(value)),
+                                 sqlite3_value_bytes(value));
+    case SQLITE_BLOB:
+        return QByteArray(static_cast<const char*>(sqlite3_value_blob(value)),
+                          sqlite3_value_bytes(value));
+    default:
+        return QVariant();
+    }
+}
+
+// Called by the delete triggers with the table, rowid & id of the deleted row, the row is gone
+// when the change is resolved after the commit
+void onDeleted(sqlite3_context* context, int count, sqlite3_value** values)
+{
+    auto hooks = static_cast<SqlConnectionHooks*>(sqlite3_user_data(context));
+    if (!hooks || count != 3)
+        return;
+
+    const QString table = ::fromSqlite(values[0]).toString();
+    const qint64 rowid = sqlite3_value_int64(values[1]);
+
+    // Update hook has already got the delete, triggers run after it
+    for (auto it = hooks->pending.rbegin(); it != hooks->pending.rend(); ++it)
+    {
+        if (it->operation == SqlOperation::Delete && it->rowid == rowid && it->table == table)
+        {
+            it->id = ::fromSqlite(values[2]);
+            break;
+        }
+    }
+}
+
+void onUpdate(void* data, int operation, const char* database, const char* table,
+              sqlite3_int64 rowid)
+{
+    Q_UNUSED(database)
+
+    SqlChange change;
+    change.table = QString::fromUtf8(table);
+    change.operation = operation == SQLITE_INSERT   ? SqlOperation::Insert
+                       : operation == SQLITE_DELETE ? SqlOperation::Delete
+                                                    : SqlOperation::Update;
+    change.rowid = rowid;
+    static_cast<SqlConnectionHooks*>(data)->pending.append(change);
+}
+
+int onCommit(void* data)
+{
+    auto hooks = static_cast<SqlConnectionHooks*>(data);
+    if (!hooks->pending.isEmpty())
+    {
+        hooks->publish(hooks->pending);
+        hooks->pending.clear();
+    }
+    return 0; // Non zero turns the commit into a rollback
+}
+
+// Rollback to a savepoint doesn't call it, such changes are published with the commit
+void onRollback(void* data)
+{
+    static_cast<SqlConnectionHooks*>(data)->pending.clear();
+}
+
+void setDeletedFunction(sqlite3* handle, SqlConnectionHooks* hooks)
+{
+    sqlite3_create_function(handle, ::deletedFunction, 3, SQLITE_UTF8, hooks, ::onDeleted,
+                            nullptr, nullptr);
+}
+
+// Function stays for the triggers, without the hooks it does nothing
+void removeHooks(sqlite3* handle)
+{
+    sqlite3_update_hook(handle, nullptr, nullptr);
+    sqlite3_commit_hook(handle, nullptr, nullptr);
+    sqlite3_rollback_hook(handle, nullptr, nullptr);
+    ::setDeletedFunction(handle, nullptr);
+}
+} // namespace
+
+using namespace md::data_source;
+
+SqlChangeFeed::SqlChangeFeed(const QSqlDatabase& origin, QObject* parent) :
+    QObject(parent),
+    m_origin(origin)
+{
+    qRegisterMetaType<SqlChange>();
+    qRegisterMetaType<QList<SqlChange>>();
+
+    QWriteLocker locker(&::feedsLock());
+    ::feeds().insert(m_origin.connectionName(), this);
+}
+
+SqlChangeFeed::~SqlChangeFeed()
+{
+    {
+        QWriteLocker locker(&::feedsLock());
+        ::feeds().remove(m_origin.connectionName());
+    }
+
+    // Connections released by the pool have taken their hooks with them
+    QMutexLocker locker(&m_mutex);
+    for (auto it = m_hooks.constBegin(); it != m_hooks.constEnd(); ++it)
+    {
+        if (QSqlDatabase::contains(it.key()))
+            ::removeHooks(it.value()->handle);
+    }
+}
+
+bool SqlChangeFeed::attach(const QSqlDatabase& connection)
+{
+    sqlite3* handle = sql::sqliteHandle(connection);
+    if (!handle)
+    {
+        qWarning() << "Change feed needs an opened SQLite connection"
+                   << connection.connectionName();
+        return false;
+    }
+
+    auto hooks = QSharedPointer<SqlConnectionHooks>::create();
+    hooks->handle = handle;
+    hooks->publish = [this](QList<SqlChange> changes) {
+        this->publish(changes);
+    };
+
+    QMutexLocker locker(&m_mutex);
+    sqlite3_update_hook(handle, ::onUpdate, hooks.data());
+    sqlite3_commit_hook(handle, ::onCommit, hooks.data());
+    sqlite3_rollback_hook(handle, ::onRollback, hooks.data());
+    ::setDeletedFunction(handle, hooks.data());
+    m_hooks.insert(connection.connectionName(), hooks);
+    this->createDeleteTriggers(connection);
+    return true;
+}
+
+void SqlChangeFeed::detach(const QSqlDatabase& connection)
+{
+    QMutexLocker locker(&m_mutex);
+    QSharedPointer<SqlConnectionHooks> hooks = m_hooks.take(connection.connectionName());
+    if (hooks)
+        ::removeHooks(hooks->handle);
+}
+
+SqlChangeFeed* SqlChangeFeed::feed(const QSqlDatabase& origin)
+{
+    QReadLocker locker(&::feedsLock());
+    return ::feeds().value(origin.connectionName(), nullptr);
+}
+
+void SqlChangeFeed::publish(QList<SqlChange> changes)
+{
+    // Commit is still in progress and no statements may run in the hook, so emit later
+    QMetaObject::invokeMethod(
+        this,
+        [this, changes]() mutable {
+            this->resolveIds(changes);
+            emit changed(changes);
+        },
+        Qt::QueuedConnection);
+}
+
+void SqlChangeFeed::resolveIds(QList<SqlChange>& changes)
+{
+    QHash<QString, QSet<qint64>> rowids;
+    for (const SqlChange& change : qAsConst(changes))
+    {
+        if (change.operation != SqlOperation::Delete)
+            rowids[change.table].insert(change.rowid);
+    }
+
+    QSqlDatabase database = SqlConnectionPool::connection(m_origin);
+    QHash<QString, QHash<qint64, QVariant>> ids;
+    for (auto it = rowids.constBegin(); it != rowids.constEnd(); ++it)
+    {
+        if (!SqlSchemaCatalog::table(m_origin, it.key())->contains(sql::id))
+            continue;
+
+        const QList<qint64> tableRowids = it.value().values();
+        for (int offset = 0; offset < tableRowids.count(); offset += sql::maxBoundValues)
+        {
+            const QList<qint64> chunk = tableRowids.mid(offset, sql::maxBoundValues);
+
+            QStringList placeholders;
+            for (int i = 0; i < chunk.count(); ++i)
+            {
+                placeholders.append("?");
+            }
+
+            QSqlQuery query(database);
+            query.setForwardOnly(true);
+            query.prepare("SELECT rowid, " + sql::id + " FROM " + it.key() + " WHERE rowid IN (" +
+                          placeholders.join(sql::comma) + ")");
+            for (qint64 rowid : chunk)
+            {
+                query.addBindValue(rowid);
+            }
+
+            SqlStatementTimer timer(query.lastQuery());
+            if (!query.exec())
+            {
+                qWarning() << query.lastQuery() << query.lastError();
+                break;
+            }
+            while (query.next())
+            {
+                timer.addRows(1);
+                ids[it.key()].insert(query.value(0).toLongLong(), query.value(1));
+            }
+        }
+    }
+
+    // Deletes got the stored id from the trigger
+    QHash<QString, bool> uuids;
+    for (SqlChange& change : changes)
+    {
+        const QVariant stored = change.operation == SqlOperation::Delete
+                                    ? change.id
+                                    : ids.value(change.table).value(change.rowid);
+        if (stored.isNull())
+            continue;
+
+        if (!uuids.contains(change.table))
+        {
+            const SqlTableInfoPtr info = SqlSchemaCatalog::table(m_origin, change.table);
+            uuids.insert(change.table, info->isUuid(sql::id));
+        }
+        change.id = uuids.value(change.table) ? sql::fromUuidBlob(stored) : stored;
+    }
+}
+
+void SqlChangeFeed::createDeleteTriggers(const QSqlDatabase& connection)
+{
+    // Temporary triggers live only in this connection, virtual tables can't have them
+    QSqlQuery tables(connection);
+    if (!tables.exec("SELECT name FROM sqlite_master WHERE type = 'table' AND "
+                     "sql NOT LIKE 'CREATE VIRTUAL TABLE%' AND name NOT LIKE 'sqlite_%'"))
+    {
+        qWarning() << tables.lastQuery() << tables.lastError();
+        return;
+    }
+
+    QSqlQuery query(connection);
+    while (tables.next())
+    {
+        const QString table = tables.value(0).toString();
+        if (!connection.record(table).contains(sql::id))
+            continue;
+
+        const QString statement =
+            QString("CREATE TEMP TRIGGER IF NOT EXISTS %1_deleted_id AFTER DELETE ON main.%1 "
+                    "BEGIN SELECT %2('%1', old.rowid, old.%3); END")
+                .arg(table, ::deletedFunction, sql::id);
+        if (!query.exec(statement))
+            qWarning() << query.lastQuery() << query.lastError();
+    }
+}
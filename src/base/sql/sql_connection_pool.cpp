@@ -0,0 +1,124 @@
+#include "sql_connection_pool.h"
+
+#include <QDebug>
+#include <QReadWriteLock>
+#include <QSqlError>
+#include <QThread>
+
+#include "sql_table.h"
+
+namespace
+{
+// Pools by origin connection name, so tables can find them having just the database
+QHash<QString, md::data_source::SqlConnectionPool*>& pools()
+{
+    static QHash<QString, md::data_source::SqlConnectionPool*> pools;
+    return pools;
+}
+
+// Recursive, connection setup may look up the pool again
+QReadWriteLock& poolsLock()
+{
+    static QReadWriteLock lock(QReadWriteLock::Recursive);
+    return lock;
+}
+} // namespace
+
+using namespace md::data_source;
+
+SqlConnectionPool::SqlConnectionPool(const QSqlDatabase& origin, const Setup& setup) :
+    m_originName(origin.connectionName()),
+    m_originThread(QThread::currentThread()),
+    m_setup(setup)
+{
+    QWriteLocker locker(&::poolsLock());
+    ::pools().insert(m_originName, this);
+}
+
+SqlConnectionPool::~SqlConnectionPool()
+{
+    {
+        QWriteLocker locker(&::poolsLock());
+        ::pools().remove(m_originName);
+    }
+
+    // Threads are still running, so connections can only be dropped from here
+    QMutexLocker locker(&m_mutex);
+    for (const Clone& clone : qAsConst(m_clones))
+    {
+        QObject::disconnect(clone.threadFinished);
+        SqlTable::releaseConnection(clone.connectionName);
+        QSqlDatabase::removeDatabase(clone.connectionName);
+    }
+    m_clones.clear();
+}
+
+QSqlDatabase SqlConnectionPool::connection()
+{
+    QThread* thread = QThread::currentThread();
+    if (thread == m_originThread)
+        return QSqlDatabase::database(m_originName, false);
+
+    QMutexLocker locker(&m_mutex);
+
+    auto it = m_clones.constFind(thread);
+    if (it != m_clones.constEnd())
+        return QSqlDatabase::database(it.value().connectionName, false);
+
+    Clone clone;
+    clone.connectionName = m_originName + "_" + QString::number(++m_clonesCreated);
+
+    QSqlDatabase database = QSqlDatabase::cloneDatabase(m_originName, clone.connectionName);
+    if (!database.open())
+        qWarning() << "Can't open database connection" << clone.connectionName
+                   << database.lastError();
+
+    if (m_setup)
+        m_setup(database);
+
+    // Emitted from the finishing thread, so the connection is closed in its own thread
+    clone.threadFinished = QObject::connect(thread, &QThread::finished, [this, thread]() {
+        this->release(thread);
+    });
+    m_clones.insert(thread, clone);
+
+    return database;
+}
+
+int SqlConnectionPool::count() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_clones.count();
+}
+
+QSqlDatabase SqlConnectionPool::connection(const QSqlDatabase& origin)
+{
+    // Held while the pool is used, so it can't be destroyed meanwhile
+    QReadLocker locker(&::poolsLock());
+    SqlConnectionPool* pool = ::pools().value(origin.connectionName(), nullptr);
+    return pool ? pool->connection() : origin;
+}
+
+void SqlConnectionPool::release(QThread* thread)
+{
+    QMutexLocker locker(&m_mutex);
+
+    auto it = m_clones.find(thread);
+    if (it == m_clones.end())
+        return;
+
+    QObject::disconnect(it.value().threadFinished);
+    SqlConnectionPool::close(it.value().connectionName);
+    m_clones.erase(it);
+}
+
+void SqlConnectionPool::close(const QString& connectionName)
+{
+    // Cached statements would keep the connection in use
+    SqlTable::releaseConnection(connectionName);
+    {
+        QSqlDatabase database = QSqlDatabase::database(connectionName, false);
+        database.close();
+    }
+    QSqlDatabase::removeDatabase(connectionName);
+}
@@ -0,0 +1,31 @@
+#include "sql_row_sink.h"
+
+using namespace md::data_source;
+
+SqlRowSink::SqlRowSink(const QStringList& columns, const QStringList& jsonProperties,
+                       JsonEncoding jsonEncoding) :
+    m_columns(columns),
+    m_jsonProperties(jsonProperties),
+    m_jsonEncoding(jsonEncoding)
+{
+}
+
+bool SqlRowSink::accepts(const QString& field) const
+{
+    return m_columns.contains(field);
+}
+
+void SqlRowSink::writeValue(const QString& field, const QVariant& value)
+{
+    if (!this->accepts(field))
+        return;
+
+    m_row.insert(field, m_jsonProperties.contains(field)
+                            ? QVariant(sql::encodeJson(value, m_jsonEncoding))
+                            : value);
+}
+
+const QVariantMap& SqlRowSink::row() const
+{
+    return m_row;
+}
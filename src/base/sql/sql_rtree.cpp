@@ -0,0 +1,65 @@
+#include "sql_rtree.h"
+
+#include <QDebug>
+#include <QSqlError>
+
+#include "sql_statistics.h"
+
+using namespace md::data_source;
+
+SqlRTree::SqlRTree(QSqlDatabase* database, const QString& tableName, const QString& sourceTable,
+                   const QString& sourceKey, const QString& sourceColumn) :
+    SqlTable(database, tableName),
+    m_origin(database),
+    m_sourceTable(sourceTable),
+    m_sourceKey(sourceKey),
+    m_sourceColumn(sourceColumn)
+{
+}
+
+QVariantList SqlRTree::selectIntersecting(const QVector<SqlRange>& box) const
+{
+    // Columns are id followed by min & max pair for every dimension
+    const QStringList columns = this->columnNames();
+    if (box.isEmpty() || box.count() * 2 + 1 != columns.count())
+    {
+        qWarning() << "Box dimensions do not match" << this->tableName();
+        return {};
+    }
+
+    const QString tree = this->tableName();
+    const QString key = m_sourceTable + "." + m_sourceKey;
+    QStringList conditions;
+    for (int i = 0; i < box.count(); ++i)
+    {
+        conditions.append(tree + "." + columns.at(i * 2 + 2) + " >= :min_" + QString::number(i));
+        conditions.append(tree + "." + columns.at(i * 2 + 1) + " <= :max_" + QString::number(i));
+    }
+
+    QSqlQuery query = this->cachedQuery(
+        "SELECT " + m_sourceTable + "." + m_sourceColumn + " FROM " + tree + " JOIN " +
+        m_sourceTable + " ON " + key + " = " + tree + "." + columns.first() + " WHERE " +
+        conditions.join(" AND ") + " ORDER BY " + key);
+
+    for (int i = 0; i < box.count(); ++i)
+    {
+        query.bindValue(":min_" + QString::number(i), box.at(i).min);
+        query.bindValue(":max_" + QString::number(i), box.at(i).max);
+    }
+
+    SqlStatementTimer timer(query.lastQuery());
+    bool result = query.exec();
+    if (query.lastError().type() != QSqlError::NoError)
+        qWarning() << query.lastQuery() << query.lastError();
+
+    // Catalog is registered for the origin connection, not the one of a pool thread
+    const bool uuid = SqlSchemaCatalog::table(*m_origin, m_sourceTable)->isUuid(m_sourceColumn);
+    QVariantList values;
+    while (result && query.next())
+    {
+        values.append(uuid ? sql::fromUuidBlob(query.value(0)) : query.value(0));
+    }
+    timer.addRows(values.count());
+    query.finish();
+    return values;
+}
@@ -0,0 +1,178 @@
+#include "sql_schema_catalog.h"
+
+#include <QDebug>
+#include <QReadWriteLock>
+#include <QSqlError>
+#include <QSqlQuery>
+
+#include "sql_connection_pool.h"
+
+namespace
+{
+// Catalogs by origin connection name, like connection pools
+QHash<QString, md::data_source::SqlSchemaCatalog*>& catalogs()
+{
+    static QHash<QString, md::data_source::SqlSchemaCatalog*> catalogs;
+    return catalogs;
+}
+
+QReadWriteLock& catalogsLock()
+{
+    static QReadWriteLock lock;
+    return lock;
+}
+
+md::data_source::SqlSchemaCatalog* catalog(const QSqlDatabase& origin)
+{
+    QReadLocker locker(&::catalogsLock());
+    return ::catalogs().value(origin.connectionName(), nullptr);
+}
+} // namespace
+
+using namespace md::data_source;
+
+SqlTableInfo::SqlTableInfo(const QString& tableName, const QVector<SqlColumn>& columns) :
+    m_tableName(tableName),
+    m_columns(columns)
+{
+    for (int i = 0; i < m_columns.count(); ++i)
+    {
+        m_columnNames.append(m_columns.at(i).name);
+        m_indexes.insert(m_columns.at(i).name, i);
+    }
+}
+
+QString SqlTableInfo::tableName() const
+{
+    return m_tableName;
+}
+
+const QVector<SqlColumn>& SqlTableInfo::columns() const
+{
+    return m_columns;
+}
+
+const QStringList& SqlTableInfo::columnNames() const
+{
+    return m_columnNames;
+}
+
+bool SqlTableInfo::contains(const QString& column) const
+{
+    return m_indexes.contains(column);
+}
+
+int SqlTableInfo::indexOf(const QString& column) const
+{
+    return m_indexes.value(column, -1);
+}
+
+QString SqlTableInfo::type(const QString& column) const
+{
+    const int index = this->indexOf(column);
+    return index == -1 ? QString() : m_columns.at(index).type;
+}
+
+bool SqlTableInfo::isUuid(const QString& column) const
+{
+    const int index = this->indexOf(column);
+    return index != -1 && m_columns.at(index).type == "UUID";
+}
+
+bool SqlTableInfo::isStale() const
+{
+    return m_stale;
+}
+
+void SqlTableInfo::markStale() const
+{
+    m_stale = true;
+}
+
+QSharedPointer<SqlTableInfo> SqlTableInfo::introspect(const QSqlDatabase& database,
+                                                      const QString& tableName)
+{
+    QSqlQuery query(database);
+    query.exec("PRAGMA table_info(" + tableName + ")");
+    if (query.lastError().type() != QSqlError::NoError)
+        qWarning() << query.lastQuery() << query.lastError();
+
+    // cid, name, type, notnull, dflt_value, pk
+    QVector<SqlColumn> columns;
+    while (query.next())
+    {
+        SqlColumn column;
+        column.name = query.value(1).toString();
+        column.type = query.value(2).toString().toUpper();
+        column.notNull = query.value(3).toBool();
+        column.primaryKey = query.value(5).toInt() > 0;
+        columns.append(column);
+    }
+    return QSharedPointer<SqlTableInfo>::create(tableName, columns);
+}
+
+SqlSchemaCatalog::SqlSchemaCatalog(const QSqlDatabase& origin) : m_origin(origin)
+{
+    QWriteLocker locker(&::catalogsLock());
+    ::catalogs().insert(m_origin.connectionName(), this);
+}
+
+SqlSchemaCatalog::~SqlSchemaCatalog()
+{
+    {
+        QWriteLocker locker(&::catalogsLock());
+        ::catalogs().remove(m_origin.connectionName());
+    }
+    this->invalidate();
+}
+
+SqlTableInfoPtr SqlSchemaCatalog::table(const QString& tableName)
+{
+    QMutexLocker locker(&m_mutex);
+
+    auto it = m_tables.constFind(tableName);
+    if (it != m_tables.constEnd())
+        return it.value();
+
+    // Introspect with the connection of the calling thread
+    SqlTableInfoPtr info = SqlTableInfo::introspect(SqlConnectionPool::connection(m_origin),
+                                                    tableName);
+    m_tables.insert(tableName, info);
+    return info;
+}
+
+void SqlSchemaCatalog::invalidate()
+{
+    QMutexLocker locker(&m_mutex);
+
+    // Tables holding the info pick up a fresh one on the next access
+    for (const SqlTableInfoPtr& info : qAsConst(m_tables))
+    {
+        info->markStale();
+    }
+    m_tables.clear();
+    m_generation++;
+}
+
+int SqlSchemaCatalog::generation() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_generation;
+}
+
+SqlTableInfoPtr SqlSchemaCatalog::table(const QSqlDatabase& origin, const QString& tableName)
+{
+    SqlSchemaCatalog* catalog = ::catalog(origin);
+    if (catalog)
+        return catalog->table(tableName);
+
+    // Without catalog the caller keeps its own info
+    return SqlTableInfo::introspect(SqlConnectionPool::connection(origin), tableName);
+}
+
+void SqlSchemaCatalog::invalidate(const QSqlDatabase& origin)
+{
+    SqlSchemaCatalog* catalog = ::catalog(origin);
+    if (catalog)
+        catalog->invalidate();
+}
@@ -0,0 +1,183 @@
+#include "sql_statistics.h"
+
+#include <algorithm>
+
+#include <QDebug>
+#include <QRegularExpression>
+#include <QtMath>
+
+using namespace md::data_source;
+
+SqlStatistics* SqlStatistics::instance()
+{
+    static SqlStatistics statistics;
+    return &statistics;
+}
+
+bool SqlStatistics::isEnabled() const
+{
+    return m_enabled;
+}
+
+void SqlStatistics::setEnabled(bool enabled)
+{
+    m_enabled = enabled;
+}
+
+int SqlStatistics::slowQueryThresholdMs() const
+{
+    return m_slowQueryThresholdMs;
+}
+
+void SqlStatistics::setSlowQueryThresholdMs(int threshold)
+{
+    m_slowQueryThresholdMs = threshold;
+}
+
+void SqlStatistics::record(const QString& statement, qint64 elapsedNs, qint64 rows,
+                           qint64 rowsAffected)
+{
+    if (!m_enabled)
+        return;
+
+    const qint64 elapsedUs = elapsedNs / 1000;
+    const int threshold = m_slowQueryThresholdMs;
+    if (threshold > 0 && elapsedUs >= threshold * 1000)
+        qWarning() << "Slow query" << elapsedUs / 1000.0 << "ms, rows" << rows << "affected"
+                   << rowsAffected << statement;
+
+    // Bucket 0 holds [0, 1) us, bucket i holds [2^(i-1), 2^i) us
+    int bucket = 0;
+    while (bucket < histogramBuckets - 1 && elapsedUs >= (qint64(1) << bucket))
+    {
+        bucket++;
+    }
+
+    const QString normalized = SqlStatistics::normalize(statement);
+
+    QMutexLocker locker(&m_mutex);
+    Entry& entry = m_entries[normalized];
+    entry.count++;
+    entry.rows += rows;
+    entry.rowsAffected += rowsAffected;
+    entry.totalUs += elapsedUs;
+    entry.maxUs = qMax(entry.maxUs, elapsedUs);
+    entry.histogram[bucket]++;
+}
+
+QList<SqlStatementStats> SqlStatistics::statements() const
+{
+    QList<SqlStatementStats> list;
+    {
+        QMutexLocker locker(&m_mutex);
+        for (auto it = m_entries.constBegin(); it != m_entries.constEnd(); ++it)
+        {
+            list.append(SqlStatistics::stats(it.key(), it.value()));
+        }
+    }
+
+    std::sort(list.begin(), list.end(),
+              [](const SqlStatementStats& first, const SqlStatementStats& second) {
+                  return first.totalUs > second.totalUs;
+              });
+    return list;
+}
+
+SqlStatementStats SqlStatistics::statement(const QString& statement) const
+{
+    const QString normalized = SqlStatistics::normalize(statement);
+
+    QMutexLocker locker(&m_mutex);
+    return SqlStatistics::stats(normalized, m_entries.value(normalized));
+}
+
+void SqlStatistics::reset()
+{
+    QMutexLocker locker(&m_mutex);
+    m_entries.clear();
+}
+
+QString SqlStatistics::normalize(const QString& statement)
+{
+    static const QRegularExpression list("IN \\((\\s*(\\?|:\\w+)\\s*,?)+\\)");
+
+    if (!statement.contains("IN ("))
+        return statement;
+
+    QString normalized = statement;
+    return normalized.replace(list, "IN (...)");
+}
+
+SqlStatementStats SqlStatistics::stats(const QString& statement, const Entry& entry)
+{
+    SqlStatementStats stats;
+    stats.statement = statement;
+    stats.count = entry.count;
+    stats.rows = entry.rows;
+    stats.rowsAffected = entry.rowsAffected;
+    stats.totalUs = entry.totalUs;
+    stats.maxUs = entry.maxUs;
+
+    auto percentile = [&entry](double fraction) {
+        const int target = qCeil(entry.count * fraction);
+        int accumulated = 0;
+        for (int bucket = 0; bucket < histogramBuckets; ++bucket)
+        {
+            accumulated += entry.histogram[bucket];
+            if (accumulated >= target)
+                return qMin(qint64(1) << bucket, entry.maxUs);
+        }
+        return entry.maxUs;
+    };
+
+    if (entry.count)
+    {
+        stats.p50Us = percentile(0.5);
+        stats.p95Us = percentile(0.95);
+        stats.p99Us = percentile(0.99);
+    }
+    return stats;
+}
+
+SqlStatementTimer::SqlStatementTimer(const QString& statement) : m_statement(statement)
+{
+    if (SqlStatistics::instance()->isEnabled())
+        m_timer.start();
+}
+
+SqlStatementTimer::~SqlStatementTimer()
+{
+    if (!m_timer.isValid())
+        return;
+
+    this->pause();
+    SqlStatistics::instance()->record(m_statement, m_elapsedNs, m_rows, m_rowsAffected);
+}
+
+void SqlStatementTimer::addRows(qint64 rows)
+{
+    m_rows += rows;
+}
+
+void SqlStatementTimer::addRowsAffected(qint64 rows)
+{
+    m_rowsAffected += rows;
+}
+
+void SqlStatementTimer::pause()
+{
+    if (!m_timer.isValid() || m_paused)
+        return;
+
+    m_elapsedNs += m_timer.nsecsElapsed();
+    m_paused = true;
+}
+
+void SqlStatementTimer::resume()
+{
+    if (!m_timer.isValid() || !m_paused)
+        return;
+
+    m_timer.restart();
+    m_paused = false;
+}
@@ -1,26 +1,69 @@
 ﻿#include "sql_table.h"
 
 #include <QDebug>
+#include <QReadWriteLock>
+#include <QSet>
 #include <QSqlError>
+#include <QUuid>
+
+#include "sql_connection_pool.h"
+#include "sql_statistics.h"
+#include "sql_transaction.h"
+
+namespace
+{
+constexpr int maxCachedStatements = 64;
+constexpr char keptValues[] = "kept_values";
+
+// Live tables, so statements of a connection can be dropped before it is removed
+QSet<md::data_source::SqlTable*>& tables()
+{
+    static QSet<md::data_source::SqlTable*> tables;
+    return tables;
+}
+
+QReadWriteLock& tablesLock()
+{
+    static QReadWriteLock lock;
+    return lock;
+}
+} // namespace
 
 namespace md
 {
 namespace data_source
 {
-SqlTable::SqlTable(QSqlDatabase* database, const QString& tableName) :
-    m_database(database),
-    m_tableName(tableName)
+QVariant sql::toUuidBlob(const QVariant& value)
 {
-    QSqlQuery query(*m_database);
+    if (value.userType() == QMetaType::QUuid)
+        return value.toUuid().toRfc4122();
 
-    query.exec("PRAGMA table_info(" + m_tableName + ")");
-    if (query.lastError().type() != QSqlError::NoError)
-        qWarning() << query.lastQuery() << query.lastError();
+    if (value.userType() != QMetaType::QString)
+        return value;
 
-    while (query.next())
-    {
-        m_columnNames.append(query.value(1).toString());
-    }
+    // Non UUID strings are valid ids too, keep them as text. So are other spellings of a UUID,
+    // the blob reads back in the canonical form only
+    const QString text = value.toString();
+    const QUuid uuid(text);
+    return uuid.isNull() || uuid.toString() != text ? value : QVariant(uuid.toRfc4122());
+}
+
+QVariant sql::fromUuidBlob(const QVariant& value)
+{
+    if (value.userType() != QMetaType::QByteArray)
+        return value;
+
+    const QByteArray bytes = value.toByteArray();
+    return bytes.size() == 16 ? QVariant(QUuid::fromRfc4122(bytes).toString()) : value;
+}
+
+SqlTable::SqlTable(QSqlDatabase* database, const QString& tableName) :
+    m_database(database),
+    m_tableName(tableName),
+    m_tableInfo(SqlSchemaCatalog::table(*database, tableName))
+{
+    QWriteLocker locker(&::tablesLock());
+    ::tables().insert(this);
 }
 
 SqlTable::SqlTable(QSqlDatabase* database, const QString& tableName,
@@ -28,7 +71,23 @@ SqlTable::SqlTable(QSqlDatabase* database, const QString& tableName,
     m_database(database),
     m_tableName(tableName)
 {
-    m_columnNames = columnNames;
+    QVector<SqlColumn> columns;
+    for (const QString& name : columnNames)
+    {
+        SqlColumn column;
+        column.name = name;
+        columns.append(column);
+    }
+    m_tableInfo = QSharedPointer<SqlTableInfo>::create(tableName, columns);
+
+    QWriteLocker locker(&::tablesLock());
+    ::tables().insert(this);
+}
+
+SqlTable::~SqlTable()
+{
+    QWriteLocker locker(&::tablesLock());
+    ::tables().remove(this);
 }
 
 QList<QVariantMap> SqlTable::select(const ConditionMap& conditions,
@@ -43,54 +102,197 @@ QList<QVariantMap> SqlTable::select(const ConditionMap& conditions,
                                     const QStringList& orderByColumns,
                                     Qt::SortOrder sortOrder) const
 {
-    QSqlQuery query(*m_database);
+    const QStringList columns = resultColumns.isEmpty() ? this->columnNames() : resultColumns;
+    const SqlTableInfoPtr info = this->tableInfo();
+
+    QList<QVariantMap> map;
+    this->selectEach(
+        conditions, columns,
+        [&map, &columns, &info](const QSqlQuery& row) {
+            QVariantMap values;
+            for (int i = 0; i < columns.count(); ++i)
+            {
+                const QString& column = columns.at(i);
+                values.insert(column, info->isUuid(column) ? sql::fromUuidBlob(row.value(i))
+                                                           : row.value(i));
+            }
+            map.append(values);
+            return true;
+        },
+        orderByColumns, sortOrder);
+    return map;
+}
+
+QVariantList SqlTable::selectOne(const ConditionMap& conditions, const QString& resultColumn) const
+{
+    const bool uuid = this->tableInfo()->isUuid(resultColumn);
 
-    bool result = query.exec(
-        this->prepareSelect(conditions, resultColumns, orderByColumns, sortOrder));
+    QVariantList list;
+    this->selectEach(conditions, { resultColumn }, [&list, uuid](const QSqlQuery& row) {
+        list.append(uuid ? sql::fromUuidBlob(row.value(0)) : row.value(0));
+        return true;
+    });
+    return list;
+}
+
+bool SqlTable::selectEach(const ConditionMap& conditions, const QStringList& resultColumns,
+                          const RowVisitor& visitor, const QStringList& orderByColumns,
+                          Qt::SortOrder sortOrder) const
+{
+    const QStringList columns = resultColumns.isEmpty() ? this->columnNames() : resultColumns;
+
+    QSqlQuery query = this->cachedQuery(
+        this->prepareSelect(conditions, columns, orderByColumns, sortOrder));
+    this->bindConditions(query, conditions);
+
+    SqlStatementTimer timer(query.lastQuery());
+    bool result = query.exec();
     if (query.lastError().type() != QSqlError::NoError)
         qWarning() << query.lastQuery() << query.lastError();
 
     if (!result)
-        return QList<QVariantMap>();
+        return false;
 
-    QList<QVariantMap> map;
+    // Row values are accessed by index in the order of result columns
     while (query.next())
     {
+        timer.addRows(1);
+
+        // Visitor's own work is not the statement's time
+        timer.pause();
+        const bool next = visitor(query);
+        timer.resume();
+        if (!next)
+            break;
+    }
+    // Reset statement, it stays prepared in the cache
+    query.finish();
+    return true;
+}
+
+md::domain::Page SqlTable::selectPage(const ConditionMap& conditions,
+                                      const QStringList& resultColumns, const QString& keyColumn,
+                                      const domain::PageRequest& request) const
+{
+    // Sort column goes into the query text, it must be one of the table
+    if (!request.orderBy.isEmpty() && !this->tableInfo()->contains(request.orderBy))
+    {
+        qWarning() << "Can't order" << m_tableName << "by unknown column" << request.orderBy;
+        return domain::Page();
+    }
+
+    const QStringList columns = resultColumns.isEmpty() ? this->columnNames() : resultColumns;
+    const QString orderBy = request.orderBy.isEmpty() ? sql::rowid : request.orderBy;
+    const bool ascending = request.sortOrder == Qt::AscendingOrder;
+    const QString direction = ascending ? " ASC" : " DESC";
+    const bool continued = !request.afterId.isNull();
+    const bool afterNull = request.afterValue.isNull();
+
+    // Keyset columns follow the result ones
+    QString queryString = "SELECT " + columns.join(sql::comma) + sql::comma + orderBy +
+                          sql::comma + keyColumn + " FROM " + m_tableName;
+    if (!conditions.isEmpty())
+        queryString += this->where(conditions);
+    if (continued)
+    {
+        // NULLs sort lowest, row values can't compare them
+        QString after;
+        if (afterNull)
+            after = ascending ? orderBy + " IS NOT NULL OR " + keyColumn + " > :after_key"
+                              : orderBy + " IS NULL AND " + keyColumn + " < :after_key";
+        else
+            after = "(" + orderBy + sql::comma + keyColumn + (ascending ? ") > " : ") < ") +
+                    "(:after_value, :after_key)" +
+                    (ascending ? QString() : " OR " + orderBy + " IS NULL");
+        queryString += QString(conditions.isEmpty() ? " WHERE " : " AND ") + "(" + after + ")";
+    }
+    queryString += " ORDER BY " + orderBy + direction + sql::comma + keyColumn + direction +
+                   " LIMIT :limit";
+
+    QSqlQuery query = this->cachedQuery(queryString);
+    this->bindConditions(query, conditions);
+    if (continued)
+    {
+        if (!afterNull)
+            query.bindValue(":after_value", this->toStored(orderBy, request.afterValue));
+        query.bindValue(":after_key", this->toStored(keyColumn, request.afterId));
+    }
+    // One more row tells if there is a next page
+    const int limit = qMax(request.limit, 1);
+    query.bindValue(":limit", limit + 1);
+
+    SqlStatementTimer timer(query.lastQuery());
+    if (!query.exec())
+    {
+        qWarning() << query.lastQuery() << query.lastError();
+        return domain::Page();
+    }
+
+    const SqlTableInfoPtr info = this->tableInfo();
+    domain::Page page;
+    page.next = request;
+    QVariant lastValue;
+    QVariant lastKey;
+    while (query.next())
+    {
+        timer.addRows(1);
+        if (page.rows.count() == limit)
+        {
+            page.hasMore = true;
+            break;
+        }
+
         QVariantMap values;
-        for (const QString& column : resultColumns)
+        for (int i = 0; i < columns.count(); ++i)
         {
-            values.insert(column, query.value(column));
+            const QString& column = columns.at(i);
+            values.insert(column, info->isUuid(column) ? sql::fromUuidBlob(query.value(i))
+                                                       : query.value(i));
         }
-        map.append(values);
+        page.rows.append(values);
+        lastValue = query.value(columns.count());
+        lastKey = query.value(columns.count() + 1);
     }
-    return map;
+    query.finish();
+
+    if (!page.rows.isEmpty())
+    {
+        page.next.afterValue = this->fromStored(orderBy, lastValue);
+        page.next.afterId = this->fromStored(keyColumn, lastKey);
+    }
+
+    if (request.withTotal)
+        page.total = this->count(conditions);
+
+    return page;
 }
 
-QVariantList SqlTable::selectOne(const ConditionMap& conditions, const QString& resultColumn) const
+int SqlTable::count(const ConditionMap& conditions) const
 {
-    QSqlQuery query(*m_database);
-
-    bool result = query.exec(this->prepareSelect(conditions, { resultColumn }));
-    if (query.lastError().type() != QSqlError::NoError)
-        qWarning() << query.lastQuery() << query.lastError();
+    QString queryString = "SELECT count(*) FROM " + m_tableName;
+    if (!conditions.isEmpty())
+        queryString += this->where(conditions);
 
-    if (!result)
-        return QVariantList();
+    QSqlQuery query = this->cachedQuery(queryString);
+    this->bindConditions(query, conditions);
 
-    QVariantList list;
-    while (query.next())
+    SqlStatementTimer timer(query.lastQuery());
+    if (!query.exec() || !query.next())
     {
-        list.append(query.value(0));
+        qWarning() << query.lastQuery() << query.lastError();
+        return -1;
     }
-    return list;
+    timer.addRows(1);
+
+    const int count = query.value(0).toInt();
+    query.finish();
+    return count;
 }
 
 bool SqlTable::insert(const QVariantMap& valueMap, QVariant* id)
 {
     QVariantMap filtered = this->filterByColumns(valueMap);
 
-    QSqlQuery query(*m_database);
-
     QStringList placeholders;
     for (const QString& name : filtered.keys())
     {
@@ -99,12 +301,16 @@ bool SqlTable::insert(const QVariantMap& valueMap, QVariant* id)
 
     QString namesJoin = filtered.keys().join(sql::comma);
     QString valuesJoin = placeholders.join(sql::comma);
-    query.prepare("INSERT INTO " + m_tableName + " (" + namesJoin + ") VALUES (" + valuesJoin + ")");
+    QSqlQuery query = this->cachedQuery("INSERT INTO " + m_tableName + " (" + namesJoin +
+                                        ") VALUES (" + valuesJoin + ")");
     this->bind(query, filtered);
 
+    SqlStatementTimer timer(query.lastQuery());
     bool result = query.exec();
+    timer.addRowsAffected(query.numRowsAffected());
     if (query.lastError().type() != QSqlError::NoError)
         qWarning() << query.lastQuery() << query.lastError();
+    this->rowsChanged(filtered);
 
     if (!result)
         return false;
@@ -115,15 +321,102 @@ bool SqlTable::insert(const QVariantMap& valueMap, QVariant* id)
     return true;
 }
 
+bool SqlTable::insertMany(const QList<QVariantMap>& valueMaps)
+{
+    return this->writeMany(valueMaps, QString(), nullptr);
+}
+
+bool SqlTable::upsert(const QVariantMap& valueMap, const QString& keyColumn)
+{
+    return this->upsertMany({ valueMap }, keyColumn);
+}
+
+bool SqlTable::upsertMany(const QList<QVariantMap>& valueMaps, const QString& keyColumn)
+{
+    if (keyColumn.isEmpty())
+        return false;
+
+    return this->writeMany(valueMaps, keyColumn, nullptr);
+}
+
+bool SqlTable::upsert(const QVariantMap& valueMap, const QString& keyColumn,
+                      const QStringList& updateColumns)
+{
+    return this->upsertMany({ valueMap }, keyColumn, updateColumns);
+}
+
+bool SqlTable::upsertMany(const QList<QVariantMap>& valueMaps, const QString& keyColumn,
+                          const QStringList& updateColumns)
+{
+    if (keyColumn.isEmpty())
+        return false;
+
+    return this->writeMany(valueMaps, keyColumn, &updateColumns);
+}
+
+bool SqlTable::writeMany(const QList<QVariantMap>& valueMaps, const QString& keyColumn,
+                         const QStringList* updateColumns)
+{
+    if (valueMaps.isEmpty())
+        return true;
+
+    SqlTransaction transaction(this->database());
+
+    bool result = true;
+    QStringList names;
+    QVector<QVariantList> values;
+    for (const QVariantMap& valueMap : valueMaps)
+    {
+        QVariantMap filtered = this->filterByColumns(valueMap);
+
+        // Rows with the same column set share one batch statement
+        if (filtered.keys() != names)
+        {
+            if (!names.isEmpty() && !this->insertBatch(names, values, keyColumn, updateColumns))
+            {
+                result = false;
+                break;
+            }
+
+            names = filtered.keys();
+            values = QVector<QVariantList>(names.count());
+        }
+
+        int index = 0;
+        for (auto it = filtered.constBegin(); it != filtered.constEnd(); ++it)
+        {
+            values[index++].append(it.value());
+        }
+    }
+
+    if (result && !names.isEmpty())
+        result = this->insertBatch(names, values, keyColumn, updateColumns);
+
+    // Rolled back rows are left unchanged
+    if (!result || !transaction.commit())
+        return false;
+
+    for (const QVariantMap& valueMap : valueMaps)
+    {
+        this->rowsChanged(valueMap);
+    }
+    return true;
+}
+
 bool SqlTable::removeByConditions(const ConditionMap& conditions)
 {
     if (conditions.isEmpty())
         return false;
 
-    QSqlQuery query(*m_database);
-    bool result = query.exec("DELETE FROM " + m_tableName + this->where(conditions));
+    QSqlQuery query = this->cachedQuery("DELETE FROM " + m_tableName + this->where(conditions));
+    this->bindConditions(query, conditions);
+
+    SqlStatementTimer timer(query.lastQuery());
+    bool result = query.exec();
+    timer.addRowsAffected(query.numRowsAffected());
     if (query.lastError().type() != QSqlError::NoError)
         qWarning() << query.lastQuery() << query.lastError();
+    this->rowsChanged(conditions);
     return result;
 }
 
@@ -132,6 +425,62 @@ bool SqlTable::removeByCondition(const Condition& condition)
     return this->removeByConditions({ { condition.first, condition.second } });
 }
 
+bool SqlTable::removeExcept(const ConditionMap& conditions, const QString& column,
+                            const QVariantList& keptValues)
+{
+    if (conditions.isEmpty())
+        return false;
+
+    if (keptValues.isEmpty())
+        return this->removeByConditions(conditions);
+
+    const bool uuid = this->tableInfo()->isUuid(column);
+    QVariantList values;
+    values.reserve(keptValues.count());
+    for (const QVariant& value : keptValues)
+    {
+        values.append(uuid ? sql::toUuidBlob(value) : value);
+    }
+
+    SqlTransaction transaction(this->database());
+
+    // Too many values to bind, they go to a temporary table of the connection instead
+    const bool bound = keptValues.count() + conditions.count() <= sql::maxBoundValues;
+    QStringList placeholders;
+    if (bound)
+    {
+        for (int i = 0; i < values.count(); ++i)
+        {
+            placeholders.append(":except_" + QString::number(i));
+        }
+    }
+    else if (!this->fillKeptValues(values))
+    {
+        return false;
+    }
+
+    const QString kept = bound ? placeholders.join(sql::comma)
+                               : "SELECT value FROM temp." + QString(::keptValues);
+    QSqlQuery query = this->cachedQuery("DELETE FROM " + m_tableName + this->where(conditions) +
+                                        " AND " + column + " NOT IN (" + kept + ")");
+    this->bindConditions(query, conditions);
+    for (int i = 0; i < placeholders.count(); ++i)
+    {
+        query.bindValue(placeholders.at(i), values.at(i));
+    }
+
+    SqlStatementTimer timer(query.lastQuery());
+    bool result = query.exec();
+    timer.addRowsAffected(query.numRowsAffected());
+    if (query.lastError().type() != QSqlError::NoError)
+        qWarning() << query.lastQuery() << query.lastError();
+    this->rowsChanged(conditions);
+
+    if (!bound)
+        result = this->fillKeptValues({}) && result;
+    return result && transaction.commit();
+}
+
 bool SqlTable::updateByConditions(const QVariantMap& valueMap, const ConditionMap& conditions)
 {
     if (conditions.isEmpty())
@@ -145,14 +494,17 @@ bool SqlTable::updateByConditions(const QVariantMap& valueMap, const ConditionMa
         pairs.append(name + " = " + sql::hold + name);
     }
 
-    QSqlQuery query(*m_database);
-    query.prepare("UPDATE " + m_tableName + " SET " + pairs.join(sql::comma) +
-                  this->where(conditions));
+    QSqlQuery query = this->cachedQuery("UPDATE " + m_tableName + " SET " +
+                                        pairs.join(sql::comma) + this->where(conditions));
     this->bind(query, filtered);
+    this->bindConditions(query, conditions);
 
+    SqlStatementTimer timer(query.lastQuery());
     bool result = query.exec();
+    timer.addRowsAffected(query.numRowsAffected());
     if (query.lastError().type() != QSqlError::NoError)
         qWarning() << query.lastQuery() << query.lastError();
+    this->rowsChanged(conditions);
     return result;
 }
 
@@ -168,7 +520,53 @@ QString SqlTable::tableName() const
 
 QStringList SqlTable::columnNames() const
 {
-    return m_columnNames;
+    return this->tableInfo()->columnNames();
+}
+
+SqlTableInfoPtr SqlTable::tableInfo() const
+{
+    QMutexLocker locker(&m_tableInfoMutex);
+    if (m_tableInfo->isStale())
+        m_tableInfo = SqlSchemaCatalog::table(*m_database, m_tableName);
+
+    return m_tableInfo;
+}
+
+QVariant SqlTable::toStored(const QString& column, const QVariant& value) const
+{
+    return this->tableInfo()->isUuid(column) ? sql::toUuidBlob(value) : value;
+}
+
+QVariant SqlTable::fromStored(const QString& column, const QVariant& value) const
+{
+    return this->tableInfo()->isUuid(column) ? sql::fromUuidBlob(value) : value;
+}
+
+md::domain::TransactionPtr SqlTable::transaction() const
+{
+    return domain::TransactionPtr(new SqlTransaction(this->database()));
+}
+
+SqlStatementCacheStats SqlTable::statementCacheStats() const
+{
+    QMutexLocker locker(&m_statementsMutex);
+    return m_statementCacheStats;
+}
+
+void SqlTable::clearStatementCache()
+{
+    QMutexLocker locker(&m_statementsMutex);
+    m_statements.clear();
+}
+
+void SqlTable::releaseConnection(const QString& connectionName)
+{
+    QReadLocker locker(&::tablesLock());
+    for (SqlTable* table : qAsConst(::tables()))
+    {
+        QMutexLocker statementsLocker(&table->m_statementsMutex);
+        table->m_statements.remove(connectionName);
+    }
 }
 
 QString SqlTable::prepareSelect(const QVariantMap& conditions, const QStringList& resultColumns,
@@ -198,7 +596,7 @@ QString SqlTable::where(const QVariantMap& conditions) const
         }
         else
         {
-            conditionList.append(key + " = \'" + value.toString() + "\'");
+            conditionList.append(key + " = " + sql::whereHold + key);
         }
     }
     return QString(" WHERE ") + conditionList.join(" AND ");
@@ -206,21 +604,155 @@ QString SqlTable::where(const QVariantMap& conditions) const
 
 QVariantMap SqlTable::filterByColumns(const QVariantMap& valueMap)
 {
+    const SqlTableInfoPtr info = this->tableInfo();
+
     QVariantMap result;
-    for (const QString& key : valueMap.keys())
+    for (auto it = valueMap.constBegin(); it != valueMap.constEnd(); ++it)
     {
-        if (m_columnNames.contains(key))
-            result.insert(key, valueMap.value(key));
+        if (info->contains(it.key()))
+            result.insert(it.key(), it.value());
     }
     return result;
 }
 
-void SqlTable::bind(QSqlQuery& query, const QVariantMap& valueMap)
+bool SqlTable::insertBatch(const QStringList& names, const QVector<QVariantList>& values,
+                           const QString& keyColumn, const QStringList* updateColumns)
 {
-    for (const QString& name : valueMap.keys())
+    QStringList placeholders;
+    QStringList assignments;
+    for (const QString& name : names)
+    {
+        placeholders.append("?");
+        if (name != keyColumn && (!updateColumns || updateColumns->contains(name)))
+            assignments.append(name + " = excluded." + name);
+    }
+
+    QString queryString = "INSERT INTO " + m_tableName + " (" + names.join(sql::comma) +
+                          ") VALUES (" + placeholders.join(sql::comma) + ")";
+    // Upsert syntax needs SQLite 3.24
+    if (!keyColumn.isEmpty())
+    {
+        queryString += " ON CONFLICT(" + keyColumn + ") DO ";
+        queryString += assignments.isEmpty() ? QString("NOTHING")
+                                             : "UPDATE SET " + assignments.join(sql::comma);
+    }
+
+    const SqlTableInfoPtr info = this->tableInfo();
+    QSqlQuery query = this->cachedQuery(queryString);
+    for (int i = 0; i < names.count(); ++i)
     {
-        query.bindValue(sql::hold + name, valueMap.value(name));
+        if (!info->isUuid(names.at(i)))
+        {
+            query.addBindValue(values.at(i));
+            continue;
+        }
+
+        QVariantList column;
+        column.reserve(values.at(i).count());
+        for (const QVariant& value : values.at(i))
+        {
+            column.append(sql::toUuidBlob(value));
+        }
+        query.addBindValue(column);
     }
+
+    SqlStatementTimer timer(query.lastQuery());
+    bool result = query.execBatch();
+    timer.addRowsAffected(query.numRowsAffected());
+    if (query.lastError().type() != QSqlError::NoError)
+        qWarning() << query.lastQuery() << query.lastError();
+
+    return result;
+}
+
+void SqlTable::bind(QSqlQuery& query, const QVariantMap& valueMap) const
+{
+    const SqlTableInfoPtr info = this->tableInfo();
+    for (auto it = valueMap.constBegin(); it != valueMap.constEnd(); ++it)
+    {
+        query.bindValue(sql::hold + it.key(),
+                        info->isUuid(it.key()) ? sql::toUuidBlob(it.value()) : it.value());
+    }
+}
+
+void SqlTable::bindConditions(QSqlQuery& query, const QVariantMap& conditions) const
+{
+    const SqlTableInfoPtr info = this->tableInfo();
+    for (auto it = conditions.constBegin(); it != conditions.constEnd(); ++it)
+    {
+        // NULL conditions are expressed as IS NULL and have no placeholder
+        if (!it.value().isNull())
+            query.bindValue(sql::whereHold + it.key(),
+                            info->isUuid(it.key()) ? sql::toUuidBlob(it.value()) : it.value());
+    }
+}
+
+void SqlTable::rowsChanged(const ConditionMap& conditions)
+{
+    Q_UNUSED(conditions)
+}
+
+QSqlDatabase SqlTable::database() const
+{
+    return SqlConnectionPool::connection(*m_database);
+}
+
+bool SqlTable::fillKeptValues(const QVariantList& values) const
+{
+    QSqlQuery query(this->database());
+    if (!query.exec("CREATE TEMP TABLE IF NOT EXISTS " + QString(::keptValues) + " (value)") ||
+        !query.exec("DELETE FROM temp." + QString(::keptValues)))
+    {
+        qWarning() << query.lastQuery() << query.lastError();
+        return false;
+    }
+    if (values.isEmpty())
+        return true;
+
+    query.prepare("INSERT INTO temp." + QString(::keptValues) + " (value) VALUES (?)");
+    query.addBindValue(values);
+    if (!query.execBatch())
+    {
+        qWarning() << query.lastQuery() << query.lastError();
+        return false;
+    }
+    return true;
+}
+
+QSqlQuery SqlTable::cachedQuery(const QString& queryString) const
+{
+    QSqlDatabase database = this->database();
+
+    QMutexLocker locker(&m_statementsMutex);
+
+    // Prepared statements belong to the connection, so cache them per connection
+    StatementCachePtr& statements = m_statements[database.connectionName()];
+    if (!statements)
+        statements.reset(new QCache<QString, QSqlQuery>(::maxCachedStatements));
+
+    // Select still iterated up the stack, like the one of selectEach calling its visitor, would
+    // be reset by the copy, so the nested call gets a query of its own
+    const QSqlQuery* cached = statements->object(queryString);
+    const bool busy = cached && cached->isSelect() && cached->isActive();
+    if (cached && !busy)
+    {
+        m_statementCacheStats.hits++;
+        return *cached;
+    }
+    m_statementCacheStats.misses++;
+
+    QSqlQuery query(database);
+    query.setForwardOnly(true);
+    if (!query.prepare(queryString))
+    {
+        qWarning() << queryString << query.lastError();
+        return query;
+    }
+
+    // Least recently used statement is evicted, copies of QSqlQuery share the prepared statement
+    if (!busy)
+        statements->insert(queryString, new QSqlQuery(query));
+    return query;
 }
 
 } // namespace data_source
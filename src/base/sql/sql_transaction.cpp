@@ -0,0 +1,67 @@
+#include "sql_transaction.h"
+
+#include <QDebug>
+#include <QSqlError>
+#include <QSqlQuery>
+
+namespace
+{
+// SQLite releases or rolls back the innermost savepoint with the given name
+constexpr char savepoint[] = "kjarni_savepoint";
+} // namespace
+
+using namespace md::data_source;
+
+SqlTransaction::SqlTransaction(const QSqlDatabase& database) :
+    m_database(database),
+    m_active(false)
+{
+    m_active = this->exec(QString("SAVEPOINT ") + ::savepoint);
+}
+
+SqlTransaction::~SqlTransaction()
+{
+    if (m_active)
+        this->rollback();
+}
+
+bool SqlTransaction::isActive() const
+{
+    return m_active;
+}
+
+bool SqlTransaction::commit()
+{
+    if (!m_active)
+        return false;
+
+    if (!this->exec(QString("RELEASE SAVEPOINT ") + ::savepoint))
+    {
+        this->rollback();
+        return false;
+    }
+
+    m_active = false;
+    return true;
+}
+
+void SqlTransaction::rollback()
+{
+    if (!m_active)
+        return;
+
+    // ROLLBACK TO keeps the savepoint open, so release it afterwards
+    this->exec(QString("ROLLBACK TO SAVEPOINT ") + ::savepoint);
+    this->exec(QString("RELEASE SAVEPOINT ") + ::savepoint);
+    m_active = false;
+}
+
+bool SqlTransaction::exec(const QString& queryString)
+{
+    QSqlQuery query(m_database);
+
+    bool result = query.exec(queryString);
+    if (query.lastError().type() != QSqlError::NoError)
+        qWarning() << query.lastQuery() << query.lastError();
+    return result;
+}
@@ -0,0 +1,89 @@
+#include "sqlite_backup.h"
+
+#include <sqlite3.h>
+
+using namespace md::data_source;
+
+SqliteBackup::SqliteBackup(sqlite3* source, sqlite3* destination) :
+    m_destination(destination),
+    m_backup(source && destination ? sqlite3_backup_init(destination, "main", source, "main")
+                                   : nullptr)
+{
+    m_timer.start();
+    if (!m_backup)
+    {
+        m_failed = true;
+        m_errorString = destination ? QString::fromUtf8(sqlite3_errmsg(destination))
+                                    : QString("No destination connection");
+    }
+}
+
+SqliteBackup::~SqliteBackup()
+{
+    this->finish();
+}
+
+bool SqliteBackup::step(int pages)
+{
+    if (!m_backup || m_done)
+        return !m_failed;
+
+    const int result = sqlite3_backup_step(m_backup, pages);
+    m_pageCount = sqlite3_backup_pagecount(m_backup);
+    m_remaining = sqlite3_backup_remaining(m_backup);
+
+    switch (result)
+    {
+    case SQLITE_DONE:
+        m_done = true;
+        return true;
+    case SQLITE_OK:
+    case SQLITE_BUSY:
+    case SQLITE_LOCKED:
+        return true;
+    default:
+        m_failed = true;
+        m_errorString = QString::fromUtf8(sqlite3_errstr(result));
+        return false;
+    }
+}
+
+bool SqliteBackup::finish()
+{
+    if (m_backup)
+    {
+        // Errors of the steps are reported by finish as well
+        if (sqlite3_backup_finish(m_backup) != SQLITE_OK && !m_failed)
+        {
+            m_failed = true;
+            m_errorString = QString::fromUtf8(sqlite3_errmsg(m_destination));
+        }
+        m_backup = nullptr;
+    }
+    return m_done && !m_failed;
+}
+
+bool SqliteBackup::isDone() const
+{
+    return m_done;
+}
+
+int SqliteBackup::pageCount() const
+{
+    return m_pageCount;
+}
+
+int SqliteBackup::remaining() const
+{
+    return m_remaining;
+}
+
+qint64 SqliteBackup::elapsedMs() const
+{
+    return m_timer.elapsed();
+}
+
+QString SqliteBackup::errorString() const
+{
+    return m_errorString;
+}
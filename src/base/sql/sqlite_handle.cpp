@@ -0,0 +1,31 @@
+#include "sqlite_handle.h"
+
+#include <QDebug>
+#include <QSqlDriver>
+#include <QSqlError>
+#include <QSqlQuery>
+
+#include <sqlite3.h>
+
+sqlite3* md::data_source::sql::sqliteHandle(const QSqlDatabase& database)
+{
+    const QVariant handle = database.driver() ? database.driver()->handle() : QVariant();
+    if (!handle.isValid() || qstrcmp(handle.typeName(), "sqlite3*") != 0)
+        return nullptr;
+
+    // Plugin built with its bundled SQLite has a handle of another library than ours
+    QSqlQuery query(database);
+    if (!query.exec("SELECT sqlite_version()") || !query.next())
+    {
+        qWarning() << query.lastQuery() << query.lastError();
+        return nullptr;
+    }
+    if (query.value(0).toString() != QLatin1String(sqlite3_libversion()))
+    {
+        qWarning() << "QSQLITE uses SQLite" << query.value(0).toString()
+                   << "but kjarni is linked with" << sqlite3_libversion();
+        return nullptr;
+    }
+
+    return *static_cast<sqlite3* const*>(handle.constData());
+}
@@ -10,7 +10,7 @@ Mission::Mission(const MissionType* type, const QString& name, const QVariant& v
                  const QVariant& id, const QVariant& homeId, QObject* parent) :
     NamedMixin<Entity>(name, id, parent),
     type(type),
-    vehicleId(vehicleId, std::bind(&Entity::changed, this)),
+    vehicleId(vehicleId, this->notifier(props::vehicle)),
     route(new MissionRoute(name, true, id, this))
 {
     connect(route, &MissionRoute::changed, this, &Mission::changed);
@@ -22,15 +22,14 @@ Mission::Mission(const MissionType* type, const QVariantMap& map, QObject* paren
 {
 }
 
-QVariantMap Mission::toVariantMap() const
+void Mission::serialize(IEntitySink& sink) const
 {
-    QVariantMap map = NamedMixin<Entity>::toVariantMap();
+    NamedMixin<Entity>::serialize(sink);
 
-    map.insert(props::type, this->type()->id);
-    map.insert(props::vehicle, this->vehicleId());
-    map.insert(props::route, this->route()->toVariantMap());
-
-    return map;
+    sink.writeString(props::type, this->type()->id);
+    sink.writeValue(props::vehicle, this->vehicleId());
+    if (sink.accepts(props::route))
+        sink.writeMap(props::route, this->route()->toVariantMap());
 }
 
 void Mission::clear()
@@ -23,12 +23,11 @@ bool MissionOperation::isComplete() const
     return progress >= total;
 }
 
-QVariantMap MissionOperation::toVariantMap() const
+void MissionOperation::serialize(IEntitySink& sink) const
 {
-    QVariantMap map = Entity::toVariantMap();
-    map[props::progress] = this->progress();
-    map[props::total] = this->total();
-    map[props::complete] = this->isComplete();
-    map[props::type] = QVariant::fromValue(this->type()).toString();
-    return map;
+    Entity::serialize(sink);
+    sink.writeValue(props::progress, this->progress());
+    sink.writeValue(props::total, this->total());
+    sink.writeBool(props::complete, this->isComplete());
+    sink.writeString(props::type, QVariant::fromValue(this->type()).toString());
 }
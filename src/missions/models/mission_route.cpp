@@ -83,6 +83,11 @@ void MissionRoute::setItems(const QList<MissionRouteItem*>& items)
 }
 
 void MissionRoute::addItem(MissionRouteItem* item)
+{
+    this->insertItem(m_items.count(), item);
+}
+
+void MissionRoute::insertItem(int index, MissionRouteItem* item)
 {
     if (m_items.contains(item))
         return;
@@ -100,8 +105,13 @@ void MissionRoute::addItem(MissionRouteItem* item)
         emit goTo(this->index(item));
     });
 
-    m_items.append(item);
-    emit itemAdded(m_items.count() - 1, item);
+    index = qBound(0, index, m_items.count());
+    m_items.insert(index, item);
+    emit itemAdded(index, item);
+
+    // Current item stays the same
+    if (m_currentIndex >= index)
+        emit currentChanged(++m_currentIndex);
 }
 
 void MissionRoute::removeItem(MissionRouteItem* item)
@@ -11,9 +11,9 @@ MissionRouteItem::MissionRouteItem(const MissionItemType* type, const QString& n
                                    const Geodetic& position, QObject* parent) :
     TypedParametrisedMixin<NamedMixin<Entity>>(type->parameters.values().toVector(), params, name,
                                                id, parent),
-    position(position, std::bind(&Entity::changed, this)),
-    current(false, std::bind(&Entity::changed, this)),
-    reached(false, std::bind(&Entity::changed, this)),
+    position(position, this->notifier(props::position)),
+    current(false, this->notifier(props::current)),
+    reached(false, this->notifier(props::reached)),
     m_type(type)
 {
     Q_ASSERT(type);
@@ -26,26 +26,41 @@ MissionRouteItem::MissionRouteItem(const MissionItemType* type, const QVariantMa
 {
 }
 
-QVariantMap MissionRouteItem::toVariantMap() const
+void MissionRouteItem::serialize(IEntitySink& sink) const
 {
-    QVariantMap map = TypedParametrisedMixin<NamedMixin<Entity>>::toVariantMap();
-
-    map.insert(props::type, m_type->id);
-
-    map.insert(props::position, this->position().toVariantMap());
-    map.insert(props::current, this->current());
-    map.insert(props::reached, this->reached());
-
-    return map;
+    TypedParametrisedMixin<NamedMixin<Entity>>::serialize(sink);
+
+    sink.writeString(props::type, m_type->id);
+
+    if (sink.accepts(props::position))
+    {
+        const Geodetic& position = this->position();
+        sink.writeObject(props::position, [&position](IEntitySink& nested) {
+            nested.writeValue(geo::latitude, position.latitude());
+            nested.writeValue(geo::longitude, position.longitude());
+            nested.writeValue(geo::altitude, position.altitude());
+            nested.writeString(geo::datum, position.datum());
+        });
+    }
+    sink.writeBool(props::current, this->current());
+    sink.writeBool(props::reached, this->reached());
 }
 
-void MissionRouteItem::fromVariantMap(const QVariantMap& map)
+void MissionRouteItem::deserialize(const IEntitySource& source)
 {
-    position = map.value(props::position, this->position().toVariantMap()).toMap();
-    current = map.value(props::current, this->current()).toBool();
-    reached = map.value(props::reached, this->reached()).toBool();
+    QVariantMap coordinates;
+    if (source.readMap(props::position, coordinates))
+        position = coordinates;
+
+    bool value = this->current();
+    if (source.readBool(props::current, value))
+        current = value;
+
+    value = this->reached();
+    if (source.readBool(props::reached, value))
+        reached = value;
 
-    TypedParametrisedMixin<NamedMixin<Entity>>::fromVariantMap(map);
+    TypedParametrisedMixin<NamedMixin<Entity>>::deserialize(source);
 }
 
 const MissionItemType* MissionRouteItem::type() const
@@ -2,24 +2,42 @@
 
 #include <QDebug>
 
+#include "geo_traits.h"
 #include "mission_traits.h"
 
 namespace
 {
 constexpr char missionItems[] = "mission_items";
+constexpr char missionItemsTree[] = "mission_items_rtree";
+constexpr char missionItemsKey[] = "item_key";
+constexpr int cachedItems = 4096;
+
+constexpr double minLongitude = -180;
+constexpr double maxLongitude = 180;
 } // namespace
 
 using namespace md::data_source;
 
 MissionItemsRepositorySql::MissionItemsRepositorySql(QSqlDatabase* database) :
     domain::IMissionItemsRepository(),
-    m_routeItemsTable(database, ::missionItems, { domain::props::params, domain::props::position })
+    m_routeItemsTable(database, ::missionItems, { domain::props::params, domain::props::position },
+                      JsonEncoding::Cbor),
+    m_itemRows(database),
+    m_positionsTree(database, ::missionItemsTree, ::missionItems, ::missionItemsKey,
+                    domain::props::id)
+{
+    m_itemRows.setCacheCapacity(::cachedItems);
+}
+
+md::domain::TransactionPtr MissionItemsRepositorySql::transaction()
 {
+    return m_routeItemsTable.transaction();
 }
 
 QVariantMap MissionItemsRepositorySql::select(const QVariant& itemId)
 {
-    return m_routeItemsTable.selectById(itemId);
+    const std::optional<MissionItemRow> row = m_itemRows.selectRow(itemId);
+    return row ? MissionItemsSqlTable::toVariantMap(*row) : QVariantMap();
 }
 
 QVariantList MissionItemsRepositorySql::selectMissionRouteItemIds(const QVariant& missionId)
@@ -27,30 +45,214 @@ QVariantList MissionItemsRepositorySql::selectMissionRouteItemIds(const QVariant
     return m_routeItemsTable.selectOne({ { domain::props::mission, missionId } }, domain::props::id);
 }
 
-void MissionItemsRepositorySql::insert(domain::MissionRouteItem* item, const QVariant& missionId)
+QList<QVariantMap> MissionItemsRepositorySql::selectMissionItems(const QVariant& missionId)
+{
+    return m_routeItemsTable.selectByConditions({ { domain::props::mission, missionId } });
+}
+
+md::domain::Page MissionItemsRepositorySql::selectMissionItemsPage(
+    const QVariant& missionId, const domain::PageRequest& request)
+{
+    return m_routeItemsTable.selectPage({ { domain::props::mission, missionId } }, request);
+}
+
+QVariantList MissionItemsRepositorySql::selectItemIdsInRect(const domain::GeodeticRect& rect)
+{
+    const domain::Geodetic topLeft = rect.topLeft();
+    const domain::Geodetic bottomRight = rect.bottomRight();
+    const SqlRange latitudes = { qMin(topLeft.latitude(), bottomRight.latitude()),
+                                 qMax(topLeft.latitude(), bottomRight.latitude()) };
+
+    // West edge east of the east edge means rect crosses the antimeridian
+    if (topLeft.longitude() <= bottomRight.longitude())
+        return m_positionsTree.selectIntersecting(
+            { latitudes, { topLeft.longitude(), bottomRight.longitude() } });
+
+    return m_positionsTree.selectIntersecting(
+               { latitudes, { topLeft.longitude(), ::maxLongitude } }) +
+           m_positionsTree.selectIntersecting(
+               { latitudes, { ::minLongitude, bottomRight.longitude() } });
+}
+
+bool MissionItemsRepositorySql::insert(domain::MissionRouteItem* item, const QVariant& missionId)
 {
-    QVariantMap map = m_routeItemsTable.entityToMap(item);
+    QVariantMap map = this->itemToMap(item, m_routeItemsTable.columnNames());
 
     map.insert(domain::props::mission, missionId);
-    m_routeItemsTable.insert(map);
+    if (!m_routeItemsTable.insert(map))
+        return false;
+
+    this->rowsWritten({ item });
+    item->markClean();
+    return true;
+}
+
+bool MissionItemsRepositorySql::insertItems(const QList<domain::MissionRouteItem*>& items,
+                                            const QVariant& missionId)
+{
+    if (!m_routeItemsTable.insertMany(this->itemsToMaps(items, missionId)))
+        return false;
+
+    this->rowsWritten(items);
+    for (domain::MissionRouteItem* item : items)
+    {
+        item->markClean();
+    }
+    return true;
+}
+
+bool MissionItemsRepositorySql::upsert(domain::MissionRouteItem* item, const QVariant& missionId)
+{
+    return this->upsertItems({ item }, missionId);
+}
+
+bool MissionItemsRepositorySql::upsertItems(const QList<domain::MissionRouteItem*>& items,
+                                            const QVariant& missionId)
+{
+    // Stored items get only changed columns, items with the same ones share one statement
+    QMap<QStringList, QList<domain::MissionRouteItem*>> groups;
+    for (domain::MissionRouteItem* item : items)
+    {
+        QStringList columns = this->dirtyColumns(item);
+        // Item could be moved from another mission
+        if (!columns.contains(domain::props::mission))
+            columns.append(domain::props::mission);
+        columns.sort();
+        groups[columns].append(item);
+    }
+
+    domain::TransactionPtr transaction = m_routeItemsTable.transaction();
+    for (auto it = groups.constBegin(); it != groups.constEnd(); ++it)
+    {
+        if (!m_routeItemsTable.upsertMany(this->itemsToMaps(it.value(), missionId),
+                                          domain::props::id, it.key()))
+            return false;
+    }
+    if (!transaction->commit())
+        return false;
+
+    this->rowsWritten(items);
+    for (domain::MissionRouteItem* item : items)
+    {
+        item->markClean();
+    }
+    return true;
 }
 
 void MissionItemsRepositorySql::read(domain::MissionRouteItem* item)
 {
-    m_routeItemsTable.readEntity(item);
+    m_itemRows.readEntity(item);
 }
 
-void MissionItemsRepositorySql::update(domain::MissionRouteItem* item)
+bool MissionItemsRepositorySql::update(domain::MissionRouteItem* item)
 {
-    m_routeItemsTable.updateEntity(item);
+    // Nothing to write when only runtime state like current or reached has changed
+    const QStringList columns = this->dirtyColumns(item);
+    if (!columns.isEmpty() &&
+        !m_routeItemsTable.updateById(this->itemToMap(item, columns), item->id))
+        return false;
+
+    this->rowsWritten({ item });
+    item->markClean();
+    return true;
+}
+
+bool MissionItemsRepositorySql::remove(domain::MissionRouteItem* item)
+{
+    if (!m_routeItemsTable.removeEntity(item))
+        return false;
+
+    this->rowsWritten({ item });
+    return true;
+}
+
+bool MissionItemsRepositorySql::removeById(const QVariant& id)
+{
+    if (!m_routeItemsTable.removeById(id))
+        return false;
+
+    m_itemRows.invalidateCache({ { domain::props::id, id } });
+    return true;
+}
+
+bool MissionItemsRepositorySql::removeByIds(const QVariantList& ids)
+{
+    if (!m_routeItemsTable.removeByIds(ids))
+        return false;
+
+    for (const QVariant& id : ids)
+    {
+        m_itemRows.invalidateCache({ { domain::props::id, id } });
+    }
+    return true;
+}
+
+bool MissionItemsRepositorySql::removeMissionItemsExcept(const QVariant& missionId,
+                                                         const QVariantList& keptIds)
+{
+    if (!m_routeItemsTable.removeExcept({ { domain::props::mission, missionId } },
+                                        domain::props::id, keptIds))
+        return false;
+
+    m_itemRows.invalidateCache({ { domain::props::mission, missionId } });
+    return true;
+}
+
+void MissionItemsRepositorySql::forgetMissionItems(const QVariant& missionId)
+{
+    m_itemRows.invalidateCache({ { domain::props::mission, missionId } });
+}
+
+void MissionItemsRepositorySql::rowsWritten(const QList<domain::MissionRouteItem*>& items)
+{
+    // Writes go past the typed table, its cached rows are dropped by hand
+    for (domain::MissionRouteItem* item : items)
+    {
+        m_itemRows.invalidateCache({ { domain::props::id, item->id } });
+    }
 }
 
-void MissionItemsRepositorySql::remove(domain::MissionRouteItem* item)
+QStringList MissionItemsRepositorySql::dirtyColumns(domain::MissionRouteItem* item) const
 {
-    m_routeItemsTable.removeEntity(item);
+    QStringList columns = m_routeItemsTable.dirtyColumns(item);
+
+    // Native coordinates follow the position
+    if (columns.contains(domain::props::position))
+    {
+        columns.append({ domain::geo::latitude, domain::geo::longitude, domain::geo::altitude });
+        columns.removeDuplicates();
+    }
+    return columns;
+}
+
+QVariantMap MissionItemsRepositorySql::itemToMap(domain::MissionRouteItem* item,
+                                                 const QStringList& columns)
+{
+    QVariantMap map = m_routeItemsTable.entityToMap(item, columns);
+    if (!columns.contains(domain::geo::latitude))
+        return map;
+
+    // Native coordinates for the spatial index, NULL for items without position
+    const domain::Geodetic position = item->position();
+    map.insert(domain::geo::latitude,
+               position.isValidPosition() ? QVariant(position.latitude()) : QVariant());
+    map.insert(domain::geo::longitude,
+               position.isValidPosition() ? QVariant(position.longitude()) : QVariant());
+    map.insert(domain::geo::altitude,
+               position.isValidAltitude() ? QVariant(position.altitude()) : QVariant());
+    return map;
 }
 
-void MissionItemsRepositorySql::removeById(const QVariant& id)
+QList<QVariantMap> MissionItemsRepositorySql::itemsToMaps(
+    const QList<domain::MissionRouteItem*>& items, const QVariant& missionId)
 {
-    m_routeItemsTable.removeById(id);
+    QList<QVariantMap> maps;
+    maps.reserve(items.count());
+    for (domain::MissionRouteItem* item : items)
+    {
+        QVariantMap map = this->itemToMap(item, m_routeItemsTable.columnNames());
+        map.insert(domain::props::mission, missionId);
+        maps.append(map);
+    }
+    return maps;
 }
@@ -7,14 +7,24 @@
 namespace
 {
 constexpr char missions[] = "missions";
+constexpr char missionItems[] = "mission_items";
+constexpr int cachedMissions = 256;
 } // namespace
 
 using namespace md::data_source;
 
 MissionsRepositorySql::MissionsRepositorySql(QSqlDatabase* database) :
     domain::IMissionsRepository(),
-    m_missionsTable(database, ::missions)
+    m_missionsTable(database, ::missions),
+    m_itemsTable(database, ::missionItems, { domain::props::params, domain::props::position },
+                 JsonEncoding::Cbor)
 {
+    m_missionsTable.setCacheCapacity(::cachedMissions);
+}
+
+md::domain::TransactionPtr MissionsRepositorySql::transaction()
+{
+    return m_missionsTable.transaction();
 }
 
 QVariantMap MissionsRepositorySql::select(const QVariant& missionId)
@@ -22,11 +32,30 @@ QVariantMap MissionsRepositorySql::select(const QVariant& missionId)
     return m_missionsTable.selectById(missionId);
 }
 
+md::domain::MissionRecord MissionsRepositorySql::selectWithItems(const QVariant& missionId)
+{
+    // Both statements read the same snapshot
+    domain::TransactionPtr transaction = m_missionsTable.transaction();
+
+    domain::MissionRecord record;
+    record.mission = m_missionsTable.selectById(missionId);
+    if (!record.mission.isEmpty())
+        record.items = m_itemsTable.selectByConditions({ { domain::props::mission, missionId } });
+
+    transaction->commit();
+    return record;
+}
+
 QVariantList MissionsRepositorySql::selectMissionIds()
 {
     return m_missionsTable.selectIds();
 }
 
+md::domain::Page MissionsRepositorySql::selectPage(const domain::PageRequest& request)
+{
+    return m_missionsTable.selectPage({}, request);
+}
+
 QVariant MissionsRepositorySql::selectMissionIdForVehicle(const QVariant& vehicleId)
 {
     auto select = m_missionsTable.selectOne({ { domain::props::vehicle, vehicleId } },
@@ -34,9 +63,14 @@ QVariant MissionsRepositorySql::selectMissionIdForVehicle(const QVariant& vehicl
     return select.isEmpty() ? QVariant() : select.first();
 }
 
-void MissionsRepositorySql::insert(domain::Mission* mission)
+bool MissionsRepositorySql::insert(domain::Mission* mission)
+{
+    return m_missionsTable.insertEntity(mission);
+}
+
+bool MissionsRepositorySql::upsert(domain::Mission* mission)
 {
-    m_missionsTable.insertEntity(mission);
+    return m_missionsTable.upsertEntity(mission);
 }
 
 void MissionsRepositorySql::read(domain::Mission* mission)
@@ -44,12 +78,12 @@ void MissionsRepositorySql::read(domain::Mission* mission)
     m_missionsTable.readEntity(mission);
 }
 
-void MissionsRepositorySql::update(domain::Mission* mission)
+bool MissionsRepositorySql::update(domain::Mission* mission)
 {
-    m_missionsTable.updateEntity(mission);
+    return m_missionsTable.updateEntity(mission);
 }
 
-void MissionsRepositorySql::remove(domain::Mission* mission)
+bool MissionsRepositorySql::remove(domain::Mission* mission)
 {
-    m_missionsTable.removeEntity(mission);
+    return m_missionsTable.removeEntity(mission);
 }
@@ -1,17 +1,44 @@
 #include "missions_service.h"
 
 #include <QDebug>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QSet>
 
 #include "mission_traits.h"
 #include "utils.h"
 
 using namespace md::domain;
 
+namespace
+{
+// Snapshot of a stored entity writes only the columns changed in the original
+void copyDirtyState(const Entity* original, Entity* snapshot)
+{
+    if (!original->isPersisted())
+        return;
+
+    snapshot->markClean();
+    for (const QString& field : original->dirtyFields())
+    {
+        snapshot->markDirty(field);
+    }
+}
+
+void markCleanIfWritten(Entity* entity, const Entity* written)
+{
+    if (!entity->differs(written->toVariantMap()))
+        entity->markClean();
+}
+} // namespace
+
 MissionsService::MissionsService(IMissionsRepository* missionsRepo,
-                                 IMissionItemsRepository* itemsRepo, QObject* parent) :
+                                 IMissionItemsRepository* itemsRepo,
+                                 PersistenceQueue* persistence, QObject* parent) :
     IMissionsService(parent),
     m_missionsRepo(missionsRepo),
     m_itemsRepo(itemsRepo),
+    m_persistence(persistence),
     m_mutex(QMutex::Recursive)
 {
 }
@@ -150,11 +177,26 @@ void MissionsService::removeMission(Mission* mission)
     if (operation)
         this->endOperation(operation, MissionOperation::Canceled);
 
-    // Delete items first
-    this->removeItems(m_itemsRepo->selectMissionRouteItemIds(mission->route()->id));
+    if (m_persistence)
+    {
+        // Replaces a queued save of the mission and keeps it pending, so refreshes for the row
+        // still in the storage don't bring the mission back
+        QSharedPointer<Mission> snapshot = this->snapshotMission(mission);
+        m_persistence->enqueue(
+            mission->id().toString(),
+            [this, snapshot]() {
+                return this->deleteMission(snapshot.data());
+            },
+            [snapshot](bool ok) {
+                if (!ok)
+                    qWarning() << "Mission was not deleted" << snapshot->id();
+            });
+    }
+    else
+    {
+        this->deleteMission(mission);
+    }
 
-    // Remove mission
-    m_missionsRepo->remove(mission);
     m_missions.remove(mission->id);
 
     emit missionRemoved(mission);
@@ -163,16 +205,33 @@ void MissionsService::removeMission(Mission* mission)
 
 void MissionsService::restoreMission(Mission* mission)
 {
-    QMutexLocker locker(&m_mutex);
+    QPointer<Mission> guarded(mission);
+    this->afterWrites([this, guarded]() {
+        QMutexLocker locker(&m_mutex);
+        if (guarded)
+            this->restoreMissionImpl(guarded);
+    });
+}
+
+void MissionsService::restoreMissionImpl(Mission* mission)
+{
+    // All stored items at once
+    const QList<QVariantMap> stored = m_itemsRepo->selectMissionItems(mission->route()->id);
+    QHash<QString, QVariantMap> storedItems;
+    for (const QVariantMap& map : stored)
+    {
+        storedItems.insert(map.value(props::id).toString(), map);
+    }
 
-    QVariantList itemIds = m_itemsRepo->selectMissionRouteItemIds(mission->route()->id);
     for (MissionRouteItem* item : mission->route()->items())
     {
         // Restore stored item
-        if (itemIds.contains(item->id))
+        auto it = storedItems.find(item->id().toString());
+        if (it != storedItems.end())
         {
-            this->restoreItemImpl(item);
-            itemIds.removeOne(item->id);
+            item->fromVariantMap(it.value());
+            item->markClean();
+            storedItems.erase(it);
         }
         // Remove newbie items
         else
@@ -182,9 +241,12 @@ void MissionsService::restoreMission(Mission* mission)
     }
 
     // Read removed items
-    for (const QVariant& itemId : itemIds)
+    for (const QVariantMap& map : stored)
     {
-        auto item = this->readItem(itemId);
+        if (!storedItems.contains(map.value(props::id).toString()))
+            continue;
+
+        auto item = this->readItem(map);
         if (item)
             mission->route()->addItem(item); // TODO: valid index
     }
@@ -198,35 +260,36 @@ void MissionsService::restoreMission(Mission* mission)
 void MissionsService::saveMission(Mission* mission)
 {
     QMutexLocker locker(&m_mutex);
-    bool added;
+    const bool added = !m_missions.contains(mission->id);
 
-    // Update or insert route
-    if (m_missions.contains(mission->id))
+    if (m_persistence)
     {
-        m_missionsRepo->update(mission);
-        added = false;
+        // Queued insert and update of a new mission collapse, so the write must be an upsert
+        QSharedPointer<Mission> snapshot = this->snapshotMission(mission);
+        QPointer<Mission> original(mission);
+        this->enqueueWrite(
+            mission->id().toString(),
+            [this, snapshot]() {
+                return this->storeMission(snapshot.data(), &IMissionsRepository::upsert);
+            },
+            [this, original, snapshot](bool ok) {
+                this->missionWritten(original, snapshot.data(), ok);
+            });
     }
     else
     {
-        m_missionsRepo->insert(mission);
+        this->storeMission(mission, added ? &IMissionsRepository::insert
+                                          : &IMissionsRepository::update);
+    }
+
+    if (added)
+    {
         m_missions.insert(mission->id, mission);
 
         mission->moveToThread(this->thread());
         mission->setParent(this);
-        added = true;
-    }
-
-    // Update or insert items
-    QVariantList itemIds = m_itemsRepo->selectMissionRouteItemIds(mission->route()->id);
-    for (MissionRouteItem* item : mission->route()->items())
-    {
-        this->saveItemImpl(item, mission->route()->id, itemIds);
-        itemIds.removeOne(item->id);
     }
 
-    // Delete removed items
-    this->removeItems(itemIds);
-
     added ? emit missionAdded(mission) : emit missionChanged(mission);
 }
 
@@ -234,22 +297,163 @@ void MissionsService::saveItem(MissionRoute* route, MissionRouteItem* item)
 {
     QMutexLocker locker(&m_mutex);
 
-    this->saveItemImpl(item, route->id, m_itemsRepo->selectMissionRouteItemIds(route->id));
+    if (!m_persistence)
+    {
+        m_itemsRepo->upsert(item, route->id);
+        return;
+    }
+
+    // Dragged item is saved on every move, queue keeps only the latest position
+    QSharedPointer<MissionRouteItem> snapshot = this->snapshotItem(item);
+    QPointer<MissionRouteItem> original(item);
+    const QVariant routeId = route->id;
+    this->enqueueWrite(
+        item->id().toString(),
+        [this, snapshot, routeId]() {
+            return m_itemsRepo->upsert(snapshot.data(), routeId);
+        },
+        [this, original, snapshot](bool ok) {
+            this->itemWritten(original, snapshot.data(), ok);
+        });
 }
 
 void MissionsService::restoreItem(MissionRoute* route, MissionRouteItem* item)
 {
     Q_UNUSED(route)
 
+    QPointer<MissionRouteItem> guarded(item);
+    this->afterWrites([this, guarded]() {
+        QMutexLocker locker(&m_mutex);
+        if (guarded)
+            this->restoreItemImpl(guarded);
+    });
+}
+
+void MissionsService::refreshMissions(const QVariantList& missionIds)
+{
+    QMutexLocker locker(&m_mutex);
+
+    for (const QVariant& missionId : missionIds)
+    {
+        // Storage is behind the queued writes
+        if (this->isWritePending(missionId))
+            continue;
+
+        Mission* mission = m_missions.value(missionId, nullptr);
+        const QVariantMap map = m_missionsRepo->select(missionId);
+
+        if (map.isEmpty())
+        {
+            if (!mission)
+                continue;
+
+            MissionOperation* operation = this->operationForMission(mission);
+            if (operation)
+                this->endOperation(operation, MissionOperation::Canceled);
+
+            m_missions.remove(missionId);
+            emit missionRemoved(mission);
+            mission->deleteLater();
+        }
+        else if (!mission)
+        {
+            this->readMission(missionId);
+        }
+        // Unsaved changes are kept, unchanged missions are not reported
+        else if (!mission->isDirty() && mission->differs(map))
+        {
+            mission->fromVariantMap(map);
+            mission->markClean();
+            emit missionChanged(mission);
+        }
+    }
+}
+
+void MissionsService::refreshItems(const QVariantList& itemIds)
+{
     QMutexLocker locker(&m_mutex);
 
-    this->restoreItemImpl(item);
+    QHash<QString, MissionRouteItem*> items;
+    QHash<QString, Mission*> routeMissions;
+    QHash<MissionRouteItem*, Mission*> itemMissions;
+    for (Mission* mission : qAsConst(m_missions))
+    {
+        routeMissions.insert(mission->route()->id().toString(), mission);
+        for (MissionRouteItem* item : mission->route()->items())
+        {
+            items.insert(item->id().toString(), item);
+            itemMissions.insert(item, mission);
+        }
+    }
+
+    QSet<Mission*> changed;
+    QHash<Mission*, QVariantList> storedIds;
+    for (const QVariant& itemId : itemIds)
+    {
+        MissionRouteItem* item = items.value(itemId.toString(), nullptr);
+        // Storage is behind the queued writes
+        if (this->isWritePending(itemId) ||
+            (item && this->isWritePending(itemMissions.value(item)->id())))
+            continue;
+
+        const QVariantMap map = m_itemsRepo->select(itemId);
+        if (map.isEmpty())
+        {
+            if (!item)
+                continue;
+
+            Mission* mission = itemMissions.value(item);
+            items.remove(itemId.toString());
+            mission->route()->removeItem(item);
+            changed.insert(mission);
+        }
+        else if (!item)
+        {
+            Mission* mission = routeMissions.value(map.value(props::mission).toString(), nullptr);
+            if (!mission)
+                continue;
+
+            item = this->readItem(map);
+            if (!item)
+                continue;
+
+            // Stored route order, counting the held items stored before
+            if (!storedIds.contains(mission))
+                storedIds.insert(mission, m_itemsRepo->selectMissionRouteItemIds(mission->id()));
+            int index = 0;
+            for (const QVariant& storedId : storedIds.value(mission))
+            {
+                if (storedId.toString() == itemId.toString())
+                    break;
+                if (items.contains(storedId.toString()))
+                    index++;
+            }
+
+            mission->route()->insertItem(index, item);
+            items.insert(itemId.toString(), item);
+            itemMissions.insert(item, mission);
+            changed.insert(mission);
+        }
+        // Unsaved changes are kept, unchanged items are not reported
+        else if (!item->isDirty() && item->differs(map))
+        {
+            item->fromVariantMap(map);
+            item->markClean();
+            changed.insert(itemMissions.value(item));
+        }
+    }
+
+    for (Mission* mission : qAsConst(changed))
+    {
+        emit missionChanged(mission);
+    }
 }
 
 Mission* MissionsService::readMission(const QVariant& id)
 {
-    QVariantMap map = m_missionsRepo->select(id);
-    QString typeId = map.value(props::type).toString();
+    // Mission with its items in one read
+    const MissionRecord record = m_missionsRepo->selectWithItems(id);
+    QString typeId = record.mission.value(props::type).toString();
 
     const MissionType* const type = m_missionTypes.value(typeId);
     if (!type)
@@ -259,13 +463,13 @@ Mission* MissionsService::readMission(const QVariant& id)
     }
 
     // Create mission
-    Mission* mission = new Mission(type, map);
+    Mission* mission = new Mission(type, record.mission);
+    mission->markClean();
     m_missions.insert(id, mission);
 
-    // Read items for route
-    for (const QVariant& itemId : m_itemsRepo->selectMissionRouteItemIds(id))
+    for (const QVariantMap& map : record.items)
     {
-        auto item = this->readItem(itemId);
+        auto item = this->readItem(map);
         if (item)
             mission->route()->addItem(item);
     }
@@ -274,10 +478,9 @@ Mission* MissionsService::readMission(const QVariant& id)
     return mission;
 }
 
-MissionRouteItem* MissionsService::readItem(const QVariant& id)
+MissionRouteItem* MissionsService::readItem(const QVariantMap& map)
 {
-    QVariantMap select = m_itemsRepo->select(id);
-    QString itemTypeId = select.value(props::type).toString();
+    QString itemTypeId = map.value(props::type).toString();
     const MissionItemType* itemType = nullptr;
     for (const MissionType* routeType : qAsConst(m_missionTypes))
     {
@@ -292,34 +495,152 @@ MissionRouteItem* MissionsService::readItem(const QVariant& id)
         return nullptr;
     }
 
-    // Read current item
-    return new MissionRouteItem(itemType, select);
+    // Read current item, it is in sync with the storage
+    auto item = new MissionRouteItem(itemType, map);
+    item->markClean();
+    return item;
+}
+
+void MissionsService::restoreItemImpl(MissionRouteItem* item)
+{
+    m_itemsRepo->read(item);
 }
 
-void MissionsService::saveItemImpl(MissionRouteItem* item, const QVariant& parentId,
-                                   const QVariantList& itemIds)
+bool MissionsService::storeMission(Mission* mission, bool (IMissionsRepository::*write)(Mission*))
 {
-    // Update stored item
-    if (itemIds.contains(item->id))
+    // Store mission with all items at once
+    TransactionPtr transaction = m_missionsRepo->transaction();
+
+    if (!(m_missionsRepo->*write)(mission))
+        return false;
+
+    // Insert or update all items in one batch
+    const QList<MissionRouteItem*> items = mission->route()->items();
+    QVariantList itemIds;
+    for (MissionRouteItem* item : items)
     {
-        m_itemsRepo->update(item);
+        itemIds.append(item->id);
     }
-    // Insert newbie items
-    else
+    if (!items.isEmpty() && !m_itemsRepo->upsertItems(items, mission->route()->id))
+        return false;
+
+    // Delete items removed from the route
+    if (!m_itemsRepo->removeMissionItemsExcept(mission->route()->id, itemIds))
+        return false;
+
+    return transaction->commit();
+}
+
+bool MissionsService::deleteMission(Mission* mission)
+{
+    // Items go with the mission by ON DELETE CASCADE, all in one statement
+    if (!m_missionsRepo->remove(mission))
+        return false;
+
+    m_itemsRepo->forgetMissionItems(mission->route()->id);
+    return true;
+}
+
+QSharedPointer<Mission> MissionsService::snapshotMission(Mission* mission) const
+{
+    QSharedPointer<Mission> snapshot(new Mission(mission->type(), mission->toVariantMap()));
+    for (MissionRouteItem* item : mission->route()->items())
     {
-        m_itemsRepo->insert(item, parentId);
+        auto itemSnapshot = new MissionRouteItem(item->type(), item->toVariantMap());
+        snapshot->route()->addItem(itemSnapshot);
+        ::copyDirtyState(item, itemSnapshot);
     }
+    ::copyDirtyState(mission, snapshot.data());
+
+    // Without thread affinity it may be used and deleted in the persistence thread
+    snapshot->moveToThread(nullptr);
+    return snapshot;
 }
 
-void MissionsService::restoreItemImpl(MissionRouteItem* item)
+QSharedPointer<MissionRouteItem> MissionsService::snapshotItem(MissionRouteItem* item) const
 {
-    m_itemsRepo->read(item);
+    QSharedPointer<MissionRouteItem> snapshot(
+        new MissionRouteItem(item->type(), item->toVariantMap()));
+    ::copyDirtyState(item, snapshot.data());
+
+    snapshot->moveToThread(nullptr);
+    return snapshot;
 }
 
-void MissionsService::removeItems(const QVariantList& itemsIds)
+void MissionsService::enqueueWrite(const QString& key, const PersistenceQueue::Write& write,
+                                   const PersistenceQueue::Finished& written)
 {
-    for (const QVariant& itemId : itemsIds)
+    m_persistence->enqueue(key, write, [this, written](bool ok) {
+        QMetaObject::invokeMethod(
+            this,
+            [written, ok]() {
+                written(ok);
+            },
+            Qt::QueuedConnection);
+    });
+}
+
+void MissionsService::missionWritten(const QPointer<Mission>& mission, const Mission* written,
+                                     bool ok)
+{
+    if (!ok)
+    {
+        qWarning() << "Mission was not stored" << written->id();
+        return;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    if (!mission)
+        return;
+
+    ::markCleanIfWritten(mission, written);
+
+    QHash<QString, const MissionRouteItem*> writtenItems;
+    for (const MissionRouteItem* item : written->route()->items())
+    {
+        writtenItems.insert(item->id().toString(), item);
+    }
+    for (MissionRouteItem* item : mission->route()->items())
+    {
+        const MissionRouteItem* writtenItem = writtenItems.value(item->id().toString(), nullptr);
+        if (writtenItem)
+            ::markCleanIfWritten(item, writtenItem);
+    }
+}
+
+void MissionsService::itemWritten(const QPointer<MissionRouteItem>& item,
+                                  const MissionRouteItem* written, bool ok)
+{
+    if (!ok)
+    {
+        qWarning() << "Mission item was not stored" << written->id();
+        return;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    if (item)
+        ::markCleanIfWritten(item, written);
+}
+
+void MissionsService::afterWrites(const std::function<void()>& read)
+{
+    const QFuture<void> flush = m_persistence ? m_persistence->flush() : QFuture<void>();
+    if (!m_persistence || flush.isFinished())
     {
-        m_itemsRepo->removeById(itemId);
+        read();
+        return;
     }
+
+    // Caller's thread is not blocked, read comes from its event loop
+    auto watcher = new QFutureWatcher<void>(this);
+    connect(watcher, &QFutureWatcher<void>::finished, this, [watcher, read]() {
+        watcher->deleteLater();
+        read();
+    });
+    watcher->setFuture(flush);
+}
+
+bool MissionsService::isWritePending(const QVariant& id) const
+{
+    return m_persistence && m_persistence->isPending(id.toString());
 }
@@ -0,0 +1,98 @@
+#include "sql_change_refresh.h"
+
+#include <QSet>
+
+namespace
+{
+constexpr char vehicles[] = "vehicles";
+constexpr char missions[] = "missions";
+constexpr char missionItems[] = "mission_items";
+
+// Ids of changed rows, removed is set for deleted rows with unknown ids
+QVariantList changedIds(const QList<md::data_source::SqlChange>& changes, const QString& table,
+                        bool* removed)
+{
+    QVariantList ids;
+    QSet<QString> unique;
+    *removed = false;
+    for (const md::data_source::SqlChange& change : changes)
+    {
+        if (change.table != table)
+            continue;
+
+        if (change.id.isNull())
+            *removed = *removed || change.operation == md::data_source::SqlOperation::Delete;
+        else if (!unique.contains(change.id.toString()))
+        {
+            unique.insert(change.id.toString());
+            ids.append(change.id);
+        }
+    }
+    return ids;
+}
+
+// After removal of unknown rows every held entity is checked against the storage
+void appendHeld(QVariantList& ids, const QVariantList& heldIds)
+{
+    QSet<QString> unique;
+    for (const QVariant& id : qAsConst(ids))
+    {
+        unique.insert(id.toString());
+    }
+
+    for (const QVariant& id : heldIds)
+    {
+        if (!unique.contains(id.toString()))
+            ids.append(id);
+    }
+}
+} // namespace
+
+using namespace md::data_source;
+
+QMetaObject::Connection md::data_source::refreshOnChanges(SqlChangeFeed* feed,
+                                                          domain::IVehiclesService* service)
+{
+    return QObject::connect(
+        feed, &SqlChangeFeed::changed, service, [service](const QList<SqlChange>& changes) {
+            bool removed;
+            QVariantList vehicleIds = ::changedIds(changes, ::vehicles, &removed);
+            if (removed)
+                ::appendHeld(vehicleIds, service->vehicleIds());
+
+            if (!vehicleIds.isEmpty())
+                service->refreshVehicles(vehicleIds);
+        });
+}
+
+QMetaObject::Connection md::data_source::refreshOnChanges(SqlChangeFeed* feed,
+                                                          domain::IMissionsService* service)
+{
+    return QObject::connect(
+        feed, &SqlChangeFeed::changed, service, [service](const QList<SqlChange>& changes) {
+            bool removed;
+            QVariantList missionIds = ::changedIds(changes, ::missions, &removed);
+            if (removed)
+                ::appendHeld(missionIds, service->missionIds());
+
+            if (!missionIds.isEmpty())
+                service->refreshMissions(missionIds);
+
+            QVariantList itemIds = ::changedIds(changes, ::missionItems, &removed);
+            if (removed)
+            {
+                QVariantList heldIds;
+                for (domain::Mission* mission : service->missions())
+                {
+                    for (domain::MissionRouteItem* item : mission->route()->items())
+                    {
+                        heldIds.append(item->id());
+                    }
+                }
+                ::appendHeld(itemIds, heldIds);
+            }
+
+            if (!itemIds.isEmpty())
+                service->refreshItems(itemIds);
+        });
+}
@@ -0,0 +1,86 @@
+#include "sql_migrator.h"
+
+#include <QDebug>
+#include <QSqlError>
+#include <QSqlQuery>
+
+#include "sql_schema_catalog.h"
+#include "sql_transaction.h"
+
+using namespace md::data_source;
+
+SqlMigrator::SqlMigrator(const QSqlDatabase& database) : m_database(database)
+{
+}
+
+QStringList SqlMigrator::appliedVersions() const
+{
+    QSqlQuery query(m_database);
+    query.exec("SELECT version FROM schema_version");
+
+    QStringList versions;
+    while (query.next())
+    {
+        versions.append(query.value(0).toString());
+    }
+    return versions;
+}
+
+bool SqlMigrator::migrate(const QVector<SqlMigration>& migrations)
+{
+    QSqlQuery query(m_database);
+    if (!query.exec("CREATE TABLE IF NOT EXISTS schema_version (version STRING NOT NULL UNIQUE)"))
+    {
+        qWarning() << query.lastQuery() << query.lastError();
+        return false;
+    }
+
+    const QStringList applied = this->appliedVersions();
+    for (const SqlMigration& migration : migrations)
+    {
+        if (applied.contains(migration.version))
+            continue;
+
+        // Schema has changed or rolled back, cached column metadata is wrong either way
+        bool result = this->apply(migration);
+        SqlSchemaCatalog::invalidate(m_database);
+
+        if (!result)
+        {
+            qCritical() << "Migration" << migration.version << "failed";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SqlMigrator::apply(const SqlMigration& migration)
+{
+    // Migration is applied completely or not at all
+    SqlTransaction transaction(m_database);
+
+    QSqlQuery query(m_database);
+    for (const QString& statement : migration.statements)
+    {
+        if (!query.exec(statement))
+        {
+            qWarning() << query.lastQuery() << query.lastError();
+            return false;
+        }
+    }
+
+    // Step may use tables, let them see the new columns
+    SqlSchemaCatalog::invalidate(m_database);
+    if (migration.step && !migration.step(m_database))
+        return false;
+
+    query.prepare("INSERT INTO schema_version (version) VALUES (:version)");
+    query.bindValue(":version", migration.version);
+    if (!query.exec())
+    {
+        qWarning() << query.lastQuery() << query.lastError();
+        return false;
+    }
+
+    return transaction.commit();
+}
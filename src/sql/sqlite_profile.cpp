@@ -0,0 +1,21 @@
+#include "sqlite_profile.h"
+
+namespace
+{
+constexpr int busyTimeout = 5000;
+constexpr int defaultCacheSize = -2000;      // 2 MiB, SQLite default
+constexpr int fastCacheSize = -64000;        // 64 MiB
+constexpr qint64 fastMmapSize = 268435456;   // 256 MiB
+} // namespace
+
+using namespace md::data_source;
+
+SqliteProfile SqliteProfile::durable()
+{
+    return { "WAL", "FULL", 0, ::defaultCacheSize, "DEFAULT", ::busyTimeout };
+}
+
+SqliteProfile SqliteProfile::fast()
+{
+    return { "WAL", "NORMAL", ::fastMmapSize, ::fastCacheSize, "MEMORY", ::busyTimeout };
+}
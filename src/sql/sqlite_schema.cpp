@@ -1,19 +1,289 @@
 #include "sqlite_schema.h"
 
+#include <cmath>
+
+#include <QDebug>
+#include <QFile>
 #include <QSqlError>
 #include <QSqlQuery>
+#include <QUuid>
+
+#include <sqlite3.h>
+
+#include "entity_sql_table.h"
+#include "geo_traits.h"
+#include "sql_migrator.h"
+#include "sql_transaction.h"
+#include "sqlite_handle.h"
 
 namespace
 {
 constexpr char connectionType[] = "QSQLITE";
+// Writes through other connections restart the backup, then the rest is copied in one step
+constexpr int maxBackupRestarts = 3;
+
+// Database file used as the backup of the in-memory database
+sqlite3* openBackupFile(const QString& path, int busyTimeout)
+{
+    sqlite3* handle = nullptr;
+    if (sqlite3_open_v2(path.toUtf8().constData(), &handle,
+                        SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr) != SQLITE_OK)
+    {
+        qWarning() << "Can't open backup file" << path << sqlite3_errmsg(handle);
+        sqlite3_close(handle);
+        return nullptr;
+    }
+    sqlite3_busy_timeout(handle, busyTimeout);
+
+    // Copied pages keep the journal mode of the source, WAL can't be opened in memory
+    sqlite3_exec(handle, "PRAGMA journal_mode=DELETE", nullptr, nullptr, nullptr);
+    return handle;
+}
+
+QVariant coordinate(const QVariant& value)
+{
+    bool ok = false;
+    double number = value.toDouble(&ok);
+    return ok && !std::isnan(number) ? QVariant(number) : QVariant();
+}
+
+// Copy coordinates of the position JSON to the native columns
+bool fillItemCoordinates(QSqlDatabase& database)
+{
+    namespace geo = md::domain::geo;
+    namespace sql = md::data_source::sql;
+    md::data_source::EntitySqlTable items(&database, "mission_items", { "position" });
+
+    // Rows are addressed by rowid, ids may be not yet in the storage form of later migrations
+    for (const QVariant& rowid : items.selectOne({}, sql::rowid))
+    {
+        const QVariantMap position = items.selectByConditions({ { sql::rowid, rowid } })
+                                         .value(0)
+                                         .value("position")
+                                         .toMap();
+        if (position.isEmpty())
+            continue;
+
+        const QVariantMap coordinates = {
+            { geo::latitude, ::coordinate(position.value(geo::latitude)) },
+            { geo::longitude, ::coordinate(position.value(geo::longitude)) },
+            { geo::altitude, ::coordinate(position.value(geo::altitude)) }
+        };
+        if (!items.updateByCondition(coordinates, { sql::rowid, rowid }))
+            return false;
+    }
+    return true;
+}
+
+// Rewrite text UUIDs of every UUID column as 16 byte blobs
+bool encodeUuidColumns(QSqlDatabase& database)
+{
+    namespace sql = md::data_source::sql;
+
+    // Keys and references are rewritten one after another, check them on commit
+    QSqlQuery query(database);
+    if (!query.exec("PRAGMA defer_foreign_keys = ON"))
+    {
+        qWarning() << query.lastQuery() << query.lastError();
+        return false;
+    }
+
+    for (const QString& tableName : database.tables())
+    {
+        md::data_source::SqlTable table(&database, tableName);
+        const md::data_source::SqlTableInfoPtr info = table.tableInfo();
+
+        for (const QString& column : info->columnNames())
+        {
+            if (!info->isUuid(column))
+                continue;
+
+            // Only the canonical form is converted, other spellings would be rewritten as is
+            QList<QPair<QVariant, QVariant>> texts;
+            table.selectEach({}, { sql::rowid, column }, [&texts](const QSqlQuery& row) {
+                const QVariant value = row.value(1);
+                if (value.userType() == QMetaType::QString &&
+                    QUuid(value.toString()).toString() == value.toString())
+                    texts.append({ row.value(0), value });
+                return true;
+            });
+
+            for (const auto& text : qAsConst(texts))
+            {
+                // Bound value is encoded by the table
+                if (!table.updateByCondition({ { column, text.second } },
+                                             { sql::rowid, text.first }))
+                    return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Rewrite JSON text of the columns read as CBOR by the repositories
+bool encodeCborColumns(QSqlDatabase& database)
+{
+    namespace props = md::domain::props;
+    using md::data_source::EntitySqlTable;
+    using md::data_source::JsonEncoding;
+
+    EntitySqlTable vehicles(&database, "vehicles", { props::params }, JsonEncoding::Cbor);
+    EntitySqlTable items(&database, "mission_items", { props::params, props::position },
+                         JsonEncoding::Cbor);
+    return vehicles.migrateJsonEncoding() != -1 && items.migrateJsonEncoding() != -1;
+}
+
+const QStringList settingsPragmas = { "foreign_keys", "journal_mode", "synchronous", "mmap_size",
+                                      "cache_size",   "temp_store",   "busy_timeout" };
+
+// Append only, applied versions are stored in schema_version table
+const QVector<md::data_source::SqlMigration> migrations = {
+    { "17.14.00_09.11.2021",
+      { "CREATE TABLE vehicles ("
+        "id UUID PRIMARY KEY NOT NULL, "
+        "name STRING, "
+        "params TEXT, "
+        "type STRING);",
+        "CREATE TABLE missions ("
+        "id UUID PRIMARY KEY NOT NULL, "
+        "name STRING, "
+        "type STRING, "
+        "visible BOOL, "
+        "vehicle UUID, "
+        "FOREIGN KEY(vehicle) REFERENCES vehicles(id) ON DELETE CASCADE);",
+        "CREATE TABLE mission_items ("
+        "id UUID PRIMARY KEY NOT NULL, "
+        "name STRING, "
+        "params TEXT, "
+        "position TEXT, "
+        "type STRING, "
+        "mission UUID, "
+        "FOREIGN KEY(mission) REFERENCES missions(id) ON DELETE CASCADE);" } },
+    // Indexes for items of mission & mission for vehicle lookups. Items index is not covering on
+    // purpose: (mission, id) would return items in id order instead of the stored route order
+    { "10.30.00_17.10.2026",
+      { "CREATE INDEX IF NOT EXISTS mission_items_mission_idx ON mission_items (mission);",
+        "CREATE INDEX IF NOT EXISTS missions_vehicle_idx ON missions (vehicle, id);" } },
+    // Native item coordinates with R*Tree over them, triggers keep the tree in sync on every
+    // write including cascade deletes. Tree id is the rowid of the mission item
+    { "11.00.00_17.10.2026",
+      { "ALTER TABLE mission_items ADD COLUMN latitude REAL;",
+        "ALTER TABLE mission_items ADD COLUMN longitude REAL;",
+        "ALTER TABLE mission_items ADD COLUMN altitude REAL;",
+        "CREATE VIRTUAL TABLE mission_items_rtree USING rtree("
+        "id, min_latitude, max_latitude, min_longitude, max_longitude);",
+        "CREATE TRIGGER mission_items_rtree_insert AFTER INSERT ON mission_items "
+        "WHEN new.latitude IS NOT NULL AND new.longitude IS NOT NULL BEGIN "
+        "INSERT INTO mission_items_rtree VALUES "
+        "(new.rowid, new.latitude, new.latitude, new.longitude, new.longitude); END;",
+        "CREATE TRIGGER mission_items_rtree_update AFTER UPDATE OF latitude, longitude "
+        "ON mission_items BEGIN "
+        "DELETE FROM mission_items_rtree WHERE id = old.rowid; "
+        "INSERT INTO mission_items_rtree SELECT "
+        "new.rowid, new.latitude, new.latitude, new.longitude, new.longitude "
+        "WHERE new.latitude IS NOT NULL AND new.longitude IS NOT NULL; END;",
+        "CREATE TRIGGER mission_items_rtree_delete AFTER DELETE ON mission_items BEGIN "
+        "DELETE FROM mission_items_rtree WHERE id = old.rowid; END;" },
+      ::fillItemCoordinates },
+    // Ids & references stored as 16 byte blobs instead of 38 characters of braced UUID text
+    { "12.00.00_17.10.2026", {}, ::encodeUuidColumns },
+    // Params & positions stored as CBOR, still readable as JSON text until converted
+    { "13.00.00_17.10.2026", {}, ::encodeCborColumns },
+    // Implicit rowid of items may be renumbered by VACUUM, INTEGER PRIMARY KEY alias keeps it
+    // for the tree, the change feed & the route order. Table is rebuilt, id stays unique
+    { "14.00.00_17.10.2026",
+      { "CREATE TABLE mission_items_rebuilt ("
+        "item_key INTEGER PRIMARY KEY, "
+        "id UUID UNIQUE NOT NULL, "
+        "name STRING, "
+        "params TEXT, "
+        "position TEXT, "
+        "type STRING, "
+        "mission UUID, "
+        "latitude REAL, "
+        "longitude REAL, "
+        "altitude REAL, "
+        "FOREIGN KEY(mission) REFERENCES missions(id) ON DELETE CASCADE);",
+        "INSERT INTO mission_items_rebuilt (item_key, id, name, params, position, type, mission, "
+        "latitude, longitude, altitude) SELECT rowid, id, name, params, position, type, mission, "
+        "latitude, longitude, altitude FROM mission_items ORDER BY rowid;",
+        "DROP TABLE mission_items;",
+        "ALTER TABLE mission_items_rebuilt RENAME TO mission_items;",
+        "CREATE INDEX mission_items_mission_idx ON mission_items (mission);",
+        "DROP TABLE mission_items_rtree;",
+        "CREATE VIRTUAL TABLE mission_items_rtree USING rtree("
+        "id, min_latitude, max_latitude, min_longitude, max_longitude);",
+        "INSERT INTO mission_items_rtree SELECT item_key, latitude, latitude, longitude, longitude "
+        "FROM mission_items WHERE latitude IS NOT NULL AND longitude IS NOT NULL;",
+        "CREATE TRIGGER mission_items_rtree_insert AFTER INSERT ON mission_items "
+        "WHEN new.latitude IS NOT NULL AND new.longitude IS NOT NULL BEGIN "
+        "INSERT INTO mission_items_rtree VALUES "
+        "(new.item_key, new.latitude, new.latitude, new.longitude, new.longitude); END;",
+        "CREATE TRIGGER mission_items_rtree_update AFTER UPDATE OF latitude, longitude "
+        "ON mission_items BEGIN "
+        "DELETE FROM mission_items_rtree WHERE id = old.item_key; "
+        "INSERT INTO mission_items_rtree SELECT "
+        "new.item_key, new.latitude, new.latitude, new.longitude, new.longitude "
+        "WHERE new.latitude IS NOT NULL AND new.longitude IS NOT NULL; END;",
+        "CREATE TRIGGER mission_items_rtree_delete AFTER DELETE ON mission_items BEGIN "
+        "DELETE FROM mission_items_rtree WHERE id = old.item_key; END;" } },
+};
 } // namespace
 
 using namespace md::data_source;
 
-SqliteSchema::SqliteSchema(const QString& databaseName) :
-    m_db(QSqlDatabase::addDatabase(::connectionType))
+SqliteSchema::SqliteSchema(const QString& databaseName, const SqliteProfile& profile) :
+    m_db(QSqlDatabase::addDatabase(::connectionType)),
+    m_profile(profile),
+    m_changeFeed(m_db),
+    m_pool(m_db, [this](QSqlDatabase& database) {
+        this->applyProfile(database);
+        m_changeFeed.attach(database);
+    }),
+    m_catalog(m_db)
 {
     m_db.setDatabaseName(databaseName);
+    m_clock.start();
+}
+
+SqliteSchema::SqliteSchema(const QString& databaseName, const SqliteProfile& profile,
+                           const SqliteMemoryMode& memoryMode) :
+    SqliteSchema(databaseName, profile)
+{
+    m_filePath = databaseName;
+    m_memoryMode = memoryMode;
+
+    // Named memdb database is shared by all connections of the pool, unlike :memory:
+    m_db.setDatabaseName("file:/kjarni_" + QUuid::createUuid().toString(QUuid::WithoutBraces) +
+                         "?vfs=memdb");
+    m_db.setConnectOptions("QSQLITE_OPEN_URI");
+
+    QObject::connect(&m_changeFeed, &SqlChangeFeed::changed, &m_changeFeed,
+                     [this](const QList<SqlChange>& changes) {
+                         m_rowsChanged += changes.count();
+                     });
+
+    m_backupTimer.setInterval(memoryMode.backupIntervalMs);
+    QObject::connect(&m_backupTimer, &QTimer::timeout, [this]() {
+        this->startBackup();
+        if (m_backup)
+            m_stepTimer.start();
+    });
+    // Steps are spread over event loop iterations, so writers get in between
+    m_stepTimer.setInterval(0);
+    QObject::connect(&m_stepTimer, &QTimer::timeout, [this]() {
+        this->stepBackup();
+    });
+}
+
+SqliteSchema::~SqliteSchema()
+{
+    if (!m_memoryMode)
+        return;
+
+    m_backupTimer.stop();
+    m_stepTimer.stop();
+    this->backup();
 }
 
 QSqlDatabase* SqliteSchema::db()
@@ -21,50 +291,213 @@ QSqlDatabase* SqliteSchema::db()
     return &m_db;
 }
 
+md::domain::TransactionPtr SqliteSchema::transaction()
+{
+    return domain::TransactionPtr(new SqlTransaction(m_pool.connection()));
+}
+
 void SqliteSchema::setup()
 {
     if (!m_db.open())
     {
         qCritical("Can't open database");
     }
+    this->applyProfile(m_db);
+
+    if (m_memoryMode && !this->restore())
+    {
+        qCritical("Can't restore database from file");
+    }
+
+    SqlMigrator migrator(m_db);
+    if (!migrator.migrate(::migrations))
+    {
+        qCritical("Can't migrate database");
+    }
+
+    // Migrations are not published
+    m_changeFeed.attach(m_db);
+
+    if (m_memoryMode && m_memoryMode->backupIntervalMs > 0)
+        m_backupTimer.start();
+}
 
-    // TODO: replace with some migrations framework
-    QSqlQuery query;
-    query.exec("SELECT version FROM schema_version ORDER BY version DESC LIMIT 1");
-    if (query.next())
+const SqliteProfile& SqliteSchema::profile() const
+{
+    return m_profile;
+}
+
+QVariantMap SqliteSchema::activeSettings()
+{
+    QVariantMap settings;
+    QSqlQuery query(m_pool.connection());
+    for (const QString& pragma : ::settingsPragmas)
     {
-        // Already have schema
+        if (query.exec("PRAGMA " + pragma) && query.next())
+            settings.insert(pragma, query.value(0));
+    }
+    return settings;
+}
+
+QSqlDatabase SqliteSchema::connection()
+{
+    return m_pool.connection();
+}
+
+SqlConnectionPool* SqliteSchema::pool()
+{
+    return &m_pool;
+}
+
+SqlChangeFeed* SqliteSchema::changeFeed()
+{
+    return &m_changeFeed;
+}
+
+SqlSchemaCatalog* SqliteSchema::catalog()
+{
+    return &m_catalog;
+}
+
+void SqliteSchema::applyProfile(QSqlDatabase& database)
+{
+    // Foreign keys are connection state too, not a part of the schema
+    const QStringList pragmas = {
+        "PRAGMA foreign_keys=ON",
+        "PRAGMA journal_mode=" + m_profile.journalMode,
+        "PRAGMA synchronous=" + m_profile.synchronous,
+        "PRAGMA mmap_size=" + QString::number(m_profile.mmapSize),
+        "PRAGMA cache_size=" + QString::number(m_profile.cacheSize),
+        "PRAGMA temp_store=" + m_profile.tempStore,
+        "PRAGMA busy_timeout=" + QString::number(m_profile.busyTimeout),
+    };
+
+    QSqlQuery query(database);
+    for (const QString& pragma : pragmas)
+    {
+        if (!query.exec(pragma))
+            qWarning() << query.lastQuery() << query.lastError();
+    }
+}
+
+bool SqliteSchema::isInMemory() const
+{
+    return m_memoryMode.has_value();
+}
+
+bool SqliteSchema::backup()
+{
+    if (!m_memoryMode || !m_db.isOpen())
+        return false;
+
+    // Periodic backup in progress is completed at once
+    m_stepTimer.stop();
+    this->startBackup();
+    if (!m_backup)
+        return false;
+
+    m_backup->step(-1);
+    return this->finishBackup();
+}
+
+SqliteBackupStats SqliteSchema::backupStats() const
+{
+    SqliteBackupStats stats = m_backupStats;
+    stats.rowsAtRisk = m_rowsChanged - m_rowsBackedUp;
+    stats.msAtRisk = m_clock.elapsed() - m_lastGoodBackupMs;
+    return stats;
+}
+
+bool SqliteSchema::restore()
+{
+    m_lastGoodBackupMs = m_clock.elapsed();
+    if (!QFile::exists(m_filePath))
+        return true;
+
+    sqlite3* file = ::openBackupFile(m_filePath, m_profile.busyTimeout);
+    if (!file)
+        return false;
+
+    bool result;
+    {
+        SqliteBackup restore(file, sql::sqliteHandle(m_db));
+        restore.step(-1);
+        result = restore.finish();
+        if (!result)
+            qWarning() << "Can't restore database from" << m_filePath << restore.errorString();
+    }
+    sqlite3_close(file);
+    return result;
+}
+
+void SqliteSchema::startBackup()
+{
+    if (m_backup)
         return;
+
+    m_backupFile = ::openBackupFile(m_filePath, m_profile.busyTimeout);
+    if (!m_backupFile)
+    {
+        m_backupStats.failures++;
+        return;
+    }
+
+    m_backup.reset(new SqliteBackup(sql::sqliteHandle(m_db), m_backupFile));
+    m_backupRemaining = 0;
+    m_backupRestarts = 0;
+    m_rowsAtBackupStart = m_rowsChanged;
+    m_backupStartMs = m_clock.elapsed();
+}
+
+void SqliteSchema::stepBackup()
+{
+    if (!m_backup)
+    {
+        m_stepTimer.stop();
+        return;
+    }
+
+    const int pages =
+        m_backupRestarts < ::maxBackupRestarts ? m_memoryMode->pagesPerStep : -1;
+    const bool result = m_backup->step(pages);
+
+    // More pages left than before the step means the copy started over
+    if (m_backup->remaining() > m_backupRemaining && m_backupRemaining > 0)
+        m_backupRestarts++;
+    m_backupRemaining = m_backup->remaining();
+
+    if (!result || m_backup->isDone())
+    {
+        m_stepTimer.stop();
+        this->finishBackup();
+    }
+}
+
+bool SqliteSchema::finishBackup()
+{
+    const bool result = m_backup->finish();
+    if (result)
+    {
+        QSqlQuery query(m_db);
+        const qint64 pageSize = query.exec("PRAGMA page_size") && query.next()
+                                    ? query.value(0).toLongLong()
+                                    : 0;
+
+        m_backupStats.backups++;
+        m_backupStats.lastDurationMs = m_backup->elapsedMs();
+        m_backupStats.lastBytes = m_backup->pageCount() * pageSize;
+        m_backupStats.lastBackupTime = QDateTime::currentDateTime();
+        m_rowsBackedUp = m_rowsAtBackupStart;
+        m_lastGoodBackupMs = m_backupStartMs;
+    }
+    else
+    {
+        m_backupStats.failures++;
+        qWarning() << "Can't back up database to" << m_filePath << m_backup->errorString();
     }
 
-    query.exec("PRAGMA FOREIGN_KEYS=ON;");
-
-    query.exec("CREATE TABLE schema_version (version STRING NOT NULL UNIQUE)");
-
-    // Vehicles
-    query.exec("CREATE TABLE vehicles ("
-               "id UUID PRIMARY KEY NOT NULL, "
-               "name STRING, "
-               "params TEXT, "
-               "type STRING);");
-
-    // Missions
-    query.exec("CREATE TABLE missions ("
-               "id UUID PRIMARY KEY NOT NULL, "
-               "name STRING, "
-               "type STRING, "
-               "visible BOOL, "
-               "vehicle UUID, "
-               "FOREIGN KEY(vehicle) REFERENCES vehicles(id) ON DELETE CASCADE);");
-
-    query.exec("CREATE TABLE mission_items ("
-               "id UUID PRIMARY KEY NOT NULL, "
-               "name STRING, "
-               "params TEXT, "
-               "position TEXT, "
-               "type STRING, "
-               "mission UUID, "
-               "FOREIGN KEY(mission) REFERENCES missions(id) ON DELETE CASCADE);");
-
-    query.exec("INSERT INTO schema_version (version) VALUES (\'17.14.00_09.11.2021\')");
+    m_backup.reset();
+    sqlite3_close(m_backupFile);
+    m_backupFile = nullptr;
+    return result;
 }
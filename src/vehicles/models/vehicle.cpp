@@ -12,7 +12,7 @@ Vehicle::Vehicle(const VehicleType* type, const QString& name, const QVariant& i
     ParametrisedMixin<NamedMixin<Entity>>(parameters, std::bind(&Entity::changed, this), name,
                                                id, parent),
     type(type),
-    online(false, std::bind(&Entity::changed, this))
+    online(false, this->notifier(props::online))
 {
     Q_ASSERT(type);
 }
@@ -23,13 +23,11 @@ Vehicle::Vehicle(const VehicleType* type, const QVariantMap& map, QObject* paren
 {
 }
 
-QVariantMap Vehicle::toVariantMap() const
+void Vehicle::serialize(IEntitySink& sink) const
 {
-    QVariantMap map = ParametrisedMixin<NamedMixin<Entity>>::toVariantMap();
-    map.insert(props::type, this->type()->id);
-    map.insert(props::online, this->online());
-    map.insert(props::icon, this->type()->icon);
-    map.insert(props::model, this->type()->model);
-
-    return map;
+    ParametrisedMixin<NamedMixin<Entity>>::serialize(sink);
+    sink.writeString(props::type, this->type()->id);
+    sink.writeBool(props::online, this->online());
+    sink.writeString(props::icon, this->type()->icon);
+    sink.writeString(props::model, this->type()->model);
 }
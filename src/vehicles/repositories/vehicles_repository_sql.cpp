@@ -4,25 +4,32 @@
 
 namespace
 {
-constexpr char vehicles[] = "vehicles";
+constexpr int cachedVehicles = 256;
 } // namespace
 
 using namespace md::data_source;
 
 VehiclesRepositorySql::VehiclesRepositorySql(QSqlDatabase* database) :
     IVehiclesRepository(),
-    m_vehiclesTable(database, ::vehicles, { domain::props::params })
+    m_vehiclesTable(database, JsonEncoding::Cbor)
 {
+    m_vehiclesTable.setCacheCapacity(::cachedVehicles);
 }
 
 QVariantList VehiclesRepositorySql::selectVehicleIds()
 {
-    return m_vehiclesTable.selectIds();
+    return m_vehiclesTable.selectOne({}, domain::props::id);
 }
 
 QVariantMap VehiclesRepositorySql::select(const QVariant& vehicleId)
 {
-    return m_vehiclesTable.selectById(vehicleId);
+    const std::optional<VehicleRow> row = m_vehiclesTable.selectRow(vehicleId);
+    return row ? VehiclesSqlTable::toVariantMap(*row) : QVariantMap();
+}
+
+md::domain::Page VehiclesRepositorySql::selectPage(const domain::PageRequest& request)
+{
+    return m_vehiclesTable.selectPage({}, request);
 }
 
 void VehiclesRepositorySql::insert(domain::Vehicle* vehicle)
@@ -109,6 +109,37 @@ void VehiclesService::removeVehicleType(const VehicleType* type)
     emit vehicleTypesChanged();
 }
 
+void VehiclesService::refreshVehicles(const QVariantList& vehicleIds)
+{
+    QMutexLocker locker(&m_mutex);
+
+    for (const QVariant& vehicleId : vehicleIds)
+    {
+        Vehicle* vehicle = m_vehicles.value(vehicleId, nullptr);
+        const QVariantMap map = m_vehiclesRepo->select(vehicleId);
+        if (map.isEmpty())
+        {
+            if (!vehicle)
+                continue;
+
+            m_vehicles.remove(vehicleId);
+            emit vehicleRemoved(vehicle);
+            vehicle->deleteLater();
+        }
+        else if (!vehicle)
+        {
+            this->readVehicle(vehicleId);
+        }
+        // Unsaved changes are kept, unchanged vehicles are not reported
+        else if (!vehicle->isDirty() && vehicle->differs(map))
+        {
+            vehicle->fromVariantMap(map);
+            vehicle->markClean();
+            emit vehicleChanged(vehicle);
+        }
+    }
+}
+
 Vehicle* VehiclesService::readVehicle(const QVariant& id)
 {
     QVariantMap select = m_vehiclesRepo->select(id);
@@ -121,6 +152,7 @@ Vehicle* VehiclesService::readVehicle(const QVariant& id)
     }
 
     Vehicle* vehicle = new Vehicle(type, select, this);
+    vehicle->markClean();
 
     m_vehicles.insert(id, vehicle);
     emit vehicleAdded(vehicle);
@@ -1,7 +1,12 @@
 #include <gtest/gtest.h>
 
+#include <QCoreApplication>
+
 int main(int argc, char** argv)
 {
+    // Required for loading SQL driver plugins
+    QCoreApplication app(argc, argv);
+
     testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
 }
@@ -0,0 +1,124 @@
+#include <gtest/gtest.h>
+
+#include <QCborValue>
+
+#include "dated_mixin.hpp"
+#include "entity_serializer.h"
+#include "mission_route_item.h"
+#include "sql_row_sink.h"
+#include "test_mission_traits.h"
+
+using namespace md::domain;
+
+namespace
+{
+MissionRouteItem* createItem(const QVariant& id)
+{
+    return new MissionRouteItem(&test_mission::circle, "CRL 1", id,
+                                { { test_mission::radius.id, 650 } },
+                                Geodetic(54.196783, -23.59275, 550));
+}
+} // namespace
+
+TEST(EntitySerializerTest, testVariantMapAdapter)
+{
+    QScopedPointer<MissionRouteItem> item(::createItem("item"));
+
+    VariantMapSink sink;
+    item->serialize(sink);
+    EXPECT_EQ(sink.map(), item->toVariantMap());
+    EXPECT_EQ(sink.map().value(props::params).toMap().value(test_mission::radius.id), 650);
+}
+
+TEST(EntitySerializerTest, testJsonRoundTrip)
+{
+    QScopedPointer<MissionRouteItem> item(::createItem("item"));
+    JsonEntitySink sink;
+    item->serialize(sink);
+
+    EXPECT_EQ(sink.object().value(props::name).toString(), "CRL 1");
+    EXPECT_TRUE(sink.object().value(props::position).isObject());
+
+    QScopedPointer<MissionRouteItem> other(
+        new MissionRouteItem(&test_mission::circle, "CRL 2", "item"));
+    other->deserialize(JsonEntitySource(sink.object()));
+
+    EXPECT_EQ(other->name(), "CRL 1");
+    EXPECT_EQ(other->position(), item->position());
+    EXPECT_EQ(other->parameter(test_mission::radius.id)->value().toInt(), 650);
+}
+
+TEST(EntitySerializerTest, testCborRoundTrip)
+{
+    const QDateTime createdAt = QDateTime::currentDateTime().addDays(-1);
+    DatedMixin<NamedMixin<Entity>> entity(createdAt, createdAt.addSecs(60), "Name", "id");
+
+    CborEntitySink sink;
+    entity.serialize(sink);
+    const QByteArray data = sink.finish();
+
+    DatedMixin<NamedMixin<Entity>> other(createdAt, createdAt, "Other", "id");
+    other.deserialize(CborEntitySource(data));
+
+    EXPECT_EQ(other.name(), "Name");
+    EXPECT_EQ(other.updatedAt(), entity.updatedAt());
+}
+
+TEST(EntitySerializerTest, testNestedObjectsStreamed)
+{
+    QScopedPointer<MissionRouteItem> item(::createItem("item"));
+    CborEntitySink sink;
+    item->serialize(sink);
+
+    // Position and params are nested maps of the same stream
+    const QCborMap map = QCborValue::fromCbor(sink.finish()).toMap();
+    EXPECT_DOUBLE_EQ(map.value(props::position).toMap().value(geo::latitude).toDouble(),
+                     item->position().latitude());
+    EXPECT_EQ(map.value(props::params).toMap().value(test_mission::radius.id).toInteger(), 650);
+
+    QScopedPointer<MissionRouteItem> other(
+        new MissionRouteItem(&test_mission::circle, "CRL 2", "item"));
+    const CborEntitySource source(sink.finish());
+    other->deserialize(source);
+
+    EXPECT_EQ(other->position(), item->position());
+    EXPECT_EQ(other->parameter(test_mission::radius.id)->value().toInt(), 650);
+}
+
+TEST(EntitySerializerTest, testSourceOwnsTemporary)
+{
+    const JsonEntitySource json(QJsonObject{ { props::name, "Json" } });
+    const VariantMapSource variant(QVariantMap{ { props::name, "Map" } });
+
+    QString name;
+    EXPECT_TRUE(json.readString(props::name, name));
+    EXPECT_EQ(name, "Json");
+    EXPECT_TRUE(variant.readString(props::name, name));
+    EXPECT_EQ(name, "Map");
+}
+
+TEST(EntitySerializerTest, testMissingFieldsKept)
+{
+    QScopedPointer<MissionRouteItem> item(::createItem("item"));
+    const Geodetic position = item->position();
+
+    item->deserialize(VariantMapSource({ { props::name, "Renamed" } }));
+
+    EXPECT_EQ(item->name(), "Renamed");
+    EXPECT_EQ(item->position(), position);
+}
+
+TEST(EntitySerializerTest, testSqlRowSink)
+{
+    using namespace md::data_source;
+
+    QScopedPointer<MissionRouteItem> item(::createItem("item"));
+    SqlRowSink sink({ props::id, props::params, props::type }, { props::params },
+                    JsonEncoding::Cbor);
+    item->serialize(sink);
+
+    // Only the columns, JSON properties encoded
+    EXPECT_EQ(sink.row().keys(), QStringList({ props::id, props::params, props::type }));
+    EXPECT_EQ(sql::decodeJson(sink.row().value(props::params)),
+              item->toVariantMap().value(props::params).toMap());
+}
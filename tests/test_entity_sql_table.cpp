@@ -0,0 +1,205 @@
+#include <gtest/gtest.h>
+
+#include <QSqlQuery>
+#include <QTemporaryDir>
+#include <QUuid>
+
+#include "entity_sql_table.h"
+#include "sqlite_schema.h"
+#include "vehicle.h"
+#include "vehicle_traits.h"
+
+using namespace md::data_source;
+using namespace md::domain;
+
+namespace
+{
+constexpr char vehicles[] = "vehicles";
+
+QByteArray storedParams(QSqlDatabase* db, const QVariant& id)
+{
+    QSqlQuery query(*db);
+    query.prepare("SELECT params FROM vehicles WHERE id = ?");
+    query.addBindValue(sql::toUuidBlob(id));
+    query.exec();
+    return query.next() ? query.value(0).toByteArray() : QByteArray();
+}
+} // namespace
+
+class EntitySqlTableTest : public ::testing::Test
+{
+public:
+    QTemporaryDir dir;
+    QVariantMap params = { { "mav_id", 23 }, { "speed", 12.5 }, { "name", "MAV" } };
+};
+
+TEST_F(EntitySqlTableTest, testCborRoundTrip)
+{
+    SqliteSchema schema(dir.filePath("cbor.db"));
+    schema.setup();
+
+    EntitySqlTable table(schema.db(), ::vehicles, { props::params }, JsonEncoding::Cbor);
+    Vehicle vehicle(&vehicle::generic, "MAV 23", md::utils::generateId(), params);
+    table.insertEntity(&vehicle);
+
+    EXPECT_FALSE(::storedParams(schema.db(), vehicle.id).startsWith('{'));
+
+    Vehicle read(&vehicle::generic, QString(), vehicle.id);
+    table.readEntity(&read);
+    EXPECT_EQ(read.parameters(), params);
+}
+
+TEST_F(EntitySqlTableTest, testMigrateTextToCbor)
+{
+    SqliteSchema schema(dir.filePath("migrate.db"));
+    schema.setup();
+
+    Vehicle vehicle(&vehicle::generic, "MAV 23", md::utils::generateId(), params);
+    EntitySqlTable(schema.db(), ::vehicles, { props::params }).insertEntity(&vehicle);
+    EXPECT_TRUE(::storedParams(schema.db(), vehicle.id).startsWith('{'));
+
+    EntitySqlTable table(schema.db(), ::vehicles, { props::params }, JsonEncoding::Cbor);
+
+    // Legacy rows are readable before migration
+    EXPECT_EQ(table.selectById(vehicle.id).value(props::params).toMap(), params);
+
+    EXPECT_EQ(table.migrateJsonEncoding(), 1);
+    EXPECT_EQ(table.migrateJsonEncoding(), 0);
+    EXPECT_FALSE(::storedParams(schema.db(), vehicle.id).startsWith('{'));
+    EXPECT_EQ(table.selectById(vehicle.id).value(props::params).toMap(), params);
+}
+
+TEST_F(EntitySqlTableTest, testUpdateWritesDirtyColumns)
+{
+    SqliteSchema schema(dir.filePath("dirty.db"));
+    schema.setup();
+
+    EntitySqlTable table(schema.db(), ::vehicles, { props::params }, JsonEncoding::Cbor);
+    Vehicle vehicle(&vehicle::generic, "MAV 23", md::utils::generateId(), params);
+    table.insertEntity(&vehicle);
+    EXPECT_FALSE(vehicle.isDirty());
+
+    // Changed aside, must survive update of the other columns
+    QSqlQuery query(*schema.db());
+    query.prepare("UPDATE vehicles SET params = NULL WHERE id = ?");
+    query.addBindValue(sql::toUuidBlob(vehicle.id()));
+    ASSERT_TRUE(query.exec());
+
+    // Not a column, nothing to write
+    vehicle.online = true;
+    EXPECT_TRUE(table.dirtyColumns(&vehicle).isEmpty());
+    table.updateEntity(&vehicle);
+    EXPECT_FALSE(vehicle.isDirty());
+
+    vehicle.name = "MAV 24";
+    EXPECT_EQ(table.dirtyColumns(&vehicle), QStringList({ props::name }));
+    table.updateEntity(&vehicle);
+
+    const QVariantMap stored = table.selectById(vehicle.id);
+    EXPECT_EQ(stored.value(props::name).toString(), "MAV 24");
+    EXPECT_TRUE(stored.value(props::params).toMap().isEmpty());
+}
+
+TEST_F(EntitySqlTableTest, testIdsReadBackUnchanged)
+{
+    SqliteSchema schema(dir.filePath("uuid.db"));
+    schema.setup();
+
+    // Only the canonical form is stored as a blob
+    const QString canonical = QUuid::createUuid().toString();
+    EXPECT_EQ(sql::toUuidBlob(canonical).toByteArray().size(), 16);
+    EXPECT_EQ(sql::toUuidBlob(canonical.toUpper()), canonical.toUpper());
+
+    EntitySqlTable table(schema.db(), ::vehicles, { props::params }, JsonEncoding::Cbor);
+    const QStringList ids = { canonical, QUuid::createUuid().toString().toUpper(),
+                              QUuid::createUuid().toString(QUuid::WithoutBraces) };
+    for (const QString& id : ids)
+    {
+        Vehicle vehicle(&vehicle::generic, "MAV", id, params);
+        ASSERT_TRUE(table.insertEntity(&vehicle));
+        EXPECT_EQ(table.selectById(id).value(props::id).toString(), id);
+    }
+}
+
+TEST_F(EntitySqlTableTest, testSelectByIds)
+{
+    SqliteSchema schema(dir.filePath("ids.db"));
+    schema.setup();
+
+    EntitySqlTable table(schema.db(), ::vehicles, { props::params }, JsonEncoding::Cbor);
+    QVariantList ids;
+    for (int i = 0; i < 3; ++i)
+    {
+        Vehicle vehicle(&vehicle::generic, QString("MAV %1").arg(i), md::utils::generateId(),
+                        params);
+        table.insertEntity(&vehicle);
+        ids.append(vehicle.id());
+    }
+
+    // Order of ids is kept, missing ids are skipped
+    const QList<QVariantMap> rows = table.selectByIds({ ids[2], "missing", ids[0] });
+    ASSERT_EQ(rows.count(), 2);
+    EXPECT_EQ(rows[0].value(props::name).toString(), "MAV 2");
+    EXPECT_EQ(rows[1].value(props::name).toString(), "MAV 0");
+    EXPECT_EQ(rows[1].value(props::params).toMap(), params);
+}
+
+TEST_F(EntitySqlTableTest, testUuidStoredAsBlob)
+{
+    SqliteSchema schema(dir.filePath("uuid.db"));
+    schema.setup();
+
+    EntitySqlTable table(schema.db(), ::vehicles, { props::params });
+    Vehicle vehicle(&vehicle::generic, "MAV 23", md::utils::generateId(), params);
+    table.insertEntity(&vehicle);
+
+    QSqlQuery query(*schema.db());
+    ASSERT_TRUE(query.exec("SELECT typeof(id), length(id) FROM vehicles"));
+    ASSERT_TRUE(query.next());
+    EXPECT_EQ(query.value(0).toString(), "blob");
+    EXPECT_EQ(query.value(1).toInt(), 16);
+
+    // String form at the API edge
+    EXPECT_EQ(table.selectIds(), QVariantList({ vehicle.id() }));
+    EXPECT_EQ(table.selectById(vehicle.id).value(props::name).toString(), "MAV 23");
+    EXPECT_EQ(table.selectByIds({ vehicle.id() }).count(), 1);
+}
+
+TEST_F(EntitySqlTableTest, testRowCache)
+{
+    SqliteSchema schema(dir.filePath("cache.db"));
+    schema.setup();
+
+    EntitySqlTable table(schema.db(), ::vehicles, { props::params }, JsonEncoding::Cbor);
+    table.setCacheCapacity(2);
+    QList<Vehicle*> vehicles;
+    for (int i = 0; i < 3; ++i)
+    {
+        vehicles.append(new Vehicle(&vehicle::generic, QString("MAV %1").arg(i),
+                                    md::utils::generateId(), params));
+        table.insertEntity(vehicles.last());
+    }
+    Vehicle* vehicle = vehicles.first();
+
+    EXPECT_EQ(table.selectById(vehicle->id).value(props::name).toString(), "MAV 0");
+    EXPECT_EQ(table.selectById(vehicle->id).value(props::params).toMap(), params);
+    EXPECT_EQ(table.cacheStats().misses, 1);
+    EXPECT_EQ(table.cacheStats().hits, 1);
+
+    // Local writes invalidate the row
+    vehicle->name = "MAV 23";
+    table.updateEntity(vehicle);
+    EXPECT_EQ(table.selectById(vehicle->id).value(props::name).toString(), "MAV 23");
+    EXPECT_EQ(table.cacheStats().misses, 2);
+
+    // Least recently used row is evicted
+    table.selectByIds({ vehicles[1]->id(), vehicles[2]->id() });
+    table.readEntity(vehicle);
+    EXPECT_EQ(table.cacheStats().hits, 1);
+    EXPECT_EQ(table.cacheStats().misses, 5);
+
+    table.removeByCondition({ props::name, "MAV 23" });
+    EXPECT_TRUE(table.selectById(vehicle->id).isEmpty());
+
+    qDeleteAll(vehicles);
+}
@@ -0,0 +1,209 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+#include <QSqlQuery>
+#include <QTemporaryDir>
+#include <QThread>
+#include <QUuid>
+
+#include "mission_items_repository_sql.h"
+#include "missions_repository_sql.h"
+#include "sqlite_schema.h"
+#include "test_mission_traits.h"
+
+using namespace md::data_source;
+using namespace md::domain;
+
+namespace
+{
+constexpr char missionId[] = "mission";
+
+QVariantList sorted(QVariantList list)
+{
+    std::sort(list.begin(), list.end(), [](const QVariant& first, const QVariant& second) {
+        return first.toString() < second.toString();
+    });
+    return list;
+}
+} // namespace
+
+class MissionItemsRepositoryTest : public ::testing::Test
+{
+public:
+    QTemporaryDir dir;
+    SqliteSchema schema;
+
+    MissionItemsRepositoryTest() : schema(dir.filePath("items.db"))
+    {
+        schema.setup();
+
+        QSqlQuery query(*schema.db());
+        query.exec(QString("INSERT INTO missions (id) VALUES ('%1')").arg(::missionId));
+    }
+};
+
+TEST_F(MissionItemsRepositoryTest, testSelectItemsInRect)
+{
+    MissionItemsRepositorySql repository(schema.db());
+
+    MissionRouteItem moscow(&test_mission::waypoint, "WPT 1", "moscow", {},
+                            Geodetic(55.75, 37.61, 150));
+    MissionRouteItem berlin(&test_mission::waypoint, "WPT 2", "berlin", {},
+                            Geodetic(52.52, 13.40, 50));
+    MissionRouteItem fiji(&test_mission::waypoint, "WPT 3", "fiji", {},
+                          Geodetic(-17.71, 178.06, 10));
+    MissionRouteItem photo(&test_mission::takePhoto, "PHOTO", "photo");
+    repository.insertItems({ &moscow, &berlin, &fiji, &photo }, ::missionId);
+
+    const GeodeticRect europe(Geodetic(60, 10, 0), Geodetic(50, 40, 0));
+    EXPECT_EQ(::sorted(repository.selectItemIdsInRect(europe)),
+              QVariantList({ "berlin", "moscow" }));
+
+    // Crossing the antimeridian
+    const GeodeticRect pacific(Geodetic(0, 170, 0), Geodetic(-30, -170, 0));
+    EXPECT_EQ(repository.selectItemIdsInRect(pacific), QVariantList({ "fiji" }));
+
+    // Index follows position updates
+    berlin.position = Geodetic(-17.0, 179.0, 50);
+    repository.update(&berlin);
+    EXPECT_EQ(repository.selectItemIdsInRect(europe), QVariantList({ "moscow" }));
+    EXPECT_EQ(::sorted(repository.selectItemIdsInRect(pacific)),
+              QVariantList({ "berlin", "fiji" }));
+}
+
+TEST_F(MissionItemsRepositoryTest, testSelectItemsInRectOnWorkerThread)
+{
+    MissionItemsRepositorySql repository(schema.db());
+
+    const QString id = QUuid::createUuid().toString();
+    MissionRouteItem item(&test_mission::waypoint, "WPT 1", id, {}, Geodetic(55.75, 37.61, 150));
+    repository.insert(&item, ::missionId);
+
+    // Ids stored as blobs are decoded on a pooled connection too
+    const GeodeticRect rect(Geodetic(60, 30, 0), Geodetic(50, 40, 0));
+    QVariantList ids;
+    QThread* thread = QThread::create([&]() {
+        ids = repository.selectItemIdsInRect(rect);
+    });
+    thread->start();
+    ASSERT_TRUE(thread->wait(5000));
+    delete thread;
+
+    EXPECT_EQ(ids, QVariantList({ id }));
+}
+
+TEST_F(MissionItemsRepositoryTest, testCascadeRemovesFromIndex)
+{
+    MissionItemsRepositorySql repository(schema.db());
+
+    MissionRouteItem item(&test_mission::waypoint, "WPT 1", "item", {},
+                          Geodetic(55.75, 37.61, 150));
+    repository.insert(&item, ::missionId);
+
+    QSqlQuery query(*schema.db());
+    ASSERT_TRUE(query.exec(QString("DELETE FROM missions WHERE id = '%1'").arg(::missionId)));
+
+    const GeodeticRect world(Geodetic(90, -180, 0), Geodetic(-90, 180, 0));
+    EXPECT_TRUE(repository.selectItemIdsInRect(world).isEmpty());
+    ASSERT_TRUE(query.exec("SELECT count(*) FROM mission_items_rtree"));
+    ASSERT_TRUE(query.next());
+    EXPECT_EQ(query.value(0).toInt(), 0);
+}
+
+TEST_F(MissionItemsRepositoryTest, testIndexSurvivesVacuum)
+{
+    MissionItemsRepositorySql repository(schema.db());
+
+    MissionRouteItem first(&test_mission::waypoint, "WPT 1", "first", {}, Geodetic(10, 10, 0));
+    MissionRouteItem second(&test_mission::waypoint, "WPT 2", "second", {}, Geodetic(20, 20, 0));
+    MissionRouteItem third(&test_mission::waypoint, "WPT 3", "third", {}, Geodetic(30, 30, 0));
+    repository.insertItems({ &first, &second, &third }, ::missionId);
+    repository.remove(&first);
+
+    // Gap in the keys left by the removed item is not closed
+    QSqlQuery query(*schema.db());
+    ASSERT_TRUE(query.exec("VACUUM"));
+
+    const GeodeticRect rect(Geodetic(25, 15, 0), Geodetic(15, 25, 0));
+    EXPECT_EQ(repository.selectItemIdsInRect(rect), QVariantList({ "second" }));
+    EXPECT_EQ(repository.selectMissionRouteItemIds(::missionId),
+              QVariantList({ "second", "third" }));
+}
+
+TEST_F(MissionItemsRepositoryTest, testSelectMissionItems)
+{
+    MissionItemsRepositorySql repository(schema.db());
+
+    MissionRouteItem first(&test_mission::waypoint, "WPT 1", "b", {}, Geodetic(55.75, 37.61, 150));
+    MissionRouteItem second(&test_mission::circle, "CRL 2", "a", { { "radius", 250 } });
+    repository.insertItems({ &first, &second }, ::missionId);
+
+    // Route order, not the id order
+    const QList<QVariantMap> items = repository.selectMissionItems(::missionId);
+    ASSERT_EQ(items.count(), 2);
+    EXPECT_EQ(items[0].value(props::id), QVariant("b"));
+    EXPECT_EQ(items[1].value(props::id), QVariant("a"));
+    EXPECT_EQ(items[1].value(props::params).toMap().value("radius").toInt(), 250);
+}
+
+TEST_F(MissionItemsRepositoryTest, testSelectMissionWithItems)
+{
+    MissionItemsRepositorySql itemsRepository(schema.db());
+    MissionsRepositorySql missionsRepository(schema.db());
+
+    MissionRouteItem first(&test_mission::waypoint, "WPT 1", "b", {}, Geodetic(55.75, 37.61, 150));
+    MissionRouteItem second(&test_mission::circle, "CRL 2", "a", { { "radius", 250 } });
+    itemsRepository.insertItems({ &first, &second }, ::missionId);
+
+    const MissionRecord record = missionsRepository.selectWithItems(::missionId);
+    EXPECT_EQ(record.mission.value(props::id), QVariant(::missionId));
+    ASSERT_EQ(record.items.count(), 2);
+    EXPECT_EQ(record.items[0].value(props::id), QVariant("b"));
+    EXPECT_EQ(record.items[1].value(props::params).toMap().value("radius").toInt(), 250);
+
+    // No items for unknown mission
+    const MissionRecord unknown = missionsRepository.selectWithItems("unknown");
+    EXPECT_TRUE(unknown.mission.isEmpty());
+    EXPECT_TRUE(unknown.items.isEmpty());
+}
+
+TEST_F(MissionItemsRepositoryTest, testRemoveByIds)
+{
+    MissionItemsRepositorySql repository(schema.db());
+
+    // More ids than one statement can bind
+    constexpr int count = 2500;
+    QList<MissionRouteItem*> items;
+    QVariantList ids;
+    for (int i = 0; i < count; ++i)
+    {
+        items.append(new MissionRouteItem(&test_mission::waypoint, "WPT", QString::number(i)));
+        ids.append(items.last()->id());
+    }
+    repository.insertItems(items, ::missionId);
+    qDeleteAll(items);
+
+    // Cached rows go too
+    EXPECT_FALSE(repository.select("10").isEmpty());
+
+    repository.removeByIds(ids.mid(0, count - 1));
+
+    EXPECT_EQ(repository.selectMissionRouteItemIds(::missionId), QVariantList({ ids.last() }));
+    EXPECT_TRUE(repository.select("10").isEmpty());
+}
+
+TEST_F(MissionItemsRepositoryTest, testForgetCascadeRemovedItems)
+{
+    MissionItemsRepositorySql repository(schema.db());
+
+    MissionRouteItem item(&test_mission::waypoint, "WPT 1", "item");
+    repository.insert(&item, ::missionId);
+    EXPECT_FALSE(repository.select("item").isEmpty());
+
+    QSqlQuery query(*schema.db());
+    ASSERT_TRUE(query.exec(QString("DELETE FROM missions WHERE id = '%1'").arg(::missionId)));
+
+    repository.forgetMissionItems(::missionId);
+    EXPECT_TRUE(repository.select("item").isEmpty());
+}
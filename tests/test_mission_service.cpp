@@ -1,6 +1,7 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <QCoreApplication>
 #include <QSignalSpy>
 
 #include "missions_service.h"
@@ -9,30 +10,55 @@
 using namespace testing;
 using namespace md::domain;
 
+class TransactionMock : public ITransaction
+{
+public:
+    MOCK_METHOD(bool, isActive, (), (const, override));
+    MOCK_METHOD(bool, commit, (), (override));
+    MOCK_METHOD(void, rollback, (), (override));
+};
+
 class MissionsRepositoryMock : public IMissionsRepository
 {
 public:
+    MOCK_METHOD(TransactionPtr, transaction, (), (override));
     MOCK_METHOD(QVariantMap, select, (const QVariant&), (override));
+    MOCK_METHOD(MissionRecord, selectWithItems, (const QVariant&), (override));
     MOCK_METHOD(QVariant, selectMissionIdForVehicle, (const QVariant&), (override));
     MOCK_METHOD(QVariantList, selectMissionIds, (), (override));
+    MOCK_METHOD(Page, selectPage, (const PageRequest&), (override));
 
-    MOCK_METHOD(void, insert, (Mission*), (override));
+    MOCK_METHOD(bool, insert, (Mission*), (override));
+    MOCK_METHOD(bool, upsert, (Mission*), (override));
     MOCK_METHOD(void, read, (Mission*), (override));
-    MOCK_METHOD(void, update, (Mission*), (override));
-    MOCK_METHOD(void, remove, (Mission*), (override));
+    MOCK_METHOD(bool, update, (Mission*), (override));
+    MOCK_METHOD(bool, remove, (Mission*), (override));
 };
 
 class MissionRouteItemsRepositoryMock : public IMissionItemsRepository
 {
 public:
+    MOCK_METHOD(TransactionPtr, transaction, (), (override));
     MOCK_METHOD(QVariantMap, select, (const QVariant&), (override));
     MOCK_METHOD(QVariantList, selectMissionRouteItemIds, (const QVariant&), (override));
-
-    MOCK_METHOD(void, insert, (MissionRouteItem*, const QVariant&), (override));
+    MOCK_METHOD(QList<QVariantMap>, selectMissionItems, (const QVariant&), (override));
+    MOCK_METHOD(Page, selectMissionItemsPage, (const QVariant&, const PageRequest&), (override));
+    MOCK_METHOD(QVariantList, selectItemIdsInRect, (const GeodeticRect&), (override));
+
+    MOCK_METHOD(bool, insert, (MissionRouteItem*, const QVariant&), (override));
+    MOCK_METHOD(bool, insertItems, (const QList<MissionRouteItem*>&, const QVariant&),
+                (override));
+    MOCK_METHOD(bool, upsert, (MissionRouteItem*, const QVariant&), (override));
+    MOCK_METHOD(bool, upsertItems, (const QList<MissionRouteItem*>&, const QVariant&),
+                (override));
     MOCK_METHOD(void, read, (MissionRouteItem*), (override));
-    MOCK_METHOD(void, update, (MissionRouteItem*), (override));
-    MOCK_METHOD(void, remove, (MissionRouteItem*), (override));
-    MOCK_METHOD(void, removeById, (const QVariant&), (override));
+    MOCK_METHOD(bool, update, (MissionRouteItem*), (override));
+    MOCK_METHOD(bool, remove, (MissionRouteItem*), (override));
+    MOCK_METHOD(bool, removeById, (const QVariant&), (override));
+    MOCK_METHOD(bool, removeByIds, (const QVariantList&), (override));
+    MOCK_METHOD(bool, removeMissionItemsExcept, (const QVariant&, const QVariantList&),
+                (override));
+    MOCK_METHOD(void, forgetMissionItems, (const QVariant&), (override));
 };
 
 class MissionServiceTest : public Test
@@ -48,12 +74,15 @@ public:
 
     void SetUp() override
     {
+        // Repository writes succeed unless told otherwise
+        DefaultValue<bool>::Set(true);
         service.registerMissionType(&test_mission::missionType);
     }
 
     void TearDown() override
     {
         service.unregisterMissionType(&test_mission::missionType);
+        DefaultValue<bool>::Clear();
     }
 };
 
@@ -74,29 +103,23 @@ TEST_F(MissionServiceTest, testReadAll)
     EXPECT_CALL(missions, selectMissionIds())
         .WillOnce(Return(QVariantList({ mission1Id, mission2Id })));
 
-    // Select mission 1
-    EXPECT_CALL(missions, select(mission1Id))
-        .WillOnce(Return(QVariantMap({ { props::type, test_mission::missionType.id } })));
-    EXPECT_CALL(items, selectMissionRouteItemIds(mission1Id))
-        .WillOnce(Return(QVariantList({ item11Id, item12Id })));
-    // Select item11
-    EXPECT_CALL(items, select(item11Id))
-        .WillOnce(Return(QVariantMap({ { props::type, test_mission::waypoint.id } })));
-    // Select item12
-    EXPECT_CALL(items, select(item12Id))
-        .WillOnce(Return(QVariantMap({ { props::type, test_mission::circle.id } })));
-
-    // Select mission 2
-    EXPECT_CALL(missions, select(mission2Id))
-        .WillOnce(Return(QVariantMap({ { props::type, test_mission::missionType.id } })));
-    EXPECT_CALL(items, selectMissionRouteItemIds(mission2Id))
-        .WillOnce(Return(QVariantList({ item21Id, item22Id })));
-    // Select item21
-    EXPECT_CALL(items, select(item21Id))
-        .WillOnce(Return(QVariantMap({ { props::type, test_mission::waypoint.id } })));
-    // Select item22
-    EXPECT_CALL(items, select(item22Id))
-        .WillOnce(Return(QVariantMap({ { props::type, test_mission::waypoint.id } })));
+    // Select mission 1 with its items at once
+    EXPECT_CALL(missions, selectWithItems(mission1Id))
+        .WillOnce(Return(MissionRecord{
+            { { props::type, test_mission::missionType.id } },
+            { { { props::id, item11Id }, { props::type, test_mission::waypoint.id } },
+              { { props::id, item12Id }, { props::type, test_mission::circle.id } } } }));
+
+    // Select mission 2 with its items at once
+    EXPECT_CALL(missions, selectWithItems(mission2Id))
+        .WillOnce(Return(MissionRecord{
+            { { props::type, test_mission::missionType.id } },
+            { { { props::id, item21Id }, { props::type, test_mission::waypoint.id } },
+              { { props::id, item22Id }, { props::type, test_mission::waypoint.id } } } }));
+
+    // Items are not read separately
+    EXPECT_CALL(missions, select(_)).Times(0);
+    EXPECT_CALL(items, selectMissionItems(_)).Times(0);
 
     service.readAll();
 
@@ -131,17 +154,22 @@ TEST_F(MissionServiceTest, testInsertMission)
     MissionRouteItem* wpt6 = new MissionRouteItem(&test_mission::changeSpeed, "CH SPD 6");
     mission->route()->addItem(wpt6);
 
+    // Whole mission in one transaction
+    auto transaction = QSharedPointer<TransactionMock>::create();
+    EXPECT_CALL(missions, transaction()).WillOnce(Return(transaction));
+    EXPECT_CALL(*transaction, commit()).WillOnce(Return(true));
+
     // Insert mission
     EXPECT_CALL(missions, insert(mission)).Times(1);
-    EXPECT_CALL(items, selectMissionRouteItemIds(mission->id())).WillOnce(Return(QVariantList({})));
 
-    // Insert mission items
-    EXPECT_CALL(items, insert(wpt1, mission->id())).Times(1);
-    EXPECT_CALL(items, insert(wpt2, mission->id())).Times(1);
-    EXPECT_CALL(items, insert(wpt3, mission->id())).Times(1);
-    EXPECT_CALL(items, insert(wpt4, mission->id())).Times(1);
-    EXPECT_CALL(items, insert(wpt5, mission->id())).Times(1);
-    EXPECT_CALL(items, insert(wpt6, mission->id())).Times(1);
+    // Upsert mission items in one batch
+    EXPECT_CALL(items, upsertItems(QList<MissionRouteItem*>({ wpt1, wpt2, wpt3, wpt4, wpt5, wpt6 }),
+                                   mission->id()))
+        .Times(1);
+    EXPECT_CALL(items, removeMissionItemsExcept(
+                           mission->id(), QVariantList({ wpt1->id(), wpt2->id(), wpt3->id(),
+                                                         wpt4->id(), wpt5->id(), wpt6->id() })))
+        .Times(1);
 
     service.saveMission(mission);
 
@@ -171,19 +199,22 @@ TEST_F(MissionServiceTest, testUpdateMission)
     mission->route()->removeItem(wpt3);
     mission->route()->addItem(wpt4);
 
+    // Whole mission in one transaction
+    auto transaction = QSharedPointer<TransactionMock>::create();
+    EXPECT_CALL(missions, transaction()).WillOnce(Return(transaction));
+    EXPECT_CALL(*transaction, commit()).WillOnce(Return(true));
+
     // Update mission
     EXPECT_CALL(missions, update(mission)).Times(1);
-    EXPECT_CALL(items, selectMissionRouteItemIds(mission->id()))
-        .WillOnce(Return(QVariantList({ wpt1->id, wpt2->id, wpt3->id })));
 
-    // Update wpt2
-    EXPECT_CALL(items, update(wpt2)).Times(1);
-    // Insert wpt4
-    EXPECT_CALL(items, insert(wpt4, mission->id())).Times(1);
+    // Update wpt2 & insert wpt4
+    EXPECT_CALL(items, upsertItems(QList<MissionRouteItem*>({ wpt2, wpt4 }), mission->id()))
+        .Times(1);
 
-    // Remove wpt1 & wpt3
-    EXPECT_CALL(items, removeById(wpt1->id())).Times(1);
-    EXPECT_CALL(items, removeById(wpt3->id())).Times(1);
+    // Remove wpt1 & wpt3 in one statement
+    EXPECT_CALL(items,
+                removeMissionItemsExcept(mission->id(), QVariantList({ wpt2->id(), wpt4->id() })))
+        .Times(1);
 
     service.saveMission(mission);
 
@@ -213,24 +244,24 @@ TEST_F(MissionServiceTest, testRestoreMission)
 
     // Read mission
     EXPECT_CALL(missions, read(mission)).Times(1);
-    EXPECT_CALL(items, selectMissionRouteItemIds(mission->id()))
-        .WillOnce(Return(QVariantList({ wpt1->id, wpt2->id, wpt3->id })));
 
-    // Read wpt2
-    EXPECT_CALL(items, read(wpt2)).Times(1);
+    // Select wpt1, wpt2 & wpt3 at once, wpt2 is restored in place
+    EXPECT_CALL(items, selectMissionItems(mission->id()))
+        .WillOnce(Return(QList<QVariantMap>(
+            { { { props::id, wpt1->id() }, { props::type, test_mission::waypoint.id } },
+              { { props::id, wpt2->id() },
+                { props::name, "WPT 2 stored" },
+                { props::type, test_mission::waypoint.id } },
+              { { props::id, wpt3->id() }, { props::type, test_mission::waypoint.id } } })));
 
     // wpt4 will just be removed form the mission
 
-    // Select wpt1 & wpt3
-    EXPECT_CALL(items, select(wpt1->id()))
-        .WillOnce(Return(QVariantMap({ { props::type, test_mission::waypoint.id } })));
-    EXPECT_CALL(items, select(wpt3->id()))
-        .WillOnce(Return(QVariantMap({ { props::type, test_mission::waypoint.id } })));
-
     service.restoreMission(mission);
 
     EXPECT_EQ(spyChanged.count(), 1);
     EXPECT_EQ(mission->route()->count(), 3);
+    EXPECT_EQ(wpt2->name(), "WPT 2 stored");
+    EXPECT_FALSE(wpt2->isDirty());
 }
 
 TEST_F(MissionServiceTest, testRemoveMission)
@@ -254,17 +285,10 @@ TEST_F(MissionServiceTest, testRemoveMission)
     MissionRouteItem* wpt4 = new MissionRouteItem(&test_mission::waypoint, "WPT 6");
     mission->route()->addItem(wpt4);
 
-    // Remove mission
+    // Remove mission, stored items are removed by the cascade
     EXPECT_CALL(missions, remove(mission)).Times(1);
-    EXPECT_CALL(items, selectMissionRouteItemIds(mission->id()))
-        .WillOnce(Return(QVariantList({ wpt1->id, wpt2->id, wpt3->id })));
-
-    // Remove wpt1
-    EXPECT_CALL(items, removeById(wpt1->id())).Times(1);
-
-    // Remove wpt2 & wpt3
-    EXPECT_CALL(items, removeById(wpt2->id())).Times(1);
-    EXPECT_CALL(items, removeById(wpt3->id())).Times(1);
+    EXPECT_CALL(items, forgetMissionItems(mission->id())).Times(1);
+    EXPECT_CALL(items, removeById(_)).Times(0);
 
     service.removeMission(mission);
 
@@ -281,12 +305,8 @@ TEST_F(MissionServiceTest, testUpdateMissionRouteItem)
 
     service.addMission(mission);
 
-    // Check mission
-    EXPECT_CALL(items, selectMissionRouteItemIds(mission->id()))
-        .WillOnce(Return(QVariantList({ wpt->id })));
-
-    // Update wpt
-    EXPECT_CALL(items, update(wpt)).Times(1);
+    // Update wpt without checking stored items
+    EXPECT_CALL(items, upsert(wpt, mission->id())).Times(1);
 
     service.saveItem(mission->route, wpt);
 }
@@ -305,3 +325,180 @@ TEST_F(MissionServiceTest, testRestoreMissionRouteItem)
 
     service.restoreItem(mission->route(), wpt);
 }
+
+TEST_F(MissionServiceTest, testRefreshInsertsItemAtStoredIndex)
+{
+    Mission* mission = new Mission(&test_mission::missionType, "Test mission");
+    MissionRouteItem* wpt1 = new MissionRouteItem(&test_mission::waypoint, "WPT 1");
+    MissionRouteItem* wpt3 = new MissionRouteItem(&test_mission::waypoint, "WPT 3");
+    mission->route()->addItem(wpt1);
+    mission->route()->addItem(wpt3);
+    service.addMission(mission);
+
+    // Inserted aside between the held items
+    const QVariant wpt2Id = md::utils::generateId();
+    EXPECT_CALL(items, select(wpt2Id))
+        .WillOnce(Return(QVariantMap({ { props::id, wpt2Id },
+                                       { props::name, "WPT 2" },
+                                       { props::type, test_mission::waypoint.id },
+                                       { props::mission, mission->route()->id() } })));
+    EXPECT_CALL(items, selectMissionRouteItemIds(mission->id()))
+        .WillOnce(Return(QVariantList({ wpt1->id(), wpt2Id, wpt3->id() })));
+
+    service.refreshItems({ wpt2Id });
+
+    ASSERT_EQ(mission->route()->count(), 3);
+    EXPECT_EQ(mission->route()->item(1)->id(), wpt2Id);
+    EXPECT_EQ(mission->route()->item(2), wpt3);
+}
+
+TEST_F(MissionServiceTest, testQueuedItemSavesCollapse)
+{
+    PersistenceQueue queue(60000);
+    MissionsService queued(&missions, &items, &queue);
+
+    // fixture
+    Mission* mission = new Mission(&test_mission::missionType, "Test mission");
+    MissionRouteItem* wpt = new MissionRouteItem(&test_mission::waypoint, "WPT 1");
+    mission->route()->addItem(wpt);
+
+    queued.addMission(mission);
+
+    // Copy of the item with the latest state is written once
+    QString written;
+    EXPECT_CALL(items, upsert(Ne(wpt), mission->id()))
+        .WillOnce(Invoke([&written](MissionRouteItem* item, const QVariant&) {
+            written = item->name();
+            return true;
+        }));
+
+    for (int i = 0; i < 10; ++i)
+    {
+        wpt->name = QString("WPT %1").arg(i);
+        queued.saveItem(mission->route, wpt);
+    }
+    EXPECT_TRUE(wpt->isDirty());
+    EXPECT_TRUE(written.isEmpty());
+
+    queue.flush().waitForFinished();
+    EXPECT_EQ(written, "WPT 9");
+    EXPECT_EQ(queue.stats().coalesced, 9);
+
+    // Clean once the write is committed
+    QCoreApplication::processEvents();
+    EXPECT_FALSE(wpt->isDirty());
+}
+
+TEST_F(MissionServiceTest, testQueuedSaveFailureKeepsDirty)
+{
+    PersistenceQueue queue(60000);
+    MissionsService queued(&missions, &items, &queue);
+
+    Mission* mission = new Mission(&test_mission::missionType, "Test mission");
+    MissionRouteItem* wpt = new MissionRouteItem(&test_mission::waypoint, "WPT 1");
+    MissionRouteItem* wpt2 = new MissionRouteItem(&test_mission::waypoint, "WPT 2");
+    mission->route()->addItem(wpt);
+    mission->route()->addItem(wpt2);
+    queued.addMission(mission);
+
+    EXPECT_CALL(items, upsert(_, mission->id()))
+        .WillOnce(Return(false))
+        .WillOnce(Return(true));
+
+    queued.saveItem(mission->route, wpt);
+    queue.flush().waitForFinished();
+    QCoreApplication::processEvents();
+    EXPECT_TRUE(wpt->isDirty());
+    EXPECT_EQ(queue.stats().failed, 1);
+
+    // Changed after the snapshot, so the written state is not the current one
+    queued.saveItem(mission->route, wpt2);
+    wpt2->name = "WPT 2 changed";
+    queue.flush().waitForFinished();
+    QCoreApplication::processEvents();
+    EXPECT_TRUE(wpt2->isDirty());
+}
+
+TEST_F(MissionServiceTest, testQueuedRemovalIsNotRefreshedBack)
+{
+    PersistenceQueue queue(60000);
+    MissionsService queued(&missions, &items, &queue);
+    queued.registerMissionType(&test_mission::missionType);
+
+    Mission* mission = new Mission(&test_mission::missionType, "Test mission");
+    const QVariant missionId = mission->id();
+    queued.addMission(mission);
+
+    QSignalSpy spyAdded(&queued, &IMissionsService::missionAdded);
+    QSignalSpy spyRemoved(&queued, &IMissionsService::missionRemoved);
+
+    queued.removeMission(mission);
+
+    // Change of an earlier save comes while the row is still there
+    EXPECT_CALL(missions, select(_)).Times(0);
+    EXPECT_CALL(missions, selectWithItems(_)).Times(0);
+    queued.refreshMissions({ missionId });
+
+    EXPECT_EQ(spyAdded.count(), 0);
+    EXPECT_EQ(spyRemoved.count(), 1);
+    EXPECT_TRUE(queued.missionIds().isEmpty());
+
+    EXPECT_CALL(missions, remove(Ne(mission))).Times(1);
+    EXPECT_CALL(items, forgetMissionItems(missionId)).Times(1);
+    queue.flush().waitForFinished();
+}
+
+TEST_F(MissionServiceTest, testQueuedSaveWritesDirtyColumns)
+{
+    PersistenceQueue queue(60000);
+    MissionsService queued(&missions, &items, &queue);
+
+    Mission* mission = new Mission(&test_mission::missionType, "Test mission");
+    MissionRouteItem* wpt = new MissionRouteItem(&test_mission::waypoint, "WPT 1");
+    mission->route()->addItem(wpt);
+    queued.addMission(mission);
+    wpt->markClean();
+
+    // Snapshot is a stored item with only the name changed
+    QStringList dirtyFields;
+    EXPECT_CALL(items, upsert(Ne(wpt), mission->id()))
+        .WillOnce(Invoke([&dirtyFields](MissionRouteItem* item, const QVariant&) {
+            EXPECT_TRUE(item->isPersisted());
+            dirtyFields = item->dirtyFields();
+            return true;
+        }));
+
+    wpt->name = "WPT renamed";
+    queued.saveItem(mission->route, wpt);
+    queue.flush().waitForFinished();
+
+    EXPECT_EQ(dirtyFields, QStringList({ props::name }));
+}
+
+TEST_F(MissionServiceTest, testQueuedRestoreReadsAfterWrites)
+{
+    PersistenceQueue queue(60000);
+    MissionsService queued(&missions, &items, &queue);
+
+    Mission* mission = new Mission(&test_mission::missionType, "Test mission");
+    MissionRouteItem* wpt = new MissionRouteItem(&test_mission::waypoint, "WPT 1");
+    mission->route()->addItem(wpt);
+    queued.addMission(mission);
+
+    bool written = false;
+    EXPECT_CALL(items, upsert(Ne(wpt), mission->id()))
+        .WillOnce(Invoke([&written](MissionRouteItem*, const QVariant&) {
+            written = true;
+            return true;
+        }));
+    EXPECT_CALL(items, read(wpt)).WillOnce(Invoke([&written](MissionRouteItem*) {
+        EXPECT_TRUE(written);
+    }));
+
+    // Restore doesn't wait for the queued save, it reads from the event loop after the flush
+    queued.saveItem(mission->route, wpt);
+    queued.restoreItem(mission->route, wpt);
+
+    queue.flush().waitForFinished();
+    QCoreApplication::processEvents();
+}
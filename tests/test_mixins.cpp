@@ -103,3 +103,31 @@ TEST_F(MixinsTest, testParametrisedMixin)
     EXPECT_FALSE(entity.hasParameter("string_propery"));
     EXPECT_EQ(changeCounter, 3);
 }
+
+TEST_F(MixinsTest, testDirtyFields)
+{
+    ParametrisedMixin<NamedMixin<Entity>> entity(QVariantMap(), []() {}, "Name", "id");
+
+    // Never persisted entity is dirty entirely
+    EXPECT_FALSE(entity.isPersisted());
+    EXPECT_TRUE(entity.isDirty());
+    EXPECT_TRUE(entity.dirtyFields().isEmpty());
+
+    entity.markClean();
+    EXPECT_TRUE(entity.isPersisted());
+    EXPECT_FALSE(entity.isDirty());
+
+    entity.name = "Name"; // Same value
+    EXPECT_FALSE(entity.isDirty());
+
+    entity.name = "New name";
+    EXPECT_EQ(entity.dirtyFields(), QStringList({ props::name }));
+
+    entity.setParameter("speed", 10);
+    QStringList fields = entity.dirtyFields();
+    fields.sort();
+    EXPECT_EQ(fields, QStringList({ props::name, props::params }));
+
+    entity.markClean();
+    EXPECT_FALSE(entity.isDirty());
+}
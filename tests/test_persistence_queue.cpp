@@ -0,0 +1,203 @@
+#include <gtest/gtest.h>
+
+#include <QElapsedTimer>
+#include <QThread>
+
+#include "persistence_queue.h"
+
+using namespace md::domain;
+
+namespace
+{
+constexpr int longWindow = 60000;
+
+class CountingTransaction : public ITransaction
+{
+public:
+    explicit CountingTransaction(int* commits) : m_commits(commits)
+    {
+    }
+
+    bool isActive() const override
+    {
+        return true;
+    }
+
+    bool commit() override
+    {
+        (*m_commits)++;
+        return true;
+    }
+
+    void rollback() override
+    {
+    }
+
+private:
+    int* const m_commits;
+};
+} // namespace
+
+TEST(PersistenceQueueTest, testCollapsesWritesOfKey)
+{
+    QStringList written;
+    PersistenceQueue queue(::longWindow);
+
+    for (int i = 0; i < 10; ++i)
+    {
+        queue.enqueue("item", [&written, i]() {
+            written.append(QString("item %1").arg(i));
+            return true;
+        });
+    }
+    queue.enqueue("other", [&written]() {
+        written.append("other");
+        return true;
+    });
+    queue.enqueue("item", [&written]() {
+        written.append("item last");
+        return true;
+    });
+
+    EXPECT_TRUE(queue.isPending("item"));
+    EXPECT_EQ(queue.pendingCount(), 2);
+
+    queue.flush().waitForFinished();
+
+    EXPECT_EQ(written, QStringList({ "item last", "other" }));
+    EXPECT_FALSE(queue.isPending("item"));
+    EXPECT_EQ(queue.stats().enqueued, 12);
+    EXPECT_EQ(queue.stats().coalesced, 10);
+    EXPECT_EQ(queue.stats().written, 2);
+}
+
+TEST(PersistenceQueueTest, testReplacingWriteKeepsItsSlot)
+{
+    // Mission insert, upsert of its item, then another save of the mission
+    QStringList rows;
+    PersistenceQueue queue(::longWindow);
+
+    queue.enqueue("mission", [&rows]() {
+        rows.append("mission");
+        return true;
+    });
+    queue.enqueue("item", [&rows]() {
+        // Item refers to the mission row
+        if (!rows.contains("mission"))
+            return false;
+
+        rows.append("item");
+        return true;
+    });
+    queue.enqueue("mission", [&rows]() {
+        if (!rows.contains("mission"))
+            rows.append("mission");
+        return true;
+    });
+
+    // Mission goes first with its latest write, the item doesn't fail on a missing parent
+    queue.flush().waitForFinished();
+    EXPECT_EQ(rows, QStringList({ "mission", "item" }));
+    EXPECT_EQ(queue.stats().failed, 0);
+    EXPECT_EQ(queue.pendingCount(), 0);
+}
+
+TEST(PersistenceQueueTest, testEmptyKeyIsNotCollapsed)
+{
+    int writes = 0;
+    PersistenceQueue queue(::longWindow);
+
+    for (int i = 0; i < 3; ++i)
+    {
+        queue.enqueue(QString(), [&writes]() {
+            writes++;
+            return true;
+        });
+    }
+
+    queue.flush().waitForFinished();
+    EXPECT_EQ(writes, 3);
+}
+
+TEST(PersistenceQueueTest, testWritesAfterWindow)
+{
+    int commits = 0;
+    PersistenceQueue queue(10, [&commits]() {
+        return TransactionPtr(new CountingTransaction(&commits));
+    });
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < 5; ++i)
+    {
+        queue.enqueue(QString::number(i), []() {
+            return true;
+        });
+    }
+
+    // Due writes go in one transaction without a flush
+    while (queue.pendingCount() && timer.elapsed() < 5000)
+    {
+        QThread::msleep(1);
+    }
+    queue.flush().waitForFinished();
+
+    EXPECT_EQ(queue.pendingCount(), 0);
+    EXPECT_EQ(queue.stats().written, 5);
+    EXPECT_EQ(commits, queue.stats().batches);
+}
+
+TEST(PersistenceQueueTest, testFailedWriteIsRetriedAlone)
+{
+    int commits = 0;
+    PersistenceQueue queue(::longWindow, [&commits]() {
+        return TransactionPtr(new CountingTransaction(&commits));
+    });
+
+    QStringList attempts;
+    QMap<QString, bool> results;
+    for (const QString& key : QStringList({ "first", "broken", "last" }))
+    {
+        queue.enqueue(
+            key,
+            [&attempts, key]() {
+                attempts.append(key);
+                return key != "broken";
+            },
+            [&results, key](bool ok) {
+                results.insert(key, ok);
+            });
+    }
+    queue.flush().waitForFinished();
+
+    // Batch is rolled back on the failure, then every write goes on its own
+    EXPECT_EQ(attempts, QStringList({ "first", "broken", "first", "broken", "last" }));
+    EXPECT_EQ(results,
+              (QMap<QString, bool>({ { "first", true }, { "broken", false }, { "last", true } })));
+    EXPECT_EQ(commits, 2);
+    EXPECT_EQ(queue.stats().written, 2);
+    EXPECT_EQ(queue.stats().failed, 1);
+}
+
+TEST(PersistenceQueueTest, testDestructionFinishesWrites)
+{
+    int writes = 0;
+    {
+        PersistenceQueue queue(::longWindow);
+        queue.enqueue("first", [&writes]() {
+            writes++;
+            return true;
+        });
+        queue.enqueue("second", [&writes]() {
+            writes++;
+            return true;
+        });
+    }
+    EXPECT_EQ(writes, 2);
+}
+
+TEST(PersistenceQueueTest, testFlushOfEmptyQueue)
+{
+    PersistenceQueue queue;
+    EXPECT_TRUE(queue.flush().isFinished());
+}
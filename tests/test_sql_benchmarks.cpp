@@ -0,0 +1,277 @@
+#include <gtest/gtest.h>
+
+#include <QCborMap>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSqlQuery>
+#include <QTemporaryDir>
+#include <QUuid>
+
+#include "entity_serializer.h"
+#include "entity_sql_table.h"
+#include "mission_item_row.h"
+#include "mission_items_repository_sql.h"
+#include "sql_row_sink.h"
+#include "sqlite_schema.h"
+#include "test_mission_traits.h"
+#include "vehicle_row.h"
+
+using namespace md::data_source;
+
+// Benchmarks are disabled by default, run them with:
+// test_kjarni --gtest_also_run_disabled_tests --gtest_filter=*Benchmark*
+class DISABLED_SqlBenchmark : public ::testing::Test
+{
+public:
+    QTemporaryDir dir;
+};
+
+TEST_F(DISABLED_SqlBenchmark, missionItemsLookup)
+{
+    constexpr int missions = 20;
+    constexpr int lookups = 100;
+
+    for (int itemsPerMission : { 50, 500, 5000 })
+    {
+        SqliteSchema schema(dir.filePath(QString("lookup_%1.db").arg(itemsPerMission)),
+                            SqliteProfile::fast());
+        schema.setup();
+
+        QSqlQuery query(*schema.db());
+        query.exec("BEGIN");
+        for (int mission = 0; mission < missions; ++mission)
+        {
+            query.exec(QString("INSERT INTO missions (id) VALUES ('mission_%1')").arg(mission));
+            for (int item = 0; item < itemsPerMission; ++item)
+            {
+                query.exec(QString("INSERT INTO mission_items (id, mission) VALUES "
+                                   "('item_%1_%2', 'mission_%1')")
+                               .arg(mission)
+                               .arg(item));
+            }
+        }
+        query.exec("COMMIT");
+
+        MissionItemsRepositorySql repository(schema.db());
+        auto measure = [&]() {
+            QElapsedTimer timer;
+            timer.start();
+            for (int i = 0; i < lookups; ++i)
+            {
+                repository.selectMissionRouteItemIds(QString("mission_%1").arg(i % missions));
+            }
+            return timer.nsecsElapsed() / lookups / 1000;
+        };
+
+        qint64 indexed = measure();
+        query.exec("DROP INDEX mission_items_mission_idx");
+        qint64 scan = measure();
+
+        qInfo() << "rows:" << missions * itemsPerMission << "indexed:" << indexed
+                << "us, full scan:" << scan << "us";
+    }
+}
+
+TEST_F(DISABLED_SqlBenchmark, jsonEncoding)
+{
+    constexpr int rows = 5000;
+    const QVariantMap params = { { "altitude", 120.5 },
+                                 { "abortAltitude", 50 },
+                                 { "radius", 150 },
+                                 { "speed", 17.25 },
+                                 { "isAltitudeRelative", true },
+                                 { "time", 30 },
+                                 { "passthrough", false },
+                                 { "yaw", 270.0 } };
+
+    const QList<QPair<QString, QByteArray>> encodings = {
+        { "indented text", QJsonDocument(QJsonObject::fromVariantMap(params)).toJson() },
+        { "compact text",
+          QJsonDocument(QJsonObject::fromVariantMap(params)).toJson(QJsonDocument::Compact) },
+        { "cbor", QCborMap::fromVariantMap(params).toCborValue().toCbor() }
+    };
+
+    for (const auto& encoding : encodings)
+    {
+        SqliteSchema schema(dir.filePath(encoding.first + ".db"), SqliteProfile::fast());
+        schema.setup();
+
+        QSqlQuery query(*schema.db());
+        query.exec("BEGIN");
+        query.prepare("INSERT INTO vehicles (id, params) VALUES (?, ?)");
+        for (int i = 0; i < rows; ++i)
+        {
+            query.addBindValue(QString::number(i));
+            query.addBindValue(encoding.second);
+            query.exec();
+        }
+        query.exec("COMMIT");
+
+        query.exec("SELECT sum(length(params)) FROM vehicles");
+        query.next();
+        const qint64 size = query.value(0).toLongLong();
+
+        EntitySqlTable table(schema.db(), "vehicles", { "params" });
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < rows; ++i)
+        {
+            table.selectById(QString::number(i));
+        }
+
+        qInfo() << encoding.first << "bytes per row:" << size / rows
+                << "decode:" << timer.nsecsElapsed() / rows / 1000.0 << "us per row";
+    }
+}
+
+TEST_F(DISABLED_SqlBenchmark, typedRowDecode)
+{
+    constexpr int rows = 5000;
+    constexpr int reads = 20;
+
+    SqliteSchema schema(dir.filePath("typed.db"), SqliteProfile::fast());
+    schema.setup();
+
+    VehiclesSqlTable vehicles(schema.db(), JsonEncoding::Cbor);
+    MissionItemsSqlTable items(schema.db(), JsonEncoding::Cbor);
+    const QString missionId = QUuid::createUuid().toString();
+    SqlTable(schema.db(), "missions").insert({ { "id", missionId } });
+
+    QList<VehicleRow> vehicleRows;
+    QList<MissionItemRow> itemRows;
+    for (int i = 0; i < rows; ++i)
+    {
+        vehicleRows.append(VehicleRow{ QUuid::createUuid().toString(), QString("MAV %1").arg(i),
+                                       { { "mav_id", i }, { "speed", 17.25 } }, "generic" });
+
+        MissionItemRow item;
+        item.id = QUuid::createUuid().toString();
+        item.mission = missionId;
+        item.type = "waypoint";
+        item.params = { { "altitude", 120.5 }, { "radius", 150 } };
+        item.latitude = 55.0 + i * 0.001;
+        item.longitude = 37.0;
+        item.altitude = 120.5;
+        itemRows.append(item);
+    }
+    vehicles.insertRows(vehicleRows);
+    items.insertRows(itemRows);
+
+    auto measure = [](auto read) {
+        QElapsedTimer timer;
+        timer.start();
+        int count = 0;
+        for (int i = 0; i < reads; ++i)
+        {
+            count += read();
+        }
+        return timer.nsecsElapsed() / qMax(count, 1);
+    };
+
+    // Row cache stays disabled, so both decode every row
+    EntitySqlTable vehicleEntities(schema.db(), "vehicles", { "params" }, JsonEncoding::Cbor);
+    EntitySqlTable itemEntities(schema.db(), "mission_items", { "params", "position" },
+                                JsonEncoding::Cbor);
+
+    qInfo() << "vehicles typed:" << measure([&]() { return vehicles.selectRows().count(); })
+            << "ns, maps:"
+            << measure([&]() { return vehicleEntities.selectByConditions({}).count(); })
+            << "ns per row";
+    qInfo() << "mission items typed:"
+            << measure([&]() { return items.selectRows({ { "mission", missionId } }).count(); })
+            << "ns, maps:" << measure([&]() {
+                   return itemEntities.selectByConditions({ { "mission", missionId } }).count();
+               })
+            << "ns per row";
+}
+
+TEST_F(DISABLED_SqlBenchmark, routeItemSerialization)
+{
+    using namespace md::domain;
+
+    constexpr int items = 5000;
+
+    QList<MissionRouteItem*> routeItems;
+    for (int i = 0; i < items; ++i)
+    {
+        routeItems.append(new MissionRouteItem(&test_mission::circle, QString("CRL %1").arg(i),
+                                               md::utils::generateId(),
+                                               { { test_mission::radius.id, 150 + i } },
+                                               Geodetic(55.0 + i * 0.001, 37.0, 120.5f)));
+    }
+
+    auto measure = [&routeItems](auto serialize) {
+        QElapsedTimer timer;
+        timer.start();
+        for (MissionRouteItem* item : qAsConst(routeItems))
+        {
+            serialize(item);
+        }
+        return timer.nsecsElapsed() / routeItems.count();
+    };
+
+    const QStringList columns = { props::id, props::name, props::params, props::position,
+                                  props::type };
+    const QStringList jsonProperties = { props::params, props::position };
+
+    const qint64 sqlMap = measure([&](MissionRouteItem* item) {
+        const QVariantMap values = item->toVariantMap();
+        QVariantMap row;
+        for (const QString& column : columns)
+        {
+            row.insert(column, jsonProperties.contains(column)
+                                   ? sql::encodeJson(values.value(column), JsonEncoding::Cbor)
+                                   : values.value(column));
+        }
+        return row;
+    });
+    const qint64 sqlSink = measure([&](MissionRouteItem* item) {
+        SqlRowSink sink(columns, jsonProperties, JsonEncoding::Cbor);
+        item->serialize(sink);
+        return sink.row();
+    });
+    qInfo() << "sql row map:" << sqlMap << "ns, sink:" << sqlSink << "ns per item";
+
+    const qint64 jsonMap = measure([](MissionRouteItem* item) {
+        return QJsonObject::fromVariantMap(item->toVariantMap());
+    });
+    const qint64 jsonSink = measure([](MissionRouteItem* item) {
+        JsonEntitySink sink;
+        item->serialize(sink);
+        return sink.object();
+    });
+    qInfo() << "json map:" << jsonMap << "ns, sink:" << jsonSink << "ns per item";
+
+    const qint64 cborMap = measure([](MissionRouteItem* item) {
+        return QCborMap::fromVariantMap(item->toVariantMap()).toCborValue().toCbor();
+    });
+    const qint64 cborSink = measure([](MissionRouteItem* item) {
+        CborEntitySink sink;
+        item->serialize(sink);
+        return sink.finish();
+    });
+    qInfo() << "cbor map:" << cborMap << "ns, sink:" << cborSink << "ns per item";
+
+    // Reading back
+    QList<QByteArray> encoded;
+    for (MissionRouteItem* item : qAsConst(routeItems))
+    {
+        CborEntitySink sink;
+        item->serialize(sink);
+        encoded.append(sink.finish());
+    }
+    int index = 0;
+    const qint64 cborReadMap = measure([&encoded, &index](MissionRouteItem* item) {
+        item->fromVariantMap(QCborValue::fromCbor(encoded.at(index++)).toMap().toVariantMap());
+    });
+    index = 0;
+    const qint64 cborReadSource = measure([&encoded, &index](MissionRouteItem* item) {
+        item->deserialize(CborEntitySource(encoded.at(index++)));
+    });
+    qInfo() << "cbor read map:" << cborReadMap << "ns, source:" << cborReadSource
+            << "ns per item";
+
+    qDeleteAll(routeItems);
+}
@@ -0,0 +1,135 @@
+#include <gtest/gtest.h>
+
+#include <QSignalSpy>
+#include <QSqlQuery>
+#include <QTemporaryDir>
+
+#include "entity_sql_table.h"
+#include "sqlite_schema.h"
+
+using namespace md::data_source;
+
+namespace
+{
+constexpr char vehicles[] = "vehicles";
+constexpr int timeout = 1000;
+
+QList<SqlChange> changes(const QSignalSpy& spy, int index)
+{
+    return spy.at(index).first().value<QList<SqlChange>>();
+}
+} // namespace
+
+class SqlChangeFeedTest : public ::testing::Test
+{
+public:
+    QTemporaryDir dir;
+};
+
+TEST_F(SqlChangeFeedTest, testBatchPerCommit)
+{
+    SqliteSchema schema(dir.filePath("feed.db"));
+    schema.setup();
+    QSignalSpy spy(schema.changeFeed(), &SqlChangeFeed::changed);
+
+    EntitySqlTable table(schema.db(), ::vehicles);
+    const QVariant first = md::utils::generateId();
+    const QVariant second = md::utils::generateId();
+    {
+        auto transaction = table.transaction();
+        ASSERT_TRUE(table.insert({ { sql::id, first }, { "name", "first" } }));
+        ASSERT_TRUE(table.insert({ { sql::id, second }, { "name", "second" } }));
+        ASSERT_TRUE(transaction->commit());
+    }
+    ASSERT_TRUE(spy.wait(::timeout));
+    ASSERT_EQ(spy.count(), 1);
+
+    QList<SqlChange> batch = ::changes(spy, 0);
+    ASSERT_EQ(batch.count(), 2);
+    EXPECT_EQ(batch[0].table, ::vehicles);
+    EXPECT_EQ(batch[0].operation, SqlOperation::Insert);
+    EXPECT_EQ(batch[0].id, first);
+    EXPECT_EQ(batch[1].id, second);
+
+    // Rolled back writes are not published
+    {
+        auto transaction = table.transaction();
+        ASSERT_TRUE(table.updateById({ { "name", "renamed" } }, first));
+    }
+    ASSERT_TRUE(table.removeById(second));
+    ASSERT_TRUE(spy.wait(::timeout));
+    ASSERT_EQ(spy.count(), 2);
+
+    batch = ::changes(spy, 1);
+    ASSERT_EQ(batch.count(), 1);
+    EXPECT_EQ(batch[0].operation, SqlOperation::Delete);
+    EXPECT_EQ(batch[0].id, second);
+}
+
+TEST_F(SqlChangeFeedTest, testDeleteOfStoredRow)
+{
+    SqliteSchema schema(dir.filePath("feed.db"));
+    schema.setup();
+    const QVariant id = md::utils::generateId();
+    ASSERT_TRUE(EntitySqlTable(schema.db(), ::vehicles).insert({ { sql::id, id } }));
+
+    // Row written before the feed was attached
+    SqlChangeFeed feed(*schema.db());
+    ASSERT_TRUE(feed.attach(*schema.db()));
+    QSignalSpy spy(&feed, &SqlChangeFeed::changed);
+
+    QSqlQuery query(*schema.db());
+    query.prepare("DELETE FROM vehicles WHERE id = ?");
+    query.addBindValue(sql::toUuidBlob(id));
+    ASSERT_TRUE(query.exec());
+    ASSERT_TRUE(spy.wait(::timeout));
+
+    const QList<SqlChange> batch = ::changes(spy, 0);
+    ASSERT_EQ(batch.count(), 1);
+    EXPECT_EQ(batch[0].operation, SqlOperation::Delete);
+    EXPECT_EQ(batch[0].id, id);
+}
+
+TEST_F(SqlChangeFeedTest, testDeletesByConditions)
+{
+    SqliteSchema schema(dir.filePath("feed.db"));
+    schema.setup();
+    QSignalSpy spy(schema.changeFeed(), &SqlChangeFeed::changed);
+
+    EntitySqlTable table(schema.db(), ::vehicles);
+    const QVariant first = md::utils::generateId();
+    const QVariant second = md::utils::generateId();
+    ASSERT_TRUE(table.insertMany({ { { sql::id, first }, { "name", "MAV" } },
+                                   { { sql::id, second }, { "name", "MAV" } } }));
+    ASSERT_TRUE(spy.wait(::timeout));
+
+    // Ids of the deleted rows are taken by the trigger while the rows are still readable
+    ASSERT_TRUE(table.removeByConditions({ { "name", "MAV" } }));
+    ASSERT_TRUE(spy.wait(::timeout));
+
+    const QList<SqlChange> batch = ::changes(spy, spy.count() - 1);
+    ASSERT_EQ(batch.count(), 2);
+    EXPECT_EQ(batch[0].operation, SqlOperation::Delete);
+    EXPECT_EQ(QVariantList({ batch[0].id, batch[1].id }), QVariantList({ first, second }));
+}
+
+TEST_F(SqlChangeFeedTest, testChangesInvalidateOtherTables)
+{
+    SqliteSchema schema(dir.filePath("feed.db"));
+    schema.setup();
+    QSignalSpy spy(schema.changeFeed(), &SqlChangeFeed::changed);
+
+    EntitySqlTable cached(schema.db(), ::vehicles);
+    cached.setCacheCapacity(16);
+    EntitySqlTable writer(schema.db(), ::vehicles);
+
+    const QVariant id = md::utils::generateId();
+    ASSERT_TRUE(writer.insert({ { sql::id, id }, { "name", "MAV 23" } }));
+    ASSERT_TRUE(spy.wait(::timeout));
+    EXPECT_EQ(cached.selectById(id).value("name").toString(), "MAV 23");
+
+    ASSERT_TRUE(writer.updateById({ { "name", "MAV 24" } }, id));
+    ASSERT_TRUE(spy.wait(::timeout));
+    EXPECT_EQ(cached.selectById(id).value("name").toString(), "MAV 24");
+    EXPECT_EQ(cached.cacheStats().hits, 0);
+}
@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+
+#include <QSqlQuery>
+#include <QTemporaryDir>
+#include <QThread>
+
+#include "sql_connection_pool.h"
+#include "sql_table.h"
+
+using namespace md::data_source;
+
+namespace
+{
+constexpr char connection[] = "test_sql_connection_pool";
+} // namespace
+
+class SqlConnectionPoolTest : public ::testing::Test
+{
+public:
+    QTemporaryDir dir;
+    QSqlDatabase db;
+
+    void SetUp() override
+    {
+        db = QSqlDatabase::addDatabase("QSQLITE", ::connection);
+        db.setDatabaseName(dir.filePath("pool.db"));
+        ASSERT_TRUE(db.open());
+
+        QSqlQuery query(db);
+        ASSERT_TRUE(query.exec("CREATE TABLE items (id TEXT PRIMARY KEY NOT NULL, value INTEGER)"));
+    }
+
+    void TearDown() override
+    {
+        db.close();
+        db = QSqlDatabase();
+        QSqlDatabase::removeDatabase(::connection);
+    }
+};
+
+TEST_F(SqlConnectionPoolTest, testOriginThreadUsesOrigin)
+{
+    SqlConnectionPool pool(db);
+
+    EXPECT_EQ(pool.connection().connectionName(), db.connectionName());
+    EXPECT_EQ(SqlConnectionPool::connection(db).connectionName(), db.connectionName());
+    EXPECT_EQ(pool.count(), 0);
+}
+
+TEST_F(SqlConnectionPoolTest, testWorkerThreadGetsOwnConnection)
+{
+    int setups = 0;
+    SqlConnectionPool pool(db, [&setups](QSqlDatabase&) {
+        setups++;
+    });
+    SqlTable table(&db, "items");
+
+    QString workerConnection;
+    bool inserted = false;
+    QThread* thread = QThread::create([&]() {
+        workerConnection = SqlConnectionPool::connection(db).connectionName();
+        inserted = table.insert({ { "id", "worker" }, { "value", 1 } });
+        // Same connection for the same thread
+        EXPECT_EQ(pool.connection().connectionName(), workerConnection);
+        EXPECT_EQ(pool.count(), 1);
+    });
+    thread->start();
+    ASSERT_TRUE(thread->wait(5000));
+    delete thread;
+
+    EXPECT_TRUE(inserted);
+    EXPECT_NE(workerConnection, db.connectionName());
+    EXPECT_EQ(setups, 1);
+
+    // Released on thread exit
+    EXPECT_EQ(pool.count(), 0);
+    EXPECT_FALSE(QSqlDatabase::contains(workerConnection));
+
+    // Visible for the origin connection
+    EXPECT_EQ(table.selectOne({ { "id", "worker" } }, "value"), QVariantList({ 1 }));
+}
+
+TEST_F(SqlConnectionPoolTest, testReleasedConnectionDropsStatements)
+{
+    SqlTable table(&db, "items");
+    ASSERT_TRUE(table.insert({ { "id", "origin" }, { "value", 1 } }));
+
+    table.selectOne({ { "id", "origin" } }, "value");
+    table.selectOne({ { "id", "origin" } }, "value");
+    const SqlStatementCacheStats cached = table.statementCacheStats();
+
+    // Statements are prepared again for a connection of the same name
+    SqlTable::releaseConnection(db.connectionName());
+    EXPECT_EQ(table.selectOne({ { "id", "origin" } }, "value"), QVariantList({ 1 }));
+    EXPECT_EQ(table.statementCacheStats().hits, cached.hits);
+    EXPECT_EQ(table.statementCacheStats().misses, cached.misses + 1);
+}
@@ -0,0 +1,51 @@
+#include <gtest/gtest.h>
+
+#include <QSqlQuery>
+#include <QTemporaryDir>
+
+#include "sql_table.h"
+#include "sqlite_schema.h"
+
+using namespace md::data_source;
+
+class SqlSchemaCatalogTest : public ::testing::Test
+{
+public:
+    QTemporaryDir dir;
+};
+
+TEST_F(SqlSchemaCatalogTest, testTablesShareInfo)
+{
+    SqliteSchema schema(dir.filePath("catalog.db"));
+    schema.setup();
+
+    SqlTable first(schema.db(), "mission_items");
+    SqlTable second(schema.db(), "mission_items");
+    EXPECT_EQ(first.tableInfo().data(), second.tableInfo().data());
+
+    SqlTableInfoPtr info = schema.catalog()->table("mission_items");
+    EXPECT_EQ(info.data(), first.tableInfo().data());
+    EXPECT_EQ(info->indexOf("id"), 0);
+    EXPECT_EQ(info->type("id"), "UUID");
+    EXPECT_EQ(info->type("latitude"), "REAL");
+    EXPECT_TRUE(info->columns().first().primaryKey);
+    EXPECT_FALSE(info->contains("missing"));
+}
+
+TEST_F(SqlSchemaCatalogTest, testInvalidate)
+{
+    SqliteSchema schema(dir.filePath("catalog.db"));
+    schema.setup();
+
+    SqlTable table(schema.db(), "vehicles");
+    const int generation = schema.catalog()->generation();
+
+    QSqlQuery query(*schema.db());
+    ASSERT_TRUE(query.exec("ALTER TABLE vehicles ADD COLUMN extra INTEGER"));
+    EXPECT_FALSE(table.columnNames().contains("extra"));
+
+    schema.catalog()->invalidate();
+    EXPECT_EQ(schema.catalog()->generation(), generation + 1);
+    EXPECT_TRUE(table.columnNames().contains("extra"));
+    EXPECT_TRUE(table.insert({ { "id", "1" }, { "extra", 42 } }));
+}
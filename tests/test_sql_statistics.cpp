@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QThread>
+
+#include "sql_statistics.h"
+#include "sql_table.h"
+
+using namespace md::data_source;
+
+namespace
+{
+constexpr char connection[] = "test_sql_statistics";
+} // namespace
+
+class SqlStatisticsTest : public ::testing::Test
+{
+public:
+    SqlStatistics* statistics = SqlStatistics::instance();
+
+    void SetUp() override
+    {
+        statistics->reset();
+    }
+
+    void TearDown() override
+    {
+        statistics->reset();
+        statistics->setEnabled(true);
+    }
+};
+
+TEST_F(SqlStatisticsTest, testPercentiles)
+{
+    // 90 fast statements of 10 us and 10 slow ones of 1000 us
+    for (int i = 0; i < 90; ++i)
+    {
+        statistics->record("SELECT 1", 10000, 1);
+    }
+    for (int i = 0; i < 10; ++i)
+    {
+        statistics->record("SELECT 1", 1000000, 1);
+    }
+
+    SqlStatementStats stats = statistics->statement("SELECT 1");
+    EXPECT_EQ(stats.count, 100);
+    EXPECT_EQ(stats.rows, 100);
+    EXPECT_EQ(stats.totalUs, 90 * 10 + 10 * 1000);
+    EXPECT_EQ(stats.maxUs, 1000);
+    EXPECT_EQ(stats.p50Us, 16);   // [8, 16) us bucket
+    EXPECT_EQ(stats.p95Us, 1000); // capped by max
+    EXPECT_EQ(stats.p99Us, 1000);
+}
+
+TEST_F(SqlStatisticsTest, testNormalize)
+{
+    EXPECT_EQ(SqlStatistics::normalize("SELECT id FROM items WHERE id IN (?, ?, ?)"),
+              "SELECT id FROM items WHERE id IN (...)");
+    EXPECT_EQ(SqlStatistics::normalize("DELETE FROM items WHERE mission = :where_mission AND "
+                                       "id NOT IN (:except_0, :except_1)"),
+              "DELETE FROM items WHERE mission = :where_mission AND id NOT IN (...)");
+
+    statistics->record("SELECT id FROM items WHERE id IN (?)", 1000, 1);
+    statistics->record("SELECT id FROM items WHERE id IN (?, ?)", 1000, 2);
+    EXPECT_EQ(statistics->statements().count(), 1);
+}
+
+TEST_F(SqlStatisticsTest, testSqlTableIsInstrumented)
+{
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", ::connection);
+        db.setDatabaseName(":memory:");
+        ASSERT_TRUE(db.open());
+        QSqlQuery(db).exec("CREATE TABLE items (id TEXT PRIMARY KEY NOT NULL, value INTEGER)");
+
+        SqlTable table(&db, "items");
+        statistics->reset();
+
+        for (int i = 0; i < 5; ++i)
+        {
+            ASSERT_TRUE(table.insert({ { "id", QString::number(i) }, { "value", i } }));
+        }
+        EXPECT_EQ(table.select().count(), 5);
+
+        statistics->setEnabled(false);
+        EXPECT_EQ(table.select().count(), 5);
+    }
+    QSqlDatabase::removeDatabase(::connection);
+
+    const QList<SqlStatementStats> statements = statistics->statements();
+    ASSERT_EQ(statements.count(), 2);
+
+    SqlStatementStats insert = statistics->statement(
+        "INSERT INTO items (id, value) VALUES (:id, :value)");
+    EXPECT_EQ(insert.count, 5);
+    EXPECT_EQ(insert.rows, 0);
+    EXPECT_EQ(insert.rowsAffected, 5);
+
+    SqlStatementStats select = statistics->statement("SELECT id, value FROM items");
+    EXPECT_EQ(select.count, 1);
+    EXPECT_EQ(select.rows, 5);
+}
+
+TEST_F(SqlStatisticsTest, testVisitorTimeIsNotCounted)
+{
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", ::connection);
+        db.setDatabaseName(":memory:");
+        ASSERT_TRUE(db.open());
+        QSqlQuery(db).exec("CREATE TABLE items (id TEXT PRIMARY KEY NOT NULL, value INTEGER)");
+
+        SqlTable table(&db, "items");
+        ASSERT_TRUE(table.insert({ { "id", "1" }, { "value", 1 } }));
+        ASSERT_TRUE(table.insert({ { "id", "2" }, { "value", 2 } }));
+
+        EXPECT_TRUE(table.selectEach({}, { "value" }, [](const QSqlQuery&) {
+            QThread::msleep(50);
+            return true;
+        }));
+    }
+    QSqlDatabase::removeDatabase(::connection);
+
+    SqlStatementStats select = statistics->statement("SELECT value FROM items");
+    EXPECT_EQ(select.rows, 2);
+    EXPECT_LT(select.totalUs, 50000);
+}
@@ -0,0 +1,437 @@
+#include <gtest/gtest.h>
+
+#include <QSqlDatabase>
+#include <QSqlQuery>
+
+#include "sql_table.h"
+
+using namespace md::data_source;
+
+namespace
+{
+constexpr char connection[] = "test_sql_table";
+constexpr char table[] = "items";
+
+class StatementsTable : public SqlTable
+{
+public:
+    using SqlTable::SqlTable;
+    using SqlTable::cachedQuery;
+};
+
+class ChangesTable : public SqlTable
+{
+public:
+    using SqlTable::SqlTable;
+
+    QList<ConditionMap> changes;
+
+protected:
+    void rowsChanged(const ConditionMap& conditions) override
+    {
+        changes.append(conditions);
+    }
+};
+} // namespace
+
+class SqlTableTest : public ::testing::Test
+{
+public:
+    QSqlDatabase db;
+
+    void SetUp() override
+    {
+        db = QSqlDatabase::addDatabase("QSQLITE", ::connection);
+        db.setDatabaseName(":memory:");
+        ASSERT_TRUE(db.open());
+
+        QSqlQuery query(db);
+        ASSERT_TRUE(query.exec("CREATE TABLE items (id TEXT PRIMARY KEY NOT NULL, "
+                               "name TEXT, value INTEGER)"));
+    }
+
+    void TearDown() override
+    {
+        db.close();
+        db = QSqlDatabase();
+        QSqlDatabase::removeDatabase(::connection);
+    }
+};
+
+TEST_F(SqlTableTest, testInsertReusesStatement)
+{
+    SqlTable sqlTable(&db, ::table);
+
+    for (int i = 0; i < 10; ++i)
+    {
+        ASSERT_TRUE(sqlTable.insert(
+            { { "id", QString::number(i) }, { "name", "item" }, { "value", i } }));
+    }
+
+    EXPECT_EQ(sqlTable.select().count(), 10);
+    EXPECT_EQ(sqlTable.statementCacheStats().misses, 2); // insert & select
+    EXPECT_EQ(sqlTable.statementCacheStats().hits, 9);
+}
+
+TEST_F(SqlTableTest, testDifferentColumnsAreDifferentStatements)
+{
+    SqlTable sqlTable(&db, ::table);
+
+    ASSERT_TRUE(sqlTable.insert({ { "id", "1" }, { "name", "first" } }));
+    ASSERT_TRUE(sqlTable.insert({ { "id", "2" }, { "value", 2 } }));
+    ASSERT_TRUE(sqlTable.insert({ { "id", "3" }, { "name", "third" } }));
+
+    EXPECT_EQ(sqlTable.statementCacheStats().misses, 2);
+    EXPECT_EQ(sqlTable.statementCacheStats().hits, 1);
+
+    sqlTable.clearStatementCache();
+    ASSERT_TRUE(sqlTable.insert({ { "id", "4" }, { "name", "fourth" } }));
+    EXPECT_EQ(sqlTable.statementCacheStats().misses, 3);
+}
+
+TEST_F(SqlTableTest, testBoundConditions)
+{
+    SqlTable sqlTable(&db, ::table);
+
+    ASSERT_TRUE(sqlTable.insert({ { "id", "1" }, { "name", "Pilot's home" }, { "value", 1 } }));
+    ASSERT_TRUE(sqlTable.insert({ { "id", "2" }, { "name", "Base" }, { "value", 2 } }));
+    ASSERT_TRUE(sqlTable.insert({ { "id", "3" }, { "value", 3 } }));
+
+    EXPECT_EQ(sqlTable.selectOne({ { "name", "Pilot's home" } }, "id"), QVariantList({ "1" }));
+    EXPECT_EQ(sqlTable.selectOne({ { "name", "Base" } }, "id"), QVariantList({ "2" }));
+    EXPECT_EQ(sqlTable.selectOne({ { "name", QVariant() } }, "id"), QVariantList({ "3" }));
+
+    ASSERT_TRUE(sqlTable.updateByCondition({ { "name", "O'Hare" } }, { "id", "2" }));
+    EXPECT_EQ(sqlTable.selectOne({ { "id", "2" } }, "name"), QVariantList({ "O'Hare" }));
+
+    ASSERT_TRUE(sqlTable.removeByCondition({ "name", "O'Hare" }));
+    EXPECT_EQ(sqlTable.select().count(), 2);
+}
+
+TEST_F(SqlTableTest, testConditionsReuseStatement)
+{
+    SqlTable sqlTable(&db, ::table);
+
+    for (int i = 0; i < 5; ++i)
+    {
+        ASSERT_TRUE(sqlTable.insert({ { "id", QString::number(i) }, { "value", i } }));
+    }
+    const int hits = sqlTable.statementCacheStats().hits;
+
+    for (int i = 0; i < 5; ++i)
+    {
+        EXPECT_EQ(sqlTable.selectOne({ { "id", QString::number(i) } }, "value"),
+                  QVariantList({ i }));
+    }
+
+    EXPECT_EQ(sqlTable.statementCacheStats().hits - hits, 4);
+}
+
+TEST_F(SqlTableTest, testInsertMany)
+{
+    SqlTable sqlTable(&db, ::table);
+
+    QList<QVariantMap> rows;
+    for (int i = 0; i < 100; ++i)
+    {
+        rows.append({ { "id", QString::number(i) }, { "name", "item" }, { "value", i } });
+    }
+    // Different column set & unknown column
+    rows.append({ { "id", "last" }, { "value", -1 }, { "unknown", true } });
+
+    ASSERT_TRUE(sqlTable.insertMany(rows));
+
+    EXPECT_EQ(sqlTable.select().count(), 101);
+    EXPECT_EQ(sqlTable.selectOne({ { "id", "42" } }, "value"), QVariantList({ 42 }));
+    EXPECT_TRUE(sqlTable.selectOne({ { "id", "last" } }, "name").value(0).isNull());
+}
+
+TEST_F(SqlTableTest, testInsertManyRollsBackOnError)
+{
+    SqlTable sqlTable(&db, ::table);
+
+    ASSERT_TRUE(sqlTable.insert({ { "id", "2" } }));
+
+    // Duplicate primary key in the middle of the batch
+    EXPECT_FALSE(sqlTable.insertMany({ { { "id", "1" } }, { { "id", "2" } }, { { "id", "3" } } }));
+
+    EXPECT_EQ(sqlTable.select().count(), 1);
+}
+
+TEST_F(SqlTableTest, testRolledBackRowsAreNotChanged)
+{
+    ChangesTable sqlTable(&db, ::table);
+
+    ASSERT_TRUE(sqlTable.insert({ { "id", "2" } }));
+    sqlTable.changes.clear();
+
+    EXPECT_FALSE(sqlTable.insertMany({ { { "id", "1" } }, { { "id", "2" } }, { { "id", "3" } } }));
+    EXPECT_TRUE(sqlTable.changes.isEmpty());
+
+    ASSERT_TRUE(sqlTable.insertMany({ { { "id", "1" } }, { { "id", "3" } } }));
+    EXPECT_EQ(sqlTable.changes.count(), 2);
+}
+
+TEST_F(SqlTableTest, testTransactionCommit)
+{
+    SqlTable sqlTable(&db, ::table);
+    {
+        auto transaction = sqlTable.transaction();
+        ASSERT_TRUE(transaction->isActive());
+
+        ASSERT_TRUE(sqlTable.insert({ { "id", "1" } }));
+        ASSERT_TRUE(sqlTable.insert({ { "id", "2" } }));
+        EXPECT_TRUE(transaction->commit());
+        EXPECT_FALSE(transaction->isActive());
+    }
+    EXPECT_EQ(sqlTable.select().count(), 2);
+}
+
+TEST_F(SqlTableTest, testTransactionRollbackOnScopeExit)
+{
+    SqlTable sqlTable(&db, ::table);
+    {
+        auto transaction = sqlTable.transaction();
+        ASSERT_TRUE(sqlTable.insert({ { "id", "1" } }));
+    }
+    EXPECT_EQ(sqlTable.select().count(), 0);
+}
+
+TEST_F(SqlTableTest, testNestedTransactions)
+{
+    SqlTable sqlTable(&db, ::table);
+    {
+        auto outer = sqlTable.transaction();
+        ASSERT_TRUE(sqlTable.insert({ { "id", "1" } }));
+        {
+            auto inner = sqlTable.transaction();
+            ASSERT_TRUE(sqlTable.insert({ { "id", "2" } }));
+            inner->rollback();
+        }
+        {
+            auto inner = sqlTable.transaction();
+            ASSERT_TRUE(sqlTable.insertMany({ { { "id", "3" } }, { { "id", "4" } } }));
+            EXPECT_TRUE(inner->commit());
+        }
+        EXPECT_TRUE(outer->commit());
+    }
+    EXPECT_EQ(sqlTable.selectOne({}, "id"), QVariantList({ "1", "3", "4" }));
+}
+
+TEST_F(SqlTableTest, testSelectEach)
+{
+    SqlTable sqlTable(&db, ::table);
+
+    for (int i = 0; i < 10; ++i)
+    {
+        ASSERT_TRUE(sqlTable.insert({ { "id", QString::number(i) }, { "value", i * 10 } }));
+    }
+
+    int sum = 0;
+    int rows = 0;
+    EXPECT_TRUE(sqlTable.selectEach({}, { "value", "id" }, [&sum, &rows](const QSqlQuery& row) {
+        sum += row.value(0).toInt();
+        return ++rows < 3; // Stop on third row
+    }, { "value" }));
+
+    EXPECT_EQ(rows, 3);
+    EXPECT_EQ(sum, 30);
+
+    // Statement is reusable after early termination
+    EXPECT_TRUE(sqlTable.selectEach({}, { "value", "id" }, [&rows](const QSqlQuery&) {
+        rows++;
+        return true;
+    }, { "value" }));
+    EXPECT_EQ(rows, 13);
+}
+
+TEST_F(SqlTableTest, testNestedSelectOfSameStatement)
+{
+    SqlTable sqlTable(&db, ::table);
+
+    for (int i = 0; i < 3; ++i)
+    {
+        ASSERT_TRUE(sqlTable.insert({ { "id", QString::number(i) }, { "value", i } }));
+    }
+
+    // Visitor runs the statement being iterated, the outer iteration goes on
+    int rows = 0;
+    int nestedRows = 0;
+    EXPECT_TRUE(sqlTable.selectEach({}, { "value" }, [&](const QSqlQuery&) {
+        rows++;
+        nestedRows += sqlTable.selectOne({}, "value").count();
+        return true;
+    }));
+    EXPECT_EQ(rows, 3);
+    EXPECT_EQ(nestedRows, 9);
+
+    // Finished statement is reused again
+    const int hits = sqlTable.statementCacheStats().hits;
+    sqlTable.selectOne({}, "value");
+    EXPECT_EQ(sqlTable.statementCacheStats().hits, hits + 1);
+}
+
+TEST_F(SqlTableTest, testLeastRecentlyUsedStatementIsEvicted)
+{
+    StatementsTable sqlTable(&db, ::table);
+
+    // Frequently used statement outlives many one-off ones
+    for (int i = 0; i < 100; ++i)
+    {
+        sqlTable.cachedQuery("SELECT value FROM items");
+        sqlTable.cachedQuery(QString("SELECT %1 FROM items").arg(i));
+    }
+    EXPECT_EQ(sqlTable.statementCacheStats().hits, 99);
+    EXPECT_EQ(sqlTable.statementCacheStats().misses, 101);
+}
+
+TEST_F(SqlTableTest, testUpsertMany)
+{
+    SqlTable sqlTable(&db, ::table);
+
+    ASSERT_TRUE(sqlTable.insert({ { "id", "1" }, { "name", "first" }, { "value", 1 } }));
+
+    ASSERT_TRUE(sqlTable.upsertMany({ { { "id", "1" }, { "value", 10 } },
+                                      { { "id", "2" }, { "value", 20 } },
+                                      { { "id", "3" } } },
+                                    "id"));
+
+    EXPECT_EQ(sqlTable.select().count(), 3);
+    EXPECT_EQ(sqlTable.selectOne({ { "id", "1" } }, "value"), QVariantList({ 10 }));
+    EXPECT_EQ(sqlTable.selectOne({ { "id", "2" } }, "value"), QVariantList({ 20 }));
+    // Columns missing in the row are kept
+    EXPECT_EQ(sqlTable.selectOne({ { "id", "1" } }, "name"), QVariantList({ "first" }));
+
+    ASSERT_TRUE(sqlTable.upsert({ { "id", "3" }, { "value", 30 } }, "id"));
+    EXPECT_EQ(sqlTable.selectOne({ { "id", "3" } }, "value"), QVariantList({ 30 }));
+}
+
+TEST_F(SqlTableTest, testRemoveExcept)
+{
+    SqlTable sqlTable(&db, ::table);
+
+    for (int i = 0; i < 5; ++i)
+    {
+        ASSERT_TRUE(sqlTable.insert({ { "id", QString::number(i) }, { "value", i % 2 } }));
+    }
+
+    ASSERT_TRUE(sqlTable.removeExcept({ { "value", 0 } }, "id", { "2" }));
+    EXPECT_EQ(sqlTable.selectOne({}, "id"), QVariantList({ "1", "2", "3" }));
+
+    ASSERT_TRUE(sqlTable.removeExcept({ { "value", 1 } }, "id", {}));
+    EXPECT_EQ(sqlTable.selectOne({}, "id"), QVariantList({ "2" }));
+}
+
+TEST_F(SqlTableTest, testRemoveExceptManyValues)
+{
+    SqlTable sqlTable(&db, ::table);
+
+    // Names repeat across values, only the rows matching the conditions may go
+    QList<QVariantMap> rows;
+    for (int i = 0; i < 4000; ++i)
+    {
+        rows.append({ { "id", QString::number(i) }, { "name", QString::number(i / 2) },
+                      { "value", i % 2 } });
+    }
+    ASSERT_TRUE(sqlTable.insertMany(rows));
+
+    QVariantList kept;
+    for (int i = 0; i < 1200; ++i)
+    {
+        kept.append(QString::number(i));
+    }
+
+    ASSERT_TRUE(sqlTable.removeExcept({ { "value", 0 } }, "name", kept));
+    EXPECT_EQ(sqlTable.count({ { "value", 0 } }), 1200);
+    EXPECT_EQ(sqlTable.count({ { "value", 1 } }), 2000);
+}
+
+TEST_F(SqlTableTest, testSelectPage)
+{
+    SqlTable sqlTable(&db, ::table);
+
+    for (int i = 0; i < 10; ++i)
+    {
+        ASSERT_TRUE(sqlTable.insert({ { "id", QString::number(9 - i) }, { "value", i % 3 } }));
+    }
+
+    // Insertion order by default
+    md::domain::PageRequest request;
+    request.limit = 4;
+    request.withTotal = true;
+    md::domain::Page page = sqlTable.selectPage({}, { "id" }, "id", request);
+    ASSERT_EQ(page.rows.count(), 4);
+    EXPECT_EQ(page.rows.first().value("id").toString(), "9");
+    EXPECT_TRUE(page.hasMore);
+    EXPECT_EQ(page.total, 10);
+
+    // Equal values go in key order
+    request.orderBy = "value";
+    request.withTotal = false;
+    QStringList ids;
+    int pages = 0;
+    do
+    {
+        page = sqlTable.selectPage({}, { "id" }, "id", request);
+        for (const QVariantMap& row : page.rows)
+        {
+            ids.append(row.value("id").toString());
+        }
+        request = page.next;
+        pages++;
+    } while (page.hasMore);
+
+    EXPECT_EQ(pages, 3);
+    EXPECT_EQ(page.total, -1);
+    EXPECT_EQ(ids, QStringList({ "0", "3", "6", "9", "2", "5", "8", "1", "4", "7" }));
+
+    // Descending with conditions
+    md::domain::PageRequest descending;
+    descending.sortOrder = Qt::DescendingOrder;
+    descending.limit = 2;
+    page = sqlTable.selectPage({ { "value", 0 } }, { "id" }, "id", descending);
+    page = sqlTable.selectPage({ { "value", 0 } }, { "id" }, "id", page.next);
+    ASSERT_EQ(page.rows.count(), 2);
+    EXPECT_EQ(page.rows.first().value("id").toString(), "6");
+    EXPECT_FALSE(page.hasMore);
+    EXPECT_EQ(sqlTable.count({ { "value", 0 } }), 4);
+}
+
+TEST_F(SqlTableTest, testSelectPageNullValues)
+{
+    SqlTable sqlTable(&db, ::table);
+
+    for (int i = 0; i < 6; ++i)
+    {
+        ASSERT_TRUE(sqlTable.insert(
+            { { "id", QString::number(i) }, { "value", i % 2 ? QVariant(i) : QVariant() } }));
+    }
+
+    const auto allIds = [&sqlTable](md::domain::PageRequest request) {
+        QStringList ids;
+        md::domain::Page page;
+        do
+        {
+            page = sqlTable.selectPage({}, { "id" }, "id", request);
+            for (const QVariantMap& row : page.rows)
+            {
+                ids.append(row.value("id").toString());
+            }
+            request = page.next;
+        } while (page.hasMore);
+        return ids;
+    };
+
+    md::domain::PageRequest request;
+    request.limit = 2;
+    request.orderBy = "value";
+    EXPECT_EQ(allIds(request), QStringList({ "0", "2", "4", "1", "3", "5" }));
+
+    request.sortOrder = Qt::DescendingOrder;
+    EXPECT_EQ(allIds(request), QStringList({ "5", "3", "1", "4", "2", "0" }));
+
+    // Not a column of the table
+    request.orderBy = "value; DROP TABLE items";
+    EXPECT_TRUE(sqlTable.selectPage({}, { "id" }, "id", request).rows.isEmpty());
+    EXPECT_EQ(sqlTable.count(), 6);
+}
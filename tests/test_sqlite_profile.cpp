@@ -0,0 +1,39 @@
+#include <gtest/gtest.h>
+
+#include <QTemporaryDir>
+
+#include "sqlite_schema.h"
+
+using namespace md::data_source;
+
+class SqliteProfileTest : public ::testing::Test
+{
+public:
+    QTemporaryDir dir;
+};
+
+TEST_F(SqliteProfileTest, testDurable)
+{
+    SqliteSchema schema(dir.filePath("durable.db"), SqliteProfile::durable());
+    schema.setup();
+
+    QVariantMap settings = schema.activeSettings();
+    EXPECT_EQ(settings.value("journal_mode").toString(), "wal");
+    EXPECT_EQ(settings.value("synchronous").toInt(), 2); // FULL
+    EXPECT_EQ(settings.value("mmap_size").toLongLong(), 0);
+    EXPECT_EQ(settings.value("cache_size").toInt(), SqliteProfile::durable().cacheSize);
+    EXPECT_EQ(settings.value("busy_timeout").toInt(), SqliteProfile::durable().busyTimeout);
+}
+
+TEST_F(SqliteProfileTest, testFast)
+{
+    SqliteSchema schema(dir.filePath("fast.db"), SqliteProfile::fast());
+    schema.setup();
+
+    QVariantMap settings = schema.activeSettings();
+    EXPECT_EQ(settings.value("journal_mode").toString(), "wal");
+    EXPECT_EQ(settings.value("synchronous").toInt(), 1); // NORMAL
+    EXPECT_EQ(settings.value("temp_store").toInt(), 2);  // MEMORY
+    EXPECT_EQ(settings.value("cache_size").toInt(), SqliteProfile::fast().cacheSize);
+    EXPECT_EQ(settings.value("foreign_keys").toInt(), 1);
+}
@@ -0,0 +1,177 @@
+#include <gtest/gtest.h>
+
+#include <QFile>
+#include <QSqlQuery>
+#include <QTemporaryDir>
+#include <QThread>
+#include <QUuid>
+
+#include "entity_sql_table.h"
+#include "sql_migrator.h"
+#include "sql_table.h"
+#include "sqlite_schema.h"
+
+using namespace md::data_source;
+
+namespace
+{
+QStringList indexes(QSqlDatabase* db, const QString& table)
+{
+    QSqlQuery query(*db);
+    query.exec("PRAGMA index_list(" + table + ")");
+
+    QStringList names;
+    while (query.next())
+    {
+        names.append(query.value("name").toString());
+    }
+    return names;
+}
+} // namespace
+
+class SqliteSchemaTest : public ::testing::Test
+{
+public:
+    QTemporaryDir dir;
+};
+
+TEST_F(SqliteSchemaTest, testSetupAppliesMigrations)
+{
+    SqliteSchema schema(dir.filePath("schema.db"));
+    schema.setup();
+
+    EXPECT_EQ(SqlMigrator(*schema.db()).appliedVersions().count(), 6);
+    EXPECT_TRUE(::indexes(schema.db(), "mission_items").contains("mission_items_mission_idx"));
+    EXPECT_TRUE(::indexes(schema.db(), "missions").contains("missions_vehicle_idx"));
+}
+
+TEST_F(SqliteSchemaTest, testMigrationsAppliedOnce)
+{
+    {
+        SqliteSchema schema(dir.filePath("schema.db"));
+        schema.setup();
+        schema.db()->close();
+    }
+
+    SqliteSchema schema(dir.filePath("schema.db"));
+    schema.setup();
+
+    EXPECT_EQ(SqlMigrator(*schema.db()).appliedVersions().count(), 6);
+}
+
+TEST_F(SqliteSchemaTest, testFailedMigrationRollsBack)
+{
+    SqliteSchema schema(dir.filePath("schema.db"));
+    schema.setup();
+
+    SqlMigrator migrator(*schema.db());
+    EXPECT_FALSE(migrator.migrate({ { "broken", { "CREATE TABLE broken (id INTEGER)",
+                                                  "SELECT * FROM missing_table" } } }));
+
+    EXPECT_FALSE(migrator.appliedVersions().contains("broken"));
+    EXPECT_FALSE(schema.db()->tables().contains("broken"));
+}
+
+TEST_F(SqliteSchemaTest, testTextUuidsMigratedToBlobs)
+{
+    const QString vehicleId = QUuid::createUuid().toString();
+    const QString missionId = QUuid::createUuid().toString();
+    const QString bareId = QUuid::createUuid().toString(QUuid::WithoutBraces);
+    {
+        SqliteSchema schema(dir.filePath("schema.db"));
+        schema.setup();
+
+        // Rows of the databases created before the ids were stored as blobs
+        QSqlQuery query(*schema.db());
+        ASSERT_TRUE(query.exec("DELETE FROM schema_version WHERE version = '12.00.00_17.10.2026'"));
+        ASSERT_TRUE(query.exec(QString("INSERT INTO vehicles (id) VALUES ('%1')").arg(vehicleId)));
+        ASSERT_TRUE(query.exec(QString("INSERT INTO missions (id, vehicle) VALUES ('%1', '%2')")
+                                   .arg(missionId, vehicleId)));
+        ASSERT_TRUE(query.exec("INSERT INTO missions (id) VALUES ('not uuid')"));
+        ASSERT_TRUE(query.exec(QString("INSERT INTO missions (id) VALUES ('%1')").arg(bareId)));
+        schema.db()->close();
+    }
+
+    SqliteSchema schema(dir.filePath("schema.db"));
+    schema.setup();
+    EXPECT_EQ(SqlMigrator(*schema.db()).appliedVersions().count(), 6);
+
+    QSqlQuery query(*schema.db());
+    ASSERT_TRUE(query.exec("SELECT count(*) FROM missions JOIN vehicles "
+                           "ON missions.vehicle = vehicles.id WHERE typeof(vehicles.id) = 'blob'"));
+    ASSERT_TRUE(query.next());
+    EXPECT_EQ(query.value(0).toInt(), 1);
+
+    SqlTable missions(schema.db(), "missions");
+    EXPECT_EQ(missions.selectOne({ { "vehicle", vehicleId } }, "id"), QVariantList({ missionId }));
+    EXPECT_EQ(missions.selectOne({ { "id", "not uuid" } }, "id"), QVariantList({ "not uuid" }));
+    // Other spellings of a UUID are not converted, the blob would read back braced
+    EXPECT_EQ(missions.selectOne({ { "id", bareId } }, "id"), QVariantList({ bareId }));
+}
+
+TEST_F(SqliteSchemaTest, testJsonTextMigratedToCbor)
+{
+    const QString vehicleId = QUuid::createUuid().toString();
+    {
+        SqliteSchema schema(dir.filePath("schema.db"));
+        schema.setup();
+
+        // Params of the databases created before they were stored as CBOR
+        QSqlQuery query(*schema.db());
+        ASSERT_TRUE(query.exec("DELETE FROM schema_version WHERE version = '13.00.00_17.10.2026'"));
+        query.prepare("INSERT INTO vehicles (id, params) VALUES (?, ?)");
+        query.addBindValue(QUuid(vehicleId).toRfc4122());
+        query.addBindValue(QByteArray("{\"mav_id\":23}"));
+        ASSERT_TRUE(query.exec());
+        schema.db()->close();
+    }
+
+    SqliteSchema schema(dir.filePath("schema.db"));
+    schema.setup();
+
+    QSqlQuery query(*schema.db());
+    ASSERT_TRUE(query.exec("SELECT params FROM vehicles"));
+    ASSERT_TRUE(query.next());
+    EXPECT_FALSE(query.value(0).toByteArray().startsWith('{'));
+    EXPECT_EQ(sql::decodeJson(query.value(0)), QVariantMap({ { "mav_id", 23 } }));
+}
+
+TEST_F(SqliteSchemaTest, testInMemoryBackupAndRestore)
+{
+    const QString path = dir.filePath("memory.db");
+    SqliteMemoryMode memoryMode;
+    memoryMode.backupIntervalMs = 0;
+    memoryMode.pagesPerStep = 1;
+    {
+        SqliteSchema schema(path, SqliteProfile::fast(), memoryMode);
+        schema.setup();
+        EXPECT_TRUE(schema.isInMemory());
+        EXPECT_FALSE(QFile::exists(path));
+
+        SqlTable vehicles(schema.db(), "vehicles");
+        ASSERT_TRUE(vehicles.insert({ { "id", QUuid::createUuid().toString() } }));
+
+        // Connections of the other threads share the database
+        int count = 0;
+        QThread* thread = QThread::create([&count, &vehicles]() {
+            count = vehicles.count();
+        });
+        thread->start();
+        thread->wait();
+        delete thread;
+        EXPECT_EQ(count, 1);
+
+        ASSERT_TRUE(schema.backup());
+        EXPECT_EQ(schema.backupStats().backups, 1);
+        EXPECT_GT(schema.backupStats().lastBytes, 0);
+
+        // Saved on destruction
+        ASSERT_TRUE(vehicles.insert({ { "id", QUuid::createUuid().toString() } }));
+    }
+
+    SqliteSchema schema(path, SqliteProfile::fast(), memoryMode);
+    schema.setup();
+
+    EXPECT_EQ(SqlTable(schema.db(), "vehicles").count(), 2);
+    EXPECT_EQ(SqlMigrator(*schema.db()).appliedVersions().count(), 6);
+}
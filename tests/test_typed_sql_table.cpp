@@ -0,0 +1,158 @@
+#include <gtest/gtest.h>
+
+#include <QTemporaryDir>
+
+#include "entity_sql_table.h"
+#include "mission_item_row.h"
+#include "sqlite_schema.h"
+#include "utils.h"
+#include "vehicle.h"
+#include "vehicle_row.h"
+#include "vehicle_traits.h"
+
+using namespace md::data_source;
+using namespace md::domain;
+
+namespace
+{
+using VehicleStatements = SqlRowSchema<VehicleRow>;
+} // namespace
+
+class TypedSqlTableTest : public ::testing::Test
+{
+public:
+    QTemporaryDir dir;
+};
+
+TEST_F(TypedSqlTableTest, testStatements)
+{
+    EXPECT_STREQ(sql::statementText<VehicleStatements, sql::Statement::Select>.text(),
+                 "SELECT id, name, params, type FROM vehicles");
+    EXPECT_STREQ(sql::statementText<VehicleStatements, sql::Statement::Insert>.text(),
+                 "INSERT INTO vehicles (id, name, params, type) VALUES (?, ?, ?, ?)");
+    EXPECT_STREQ(sql::statementText<VehicleStatements, sql::Statement::Update>.text(),
+                 "UPDATE vehicles SET name = ?, params = ?, type = ? WHERE id = ?");
+    EXPECT_STREQ(sql::statementText<VehicleStatements, sql::Statement::Upsert>.text(),
+                 "INSERT INTO vehicles (id, name, params, type) VALUES (?, ?, ?, ?) "
+                 "ON CONFLICT(id) DO UPDATE SET name = excluded.name, "
+                 "params = excluded.params, type = excluded.type");
+}
+
+TEST_F(TypedSqlTableTest, testVehicleRoundTrip)
+{
+    SqliteSchema schema(dir.filePath("vehicles.db"));
+    schema.setup();
+
+    VehiclesSqlTable table(schema.db(), JsonEncoding::Cbor);
+    VehicleRow row = { md::utils::generateId().toString(), "MAV 23", { { "mav_id", 23 } },
+                       "generic" };
+    ASSERT_TRUE(table.insertRow(row));
+
+    // Rows written typed are readable as maps and the other way round
+    EntitySqlTable entities(schema.db(), "vehicles", { "params" }, JsonEncoding::Cbor);
+    QVariantMap map = entities.selectById(row.id);
+    EXPECT_EQ(map.value("name"), "MAV 23");
+    EXPECT_EQ(map.value("params").toMap().value("mav_id"), 23);
+
+    ASSERT_TRUE(entities.updateById({ { "name", "MAV 42" } }, row.id));
+
+    std::optional<VehicleRow> read = table.selectRow(row.id);
+    ASSERT_TRUE(read.has_value());
+    EXPECT_EQ(read->id, row.id);
+    EXPECT_EQ(read->name, "MAV 42");
+    EXPECT_EQ(read->params, row.params);
+
+    row.type = "copter";
+    ASSERT_TRUE(table.updateRow(row));
+    EXPECT_EQ(table.selectRow(row.id)->type, "copter");
+
+    ASSERT_TRUE(table.removeRow(row.id));
+    EXPECT_FALSE(table.selectRow(row.id).has_value());
+}
+
+TEST_F(TypedSqlTableTest, testMissionItems)
+{
+    SqliteSchema schema(dir.filePath("items.db"));
+    schema.setup();
+
+    const QString missionId = md::utils::generateId().toString();
+    ASSERT_TRUE(SqlTable(schema.db(), "missions").insert({ { "id", missionId } }));
+
+    MissionItemsSqlTable table(schema.db());
+    QList<MissionItemRow> rows;
+    for (int i = 0; i < 3; ++i)
+    {
+        MissionItemRow row;
+        row.id = md::utils::generateId().toString();
+        row.mission = missionId;
+        row.type = "waypoint";
+        if (i)
+            row.latitude = 55.0 + i;
+        rows.append(row);
+    }
+    ASSERT_TRUE(table.insertRows(rows));
+
+    const QList<MissionItemRow> read = table.selectRows({ { "mission", missionId } });
+    ASSERT_EQ(read.count(), 3);
+    EXPECT_EQ(read.at(1).id, rows.at(1).id);
+    EXPECT_EQ(read.at(1).mission, missionId);
+    EXPECT_FALSE(read.at(0).latitude.has_value());
+    EXPECT_EQ(read.at(2).latitude, 57.0);
+
+    // Same map as the untyped table selects
+    const QVariantMap map = MissionItemsSqlTable::toVariantMap(read.at(2));
+    EXPECT_EQ(map.value("id"), rows.at(2).id);
+    EXPECT_TRUE(MissionItemsSqlTable::toVariantMap(read.at(0)).value("latitude").isNull());
+    EXPECT_EQ(map.value("latitude").toDouble(), 57.0);
+    // Key column is assigned by SQLite and not part of the row
+    QStringList keys =
+        EntitySqlTable(schema.db(), "mission_items").selectById(rows.at(2).id).keys();
+    keys.removeOne("item_key");
+    EXPECT_EQ(map.keys(), keys);
+
+    rows[0].name = "Takeoff";
+    ASSERT_TRUE(table.upsertRow(rows[0]));
+    EXPECT_EQ(table.selectRow(rows[0].id)->name, "Takeoff");
+    EXPECT_EQ(table.count(), 3);
+}
+
+TEST_F(TypedSqlTableTest, testEntityHydration)
+{
+    SqliteSchema schema(dir.filePath("entities.db"));
+    schema.setup();
+
+    VehiclesSqlTable table(schema.db(), JsonEncoding::Cbor);
+    table.setCacheCapacity(8);
+
+    Vehicle vehicle(&vehicle::generic, "MAV 23", md::utils::generateId(), { { "mav_id", 23 } });
+    ASSERT_TRUE(table.insertEntity(&vehicle));
+    EXPECT_TRUE(vehicle.dirtyFields().isEmpty());
+
+    // Stored with the table encoding, readable by the map based table
+    EntitySqlTable entities(schema.db(), "vehicles", { "params" }, JsonEncoding::Cbor);
+    EXPECT_EQ(entities.selectById(vehicle.id).value("params").toMap().value("mav_id"), 23);
+    EXPECT_EQ(entities.selectById(vehicle.id).value("type"), vehicle::generic.id);
+
+    Vehicle read(&vehicle::generic, "", vehicle.id);
+    table.readEntity(&read);
+    EXPECT_EQ(read.name(), "MAV 23");
+    EXPECT_EQ(read.parameters(), vehicle.parameters());
+
+    // Second read is served from the cache
+    table.readEntity(&read);
+    EXPECT_EQ(table.cacheStats().hits, 1);
+    EXPECT_EQ(table.cacheStats().misses, 1);
+
+    vehicle.name = "MAV 42";
+    ASSERT_TRUE(table.updateEntity(&vehicle));
+    table.readEntity(&read);
+    EXPECT_EQ(read.name(), "MAV 42");
+
+    // Writes past the typed table drop the cached row once invalidated
+    ASSERT_TRUE(entities.updateById({ { "name", "MAV 7" } }, vehicle.id));
+    table.invalidateCache({ { "id", vehicle.id } });
+    EXPECT_EQ(table.selectRow(vehicle.id)->name, "MAV 7");
+
+    ASSERT_TRUE(table.removeEntity(&vehicle));
+    EXPECT_FALSE(table.selectRow(vehicle.id).has_value());
+}
@@ -14,6 +14,7 @@ class VehiclesRepositoryMock : public IVehiclesRepository
 public:
     MOCK_METHOD(QVariantList, selectVehicleIds, (), (override));
     MOCK_METHOD(QVariantMap, select, (const QVariant&), (override));
+    MOCK_METHOD(Page, selectPage, (const PageRequest&), (override));
 
     MOCK_METHOD(void, insert, (Vehicle*), (override));
     MOCK_METHOD(void, read, (Vehicle*), (override));
@@ -87,3 +88,33 @@ TEST_F(VehiclesServiceTest, testRemove)
     service.removeVehicle(vehicle);
     EXPECT_EQ(spyRemove.count(), 1);
 }
+
+TEST_F(VehiclesServiceTest, testRefresh)
+{
+    QSignalSpy spyAdded(&service, &IVehiclesService::vehicleAdded);
+    QSignalSpy spyChanged(&service, &IVehiclesService::vehicleChanged);
+    QSignalSpy spyRemove(&service, &IVehiclesService::vehicleRemoved);
+
+    const QVariantMap stored = { { props::id, "vehicle" },
+                                 { props::name, "MAV 23" },
+                                 { props::type, vehicle::generic.id } };
+    EXPECT_CALL(vehicles, select(QVariant("vehicle"))).WillRepeatedly(Return(stored));
+    service.refreshVehicles({ "vehicle" });
+    EXPECT_EQ(spyAdded.count(), 1);
+
+    // Same values are not reported
+    service.refreshVehicles({ "vehicle" });
+    EXPECT_EQ(spyChanged.count(), 0);
+
+    QVariantMap renamed = stored;
+    renamed.insert(props::name, "MAV 24");
+    EXPECT_CALL(vehicles, select(QVariant("vehicle"))).WillOnce(Return(renamed));
+    service.refreshVehicles({ "vehicle" });
+    EXPECT_EQ(spyChanged.count(), 1);
+    EXPECT_EQ(service.vehicle("vehicle")->name(), "MAV 24");
+
+    EXPECT_CALL(vehicles, select(QVariant("vehicle"))).WillOnce(Return(QVariantMap()));
+    service.refreshVehicles({ "vehicle" });
+    EXPECT_EQ(spyRemove.count(), 1);
+    EXPECT_EQ(service.vehicle("vehicle"), nullptr);
+}